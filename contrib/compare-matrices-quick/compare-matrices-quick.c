@@ -7,6 +7,8 @@ Compilation: gcc compmat_quick_2modes.c -o compmat -lm
 Exucution example: ./compmat -o result.tab -file1 DemoCompMat.txt -file2 JasparCore_Transfac.txt -lth_ncor 0.7 -lth_w 5
 
 Synopsis: compmat -o <ouput_file> -file1 <ref_matrices_file> -file2 <query_matrices_file> \
+			[-format <format>]				matrices files format: transfac (default), tab, jaspar, meme, cluster-buster
+			[-format1 <format>] [-format2 <format>]	format of each file
 			[-lth_w <min_aligned_columns>]	min treshold on matrices overlap (default 5)
 			[-lth_ncor <min_ncor>]			min threshold on normalized correlation (default 0.4)
 			[-lth_ncor1 <min_ncor1>]		min threshold on correlation normalized on ref. matrices (default 0.)
@@ -21,6 +23,8 @@ Synopsis: compmat -o <ouput_file> -file1 <ref_matrices_file> -file2 <query_matri
 #include <sys/types.h>
 #include <regex.h>
 
+#include "matrixio.h"
+
 #define min(x,y) x<y ? x:y
 #define max(x,y) x>y ? x:y
 #define flipflap(x) (x+1)%2
@@ -39,6 +43,8 @@ double lth_ncor2 = 0.;		// lower threshold normalized on query matrices
 char *Qfile;				// Query matrices file 
 char *Rfile;				// Reference conserved matrices file 
 char *outfile="compmat_out.tab";	// Output file
+char *Qformat="transfac";	// Query matrices file format
+char *Rformat="transfac";	// Reference matrices file format
 int verbose = 0;
 char detect_palindromes = 0;
 char *mode="scan";
@@ -50,8 +56,8 @@ char *mode="scan";
 
 typedef struct				// Matrix structure
 {	
-	char ID[128];
-	char name[128];
+	char ID[MATRIX_ID_SIZE];
+	char name[MATRIX_ID_SIZE];
 	int width;
 	int nrow;
 	float **mat;
@@ -106,7 +112,7 @@ typedef struct				// alignment structure (corresponds to output line format)
 //============================ PROTOTYPES ==========================
 //==================================================================
 static void read_arg(int argc, char *argv[]);		// reads main arguments
-pssm *readmat(FILE *fp,int *matnum);				// loads ref an query matrices files
+pssm *readmat(char *file,char *format,int *matnum);	// loads ref an query matrices files
 pssm reverse_matrix(pssm matrix);					// computes reverse-complement matrix
 correls calc_corr(int offset, pssm M1, pssm M2);	// computes all correlations
 double crude_freq(pssm m,int r,int c);				// computes crude frequences of one cell in matrix m
@@ -137,14 +143,10 @@ int main(int argc, char *argv[]){
 	
 	read_arg(argc, argv);							// Set user-defined parameters
 		
-	fp = fopen(Rfile,"r");							// loading of the input files
-	Rmatab=readmat(fp,&Rnum);
+	Rmatab=readmat(Rfile,Rformat,&Rnum);			// loading of the input files
 	if (verbose > 0) {  printf("-> %d reference matrices retrieved from '%s'\n",Rnum,Rfile); }
-	fclose(fp);
-	fp = fopen(Qfile,"r");
-	Qmatab=readmat(fp,&Qnum);
+	Qmatab=readmat(Qfile,Qformat,&Qnum);
 	if (verbose > 0) { printf("-> %d query matrices retrieved from '%s'\n",Qnum,Qfile); }
-	fclose(fp);
 	last_match=(long *)malloc(Qnum*sizeof(long));
 	for (i=0; i<Qnum; i++) {
 		last_match[i]=-1;
@@ -320,6 +322,9 @@ void read_arg(int argc, char *argv[]){
 			  if(strcmp(argv[i],"-h") == 0)  {print_help(); exit(0);}
 			  if(strcmp(argv[i],"-file1") == 0)  Rfile  = argv[++i];
 			  if(strcmp(argv[i],"-file2") == 0)  Qfile  = argv[++i];
+			  if(strcmp(argv[i],"-format") == 0)  {Rformat = argv[++i]; Qformat = Rformat;}
+			  if(strcmp(argv[i],"-format1") == 0)  Rformat  = argv[++i];
+			  if(strcmp(argv[i],"-format2") == 0)  Qformat  = argv[++i];
 			  if(strcmp(argv[i],"-lth_w") == 0)  lth_w  = atoi(argv[++i]);
 			  if(strcmp(argv[i],"-lth_cor") == 0)  lth_cor  = atof(argv[++i]);
 			  if(strcmp(argv[i],"-lth_ncor") == 0)  lth_ncor  = atof(argv[++i]);
@@ -339,44 +344,36 @@ void read_arg(int argc, char *argv[]){
 //==================================================================
 //====================== Read matrices files =======================
 //==================================================================
-pssm *readmat(FILE *fp,int *matnum){
-	char currline[128];
-	int width; //i, count=0;
-	float a,c,g,t;
+pssm *readmat(char *file,char *format,int *matnum){
+	int i,j,k;
 	pssm *matab;
-	regex_t pregAC,pregID;
-	//regmatch_t *pmatch = NULL;
-	
-	regcomp(&pregAC,"^AC[[:space:]]+[^[:space:]]+",REG_EXTENDED| REG_NOSUB);
-	regcomp(&pregID,"^ID[[:space:]]+[^[:space:]]+",REG_EXTENDED| REG_NOSUB);
+	matrix_db_t *db;
 	
-	*matnum=0;
-	matab=NULL;
-	while (fgets(currline,128,fp) != NULL) {
-		width=0;
-		if (regexec(&pregAC,currline,0,NULL,0)==0) {
-			matab=(pssm *)realloc(matab,(++*matnum)*sizeof(pssm));
-			matab[*matnum-1].mat=NULL;
-			sscanf(currline,"AC %s",matab[*matnum-1].ID);
-			fgets(currline,128,fp);
-			while (strstr(currline,"//")==NULL) {
-				if (regexec(&pregID,currline,0,NULL,0)==0) {
-					sscanf(currline,"ID %s",matab[*matnum-1].name);
-				}
-				else if (sscanf(currline,"%*d %f %f %f %f",&a,&c,&g,&t)==4){
-					width++;
-					matab[*matnum-1].mat=(float **)realloc(matab[*matnum-1].mat, (width)*sizeof(float *));
-					matab[*matnum-1].mat[width-1]=(float *)malloc(4*sizeof(float));
-					matab[*matnum-1].mat[width-1][0]=a;
-					matab[*matnum-1].mat[width-1][1]=c;
-					matab[*matnum-1].mat[width-1][2]=g;
-					matab[*matnum-1].mat[width-1][3]=t;
-				}
-				fgets(currline,128,fp);
+	if (parse_matrix_format(format) < 0) {
+		fprintf(stderr,"Error: unsupported matrix format '%s'\n",format);
+		exit(1);
+	}
+	db=read_matrix_db(file,parse_matrix_format(format));
+	if (db == NULL) {
+		fprintf(stderr,"Error: unable to read %s matrices from '%s'\n",format,file);
+		exit(1);
+	}
+	*matnum=db->n;
+	matab=(pssm *)malloc(db->n*sizeof(pssm));
+	for (k=0; k<db->n; k++) {
+		strcpy(matab[k].ID,db->matrices[k].id);
+		strcpy(matab[k].name,db->matrices[k].name);
+		matab[k].width=db->matrices[k].width;
+		matab[k].nrow=4;
+		matab[k].mat=(float **)malloc(matab[k].width*sizeof(float *));
+		for (i=0; i<matab[k].width; i++) {
+			matab[k].mat[i]=(float *)malloc(4*sizeof(float));
+			for (j=0; j<4; j++) {
+				matab[k].mat[i][j]=matrix_db_column(db,k,i)[j];
 			}
-			matab[*matnum-1].width=width;
 		}
-	}	
+	}
+	free_matrix_db(db);
 	return matab;
 }
 
@@ -502,7 +499,7 @@ double crude_freq(pssm m,int r,int c) {
 //=======================================================================
 void print_help(void){
 	printf("compare-matrices-quick is a simplified C translation of compare_matrices developed by Jacques Van Helden. ");
-	printf("It takes as input a reference matrices file and a query matrices file (both transfac formated) and computes correlations for each possible couple of matrices.\n");
+	printf("It takes as input a reference matrices file and a query matrices file (transfac formated by default) and computes correlations for each possible couple of matrices.\n");
 	printf("The output consists in a tab-delimited file containing one line per match (i.e. alignments with correlations scores above user-defined thresholds) following the format:\n\n");
 
 	printf("<Query matrix ID>  <Ref. Matrix ID>  <Query name>  <Ref name>  <cor> <Ncor>  <Ncor1>  <Ncor2>  <Query matrix length>  <Ref length>  <offset>  <Strand>\n\n");
@@ -516,6 +513,9 @@ void print_help(void){
 	printf("\t<uncounted>\tindicates the number of matches that were not counted because of a beter match in a close vicinity or on the other strand\n\n");
 
 	printf("Synopsis: compmat -o <ouput_file> -file1 <ref_matrices_file> -file2 <query_matrices_file> \\\n");
+	printf("\t\t[-format <format>]\t\t\tformat of both matrices files: transfac (default), tab, jaspar, meme or cluster-buster\n");
+	printf("\t\t[-format1 <format>]\t\t\tformat of the reference matrices file\n");
+	printf("\t\t[-format2 <format>]\t\t\tformat of the query matrices file\n");
 	printf("\t\t[-lth_w <min_aligned_columns>]\t\tmin treshold on matrices overlap (default 5)\n");
 	printf("\t\t[-lth_cor <min_aligned_columns>]\t\tmin threshold on correlation (default 0.7)\n\n");
 	printf("\t\t[-lth_ncor <min_ncor>]\t\t\tmin threshold on normalized correlation (default 0.4)\n");
@@ -6,6 +6,7 @@
 // 
 
 #include "count.h"
+#include "dna.h"
 
 // gobals
 #define ALPHABET_SIZE 4
@@ -104,6 +105,7 @@ void init_last_position_array(long *array, int oligo_length, int full_oligo_leng
         array[i] = -full_oligo_length;
 }
 
+// index of the oligo at pos of the encoded sequence (see dna.h), -1 if it contains N
 int oligo2int(char *string, int pos, int length)
 {
     int value = 0;
@@ -111,27 +113,10 @@ int oligo2int(char *string, int pos, int length)
     int i;
     for (i = length - 1; i >= 0; i--) 
     {
-        switch (string[pos + i]) 
-        {
-        case 'A':
-        case 'a':
-            value += S * 0;
-            break;
-        case 'C':
-        case 'c':
-            value += S * 1;
-            break;
-        case 'G':
-        case 'g':
-            value += S * 2;
-            break;
-        case 'T':
-        case 't':
-            value += S * 3;
-            break;
-        default:
+        int code = string[pos + i];
+        if (code < 0)
             return -1;
-        }
+        value += S * code;
         S *= ALPHABET_SIZE;
     }
     return value;
@@ -144,27 +129,10 @@ int oligo2int_rc(char *string, int pos, int length)
     int i;
     for (i = 0; i < length; i++) 
     {
-        switch (string[pos + i]) 
-        {
-        case 'A':
-        case 'a':
-            value += S * 3;
-            break;
-        case 'C':
-        case 'c':
-            value += S * 2;
-            break;
-        case 'G':
-        case 'g':
-            value += S * 1;
-            break;
-        case 'T':
-        case 't':
-            value += S * 0;
-            break;
-        default:
+        int code = string[pos + i];
+        if (code < 0)
             return -1;
-        }
+        value += S * (3 - code);
         S *= ALPHABET_SIZE;
     }
     return value;
@@ -219,7 +187,9 @@ void count_occ(long *count_table, long *last_position, long *overlapping_occ, ch
     int index_f = -1;  // forward strand
     int index_r = -1;  // reverse strand
     
+    // residue codes in place, every other character is N
     int string_size = (int) strlen(string);
+    dna_encode_all(string, string_size, string);
     for (i = 0; i < string_size - full_motif_length + 1; i++) 
     {
             // compute index
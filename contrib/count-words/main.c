@@ -10,6 +10,7 @@
 // #include <limits.h>
 #include "utils.h"
 #include "count.h"
+#include "zio.h"
 
 int VERSION = 20140213;
 
@@ -175,12 +176,9 @@ int main(int argc, char *argv[])
     struct tm * start_time;
     start_time = localtime(&rawtime);
 
-    FILE *input_fp = stdin;
+    // stdin if no filename, plain, gzip or BGZF
+    FILE *input_fp = zopen(input_filename);
     FILE *output_fp = stdout;
-    if (input_filename)
-    {
-        input_fp = fopen(input_filename, "r");
-    }
     if (!input_fp)
     {
        ERROR("can not read from file '%s'", input_filename);
@@ -200,14 +198,20 @@ int main(int argc, char *argv[])
     {
         for (spacing = spacing_tab[0] + 1; spacing <= spacing_tab[1]; spacing++)
         {
-            fseek(input_fp, SEEK_SET, 0);
+            // compressed input can not be rewound
+            if (input_filename)
+            {
+                zclose(input_fp);
+                input_fp = zopen(input_filename);
+            }
+            else
+                fseek(input_fp, SEEK_SET, 0);
             count_in_file(input_fp, output_fp, oligo_length, spacing, add_rc, noov, grouprc, argc, argv, 0);
         }
     }
 
     fflush(output_fp);
-    if (input_filename)
-        fclose(input_fp);
+    zclose(input_fp);
     if (output_filename)
         fclose(output_fp);
 
@@ -1,112 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <ctype.h>
 
+#include "dust.h"
+
 #define TRUE   1
 #define FALSE  0
 
-static int word = 3; 
-static int window = 64; 
-static int window2 = 32; 
-static int level = 20;
+/*
+ * Masker context.  All the state of the algorithm lives in a DUST
+ * record, so that several contexts can be used concurrently (one per
+ * thread).  The set_dust_*(), dust() and dust_segs() functions keep
+ * working on a default context.
+ */
+
+static DUST *dflt;
+
+static DUST *dust_default()
+{
+	if (dflt == NULL) {
+		dflt = dust_new();
+	}
+	return dflt;
+}
+
+static void *dust_realloc(ptr, size)
+void *ptr;
+size_t size;
+{
+	if ((ptr = realloc(ptr, size)) == NULL) {
+		fprintf(stderr, "Error: Not enough memory.\n");
+		exit(1);
+	}
+	return ptr;
+}
 
-static int mv, iv, jv;
+DUST *dust_new()
+{
+	DUST *d;
+
+	d = dust_realloc(NULL, sizeof(DUST));
+	memset(d, 0, sizeof(DUST));
+	d->word = 3;
+	d->window = 64;
+	d->window2 = 32;
+	d->level = 20;
+	return d;
+}
+
+/* new context with the same parameters as d */
+DUST *dust_copy(d)
+DUST *d;
+{
+	DUST *c;
+
+	c = dust_new();
+	c->word = d->word;
+	c->window = d->window;
+	c->window2 = d->window2;
+	c->level = d->level;
+	return c;
+}
+
+void dust_free(d)
+DUST *d;
+{
+	free(d->wcode);
+	free(d->wkey);
+	free(d->wid);
+	free(d->wprev);
+	free(d->wlast);
+	free(d->pairs);
+	free(d->edges);
+	free(d->reg);
+	free(d);
+}
+
+void dust_set_level(d, value)
+DUST *d;
+int value;
+{
+	d->level = value;
+}
+
+void dust_set_window(d, value)
+DUST *d;
+int value;
+{
+	d->window = value;
+	d->window2 = value / 2;
+}
+
+void dust_set_word(d, value)
+DUST *d;
+int value;
+{
+	d->word = value;
+}
 
 void set_dust_level(value)
 int value;
 {
-	level = value;
+	dust_set_level(dust_default(), value);
 }
 
 void set_dust_window(value)
 int value;
 {
-	window = value;
-	window2 = window / 2;
+	dust_set_window(dust_default(), value);
 }
 
 void set_dust_word(value)
 int value;
 {
-	word = value;
+	dust_set_word(dust_default(), value);
 }
 
-static void wo1(len, s, ivv)
+/*
+ * Window scoring.
+ *
+ * The score of a window is the maximum, over all sub-intervals [i,e],
+ * of 10 * (number of pairs of identical triplets in [i,e]) / (e - i).
+ * The original implementation rescanned every start offset and looked
+ * up each triplet with a linear search, i.e. O(window^3) per window.
+ *
+ * Here the triplets of the window are encoded once into dense ids
+ * chained to their previous occurrence, and the end position e advances
+ * incrementally (as in symmetric DUST).  Each new triplet only walks its
+ * own occurrence chain: an earlier occurrence at p forms one new pair for
+ * every start i <= p - d, which is recorded as pairs[p-d]++.  The pair
+ * count of start i is then the suffix sum of pairs[] from i, so a single
+ * backward pass over the starts scores every interval ending at e.  The
+ * pass stops as soon as the interval is too long to beat the current
+ * maximum even with all the pairs seen so far.  The maximum and its
+ * position (earliest start, then earliest end) are identical to the
+ * original algorithm.
+ */
+
+static void wo_alloc(d, len)
+DUST *d;
 int len;
+{
+	if (len <= d->wcap) {
+		return;
+	}
+	d->wcap = len;
+	d->wcode = dust_realloc(d->wcode, len * sizeof(int));
+	d->wkey = dust_realloc(d->wkey, len * sizeof(int));
+	d->wid = dust_realloc(d->wid, len * sizeof(int));
+	d->wprev = dust_realloc(d->wprev, len * sizeof(int));
+	d->wlast = dust_realloc(d->wlast, len * sizeof(int));
+	d->pairs = dust_realloc(d->pairs, len * sizeof(int));
+	d->edges = dust_realloc(d->edges, len * sizeof(int));
+}
+
+/*
+ * Triplets ending at i or i+1 are only counted when word < 3, and their
+ * code depends on the start i (letters before i read as 'a').  Returns
+ * the number of pairs they add to start i when the triplet ending at e
+ * (e > i) is appended.
+ */
+static int wo_edge(d, s, i, e)
+DUST *d;
 char *s;
-int ivv;
+int i, e;
 {
-	int i, ii, j, v, t, n, n1, sum;
-	static int counts[32*32*32];
-	static int iis[32*32*32];
-	int js, nis;
+	int k0 = -1, k1 = -1, n = 0;
 
-	n = 32 * 32 * 32;
-	n1 = n - 1;
-	nis = 0;
-	i = 0;
-	ii = 0;
-	sum = 0;
-	v = 0;
-	for (j=0; j < len; j++, s++) {
-		ii <<= 5;
-		if (isalpha(*s)) {
-			if (islower(*s)) {
-				ii |= *s - 'a';
-			} else {
-				ii |= *s - 'A';
-			}
-		} else {
-			i = 0;
-			continue;
-		}
-		ii &= n1;
-		i++;
-		if (i >= word) {
-			for (js=0; js < nis && iis[js] != ii; js++) ;
-			if (js == nis) {
-				iis[nis] = ii;
-				counts[ii] = 0;
-				nis++;
-			}
-			if ((t = counts[ii]) > 0) {
-				sum += t;
-				v = 10 * sum / j;
-				if (mv < v) {
-					mv = v;
-					iv = ivv;
-					jv = j;
-				}
-			}
-			counts[ii]++;
-		}
+	if (d->word <= 1 && isalpha(s[i])) {
+		k0 = d->wcode[i];
 	}
+	if (isalpha(s[i+1]) && (isalpha(s[i]) ? 2 : 1) >= d->word) {
+		k1 = (d->wcode[i] << 5) | d->wcode[i+1];
+	}
+	if (e == i + 1) {
+		return (k0 >= 0 && k0 == k1);
+	}
+	if (e >= i + 2 && d->wid[e] >= 0) {
+		n += (d->wkey[e] == k0);
+		n += (d->wkey[e] == k1);
+	}
+	return n;
 }
 
-static int wo(len, s, beg, end)
+static int wo(d, len, s, beg, end)
+DUST *d;
 int len;
 char *s;
 int *beg, *end;
 {
-	int i, j, l1, v;
+	int i, e, p, k, c, off, n, lo, sum, total, run, ii, nid;
+	int mv, iv, jv, mvb;
+	int word = d->word;
+	int n1 = NTRIPLETS - 1;
+	int *pairs, *edges, *wprev;
 
-	l1 = len - word + 1;
-	if (l1 < 0) {
+	if (len - word + 1 < 0) {
 		*beg = 0;
 		*end = len - 1;
 		return 0;
 	}
+	wo_alloc(d, len);
+	pairs = d->pairs;
+	edges = d->edges;
+	wprev = d->wprev;
+
+	/*
+	 * The triplet ending at p is counted for start i when p >= i + off
+	 * (shorter ones are the word < 3 edge triplets, see wo_edge()).
+	 */
+	off = (word - 1 > 2) ? word - 1 : 2;
+
+	/* letter codes, triplet keys and occurrence chains */
+	ii = 0;
+	run = 0;
+	nid = 0;
+	for (p=0; p < len; p++) {
+		ii <<= 5;
+		if (isalpha(s[p])) {
+			c = islower(s[p]) ? s[p] - 'a' : s[p] - 'A';
+			ii |= c;
+			run++;
+		} else {
+			c = 0;
+			run = 0;
+		}
+		ii &= n1;
+		d->wcode[p] = c;
+		d->wkey[p] = ii;
+		d->wid[p] = -1;
+		wprev[p] = -1;
+		if (run > 0 && run >= word && p >= off) {
+			if (d->tid[ii] == 0) {
+				d->tid[ii] = ++nid;
+				d->wlast[nid-1] = -1;
+			}
+			k = d->tid[ii] - 1;
+			d->wid[p] = k;
+			wprev[p] = d->wlast[k];
+			d->wlast[k] = p;
+		}
+	}
+	for (p=0; p < len; p++) {
+		d->tid[d->wkey[p]] = 0;
+	}
+
 	mv = 0;
 	iv = 0;
 	jv = 0;
-	for (i=0; i < l1; i++) {
-		wo1(len-i, s+i, i);
+	mvb = 1;
+	memset(pairs, 0, len * sizeof(int));
+	memset(edges, 0, len * sizeof(int));
+	total = 0;
+	for (e=0; e < len; e++) {
+		for (p=wprev[e]; p >= off; p=wprev[p]) {
+			pairs[p-off]++;
+			total++;
+		}
+		if (word <= 2) {
+			for (i=0; i < e; i++) {
+				edges[i] += wo_edge(d, s, i, e);
+			}
+		}
+		/* no start farther than 10*total/mvb can reach the maximum */
+		lo = (word <= 2) ? 0 : e - 10 * total / mvb;
+		sum = 0;
+		for (i=e-1; i >= lo && i >= 0; i--) {
+			sum += pairs[i];
+			n = 10 * (sum + edges[i]);
+			if (n >= ((i < iv) ? mvb : mv + 1) * (e - i)) {
+				mv = mvb = n / (e - i);
+				iv = i;
+				jv = e - i;
+			}
+		}
 	}
 	*beg = iv;
 	*end = iv + jv;
 	return mv;
 }
 
-void dust(len, s)
+static void add_region(d, from, to, score)
+DUST *d;
+int from, to, score;
+{
+	if (d->nreg + 1 >= d->regcap) {
+		d->regcap = (d->regcap > 0) ? 2 * d->regcap : 64;
+		d->reg = dust_realloc(d->reg, d->regcap * sizeof(REGION));
+	}
+	d->reg[d->nreg].from = from;
+	d->reg[d->nreg].to = to;
+	d->reg[d->nreg].score = score;
+	d->nreg++;
+}
+
+/*
+ * Score the windows of s starting at first, first+window2, ... < last,
+ * and store in d->reg the interval [from,to] to be masked for each
+ * window above the level.  Windows extend up to len, so s must hold
+ * window - window2 bases after last unless it ends the sequence.
+ * With an even window, each window only reads bases that no other
+ * window masks before it is scored, so the mask of dust_mask() is the
+ * union of these intervals and chunks of a sequence aligned on window2
+ * can be scored independently.  Returns d->nreg.
+ */
+int dust_hits(d, len, s, first, last)
+DUST *d;
+int len;
+char *s;
+int first, last;
+{
+	int i, l, a, b, v;
+
+	d->nreg = 0;
+	for (i=first; i < last && i < len; i += d->window2) {
+		l = (len > i+d->window) ? d->window : len-i;
+		v = wo(d, l, s+i, &a, &b);
+		if (v > d->level) {
+			add_region(d, a + i, b + i, v);
+		}
+	}
+	return d->nreg;
+}
+
+/* replace the letters of the regions, shifted by offset, by N */
+void dust_apply(s, reg, nreg, offset)
+char *s;
+REGION *reg;
+int nreg, offset;
+{
+	int i, j;
+
+	for (i=0; i < nreg; i++) {
+		for (j = reg[i].from - offset; j <= reg[i].to - offset; j++) {
+			if (isalpha(s[j]))
+				s[j] = 'N';
+		}
+	}
+}
+
+/*
+ * Mask s in place.  The part of a window's region lying in the next
+ * window is only masked after that window has been scored; with an odd
+ * window the last base of a region may still be seen masked by the
+ * window after next.
+ */
+void dust_mask(d, len, s)
+DUST *d;
 int len;
 char *s;
 {
@@ -114,17 +356,17 @@ char *s;
 
 	from = 0;
 	to = -1;
-	for (i=0; i < len; i += window2) {
-		from -= window2;
-		to -= window2;
-		l = (len > i+window) ? window : len-i;
-		v = wo(l, s+i, &a, &b);
+	for (i=0; i < len; i += d->window2) {
+		from -= d->window2;
+		to -= d->window2;
+		l = (len > i+d->window) ? d->window : len-i;
+		v = wo(d, l, s+i, &a, &b);
 		for (j = from; j <= to; j++) {
 			if (isalpha(s[i+j]))
 				s[i+j] = 'N';
 		}
-		if (v > level) {
-			for (j = a; j <= b && j < window2; j++) {
+		if (v > d->level) {
+			for (j = a; j <= b && j < d->window2; j++) {
 				if (isalpha(s[i+j]))
 					s[i+j] = 'N';
 			}
@@ -137,44 +379,47 @@ char *s;
 	}
 }
 
-#define MAXREG    1001
-
-typedef struct {
-	int from;
-	int to;
-	int score;
-} REGION;
-
-static REGION reg[MAXREG];
-static int nreg;
-
-REGION *dust_segs(len, s)
+/*
+ * Merged low-complexity regions of s, terminated by a region with
+ * to == -1.  The array belongs to d and is overwritten by the next call.
+ */
+REGION *dust_regions(d, len, s)
+DUST *d;
 int len;
 char *s;
 {
-	int i, j, l, from, to, a, b, v;
+	int i, l, a, b, v;
 
-	nreg = 0;
-	from = 0;
-	to = -1;
-	for (i=0; i < len; i += window2) {
-		l = (len > i+window) ? window : len-i;
-		v = wo(l, s+i, &a, &b);
-		if (v > level) {
-			if (nreg > 0 && reg[nreg-1].to+1 >= a+i) {
-				reg[nreg-1].to = b + i;
-			} else if (nreg < MAXREG-1) {
-				reg[nreg].from = a + i;
-				reg[nreg].to = b + i;
-				nreg++;
+	d->nreg = 0;
+	for (i=0; i < len; i += d->window2) {
+		l = (len > i+d->window) ? d->window : len-i;
+		v = wo(d, l, s+i, &a, &b);
+		if (v > d->level) {
+			if (d->nreg > 0 && d->reg[d->nreg-1].to+1 >= a+i) {
+				d->reg[d->nreg-1].to = b + i;
+			} else {
+				add_region(d, a + i, b + i, v);
 			}
-			if (b < window2) {
-				i += b - window2;
+			if (b < d->window2) {
+				i += b - d->window2;
 			}
 		}
 	}
-	reg[nreg].from = 0;
-	reg[nreg].to = -1;
-	return reg;
+	add_region(d, 0, -1, 0);
+	d->nreg--;
+	return d->reg;
 }
 
+void dust(len, s)
+int len;
+char *s;
+{
+	dust_mask(dust_default(), len, s);
+}
+
+REGION *dust_segs(len, s)
+int len;
+char *s;
+{
+	return dust_regions(dust_default(), len, s);
+}
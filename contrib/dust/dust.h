@@ -0,0 +1,49 @@
+#ifndef DUST_H
+#define DUST_H
+
+#include "getfa.h"
+
+#define NTRIPLETS (32*32*32)
+
+/*
+ * Reentrant DUST masker.  A context holds the parameters and the
+ * scratch arrays of the window scoring; use one context per thread.
+ */
+typedef struct {
+	int word;
+	int window;
+	int window2;
+	int level;
+
+	int tid[NTRIPLETS];	/* triplet -> dense id + 1 (0: unseen) */
+	int *wcode, *wkey, *wid, *wprev, *wlast, *pairs, *edges;
+	int wcap;
+
+	REGION *reg;		/* regions of the last call */
+	int nreg;
+	int regcap;
+} DUST;
+
+DUST *dust_new();
+DUST *dust_copy();
+void dust_free();
+void dust_set_level();
+void dust_set_window();
+void dust_set_word();
+
+int dust_hits();
+void dust_apply();
+void dust_mask();
+REGION *dust_regions();
+
+/* dust_stream.c */
+void dust_stream();
+
+/* default context */
+void set_dust_level();
+void set_dust_window();
+void set_dust_word();
+void dust();
+REGION *dust_segs();
+
+#endif
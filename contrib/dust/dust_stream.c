@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "dust.h"
+
+/*
+ * Streaming, multithreaded masking of a FASTA file.
+ *
+ * Records are read base by base into chunks of a fixed size (a multiple
+ * of window2), each one extended by the window - window2 bases needed by
+ * its last windows.  The chunks are scored by a pool of worker threads,
+ * each with its own DUST context, while the main thread keeps reading.
+ * Chunks are masked and written back in input order by the main thread;
+ * the regions of a chunk that spill over its end are carried to the next
+ * one.  At most 2 * nthreads + 1 chunks are held in memory, whatever the
+ * length of the records, and the output is identical to getfafun(name,
+ * dust).  With an odd window the chunks of a record are not independent
+ * (see dust_hits()), so whole records are masked instead.
+ */
+
+#define DUST_CHUNK  (1 << 20)
+
+void abo();
+FILE *myfopen();
+
+typedef struct {
+	char *header;	/* record header, on the first chunk only */
+	char *seq;
+	int cap;
+	int len;	/* bases held, including the overlap */
+	int own;	/* windows starting before own belong to this chunk */
+	int last;	/* last chunk of its record */
+	REGION *reg;
+	int nreg;
+	int regcap;
+	int done;
+} CHUNK;
+
+typedef struct {
+	CHUNK *ring;
+	int nring;
+	int cap;	/* initial capacity of each chunk buffer */
+	int whole;	/* odd window: mask whole records, see dust_hits() */
+	int head;	/* oldest chunk not yet written */
+	int next;	/* next chunk to score */
+	int tail;	/* next chunk to fill */
+	int quit;
+	DUST *proto;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+
+	/* writer state */
+	int col;
+	REGION *carry;
+	int ncarry;
+	int carrycap;
+} POOL;
+
+static void *worker(arg)
+void *arg;
+{
+	POOL *pool = arg;
+	DUST *d;
+	CHUNK *c;
+
+	d = dust_copy(pool->proto);
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->next == pool->tail && !pool->quit) {
+			pthread_cond_wait(&pool->work, &pool->lock);
+		}
+		if (pool->next == pool->tail) {
+			break;
+		}
+		c = &pool->ring[pool->next % pool->nring];
+		pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (pool->whole) {
+			dust_mask(d, c->len, c->seq);
+			d->nreg = 0;
+		} else {
+			dust_hits(d, c->len, c->seq, 0, c->own);
+		}
+		if (d->nreg > c->regcap) {
+			c->regcap = d->nreg;
+			free(c->reg);
+			c->reg = mymalloc(c->regcap * sizeof(REGION));
+		}
+		memcpy(c->reg, d->reg, d->nreg * sizeof(REGION));
+		c->nreg = d->nreg;
+
+		pthread_mutex_lock(&pool->lock);
+		c->done = 1;
+		pthread_cond_broadcast(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	dust_free(d);
+	return NULL;
+}
+
+/* mask and print the oldest chunk, in the format of putfa() */
+static void write_chunk(pool)
+POOL *pool;
+{
+	CHUNK *c;
+	char *s;
+	int i, n;
+
+	c = &pool->ring[pool->head % pool->nring];
+	pthread_mutex_lock(&pool->lock);
+	while (!c->done) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (c->header != NULL) {
+		s = c->header;
+		if (*s != '>') {
+			putchar('>');
+		}
+		fwrite(s, 1, strlen(s), stdout);
+		free(c->header);
+		c->header = NULL;
+		pool->col = 50;
+	}
+	dust_apply(c->seq, pool->carry, pool->ncarry, 0);
+	dust_apply(c->seq, c->reg, c->nreg, 0);
+	for (i=0; i < c->own; i += n) {
+		if (pool->col == 50) {
+			putchar('\n');
+			pool->col = 0;
+		}
+		n = 50 - pool->col;
+		if (n > c->own - i) {
+			n = c->own - i;
+		}
+		fwrite(c->seq + i, 1, n, stdout);
+		pool->col += n;
+	}
+
+	/* regions running into the next chunk */
+	pool->ncarry = 0;
+	if (!c->last) {
+		if (c->nreg > pool->carrycap) {
+			pool->carrycap = c->nreg;
+			free(pool->carry);
+			pool->carry = mymalloc(pool->carrycap * sizeof(REGION));
+		}
+		for (i=0; i < c->nreg; i++) {
+			if (c->reg[i].to >= c->own) {
+				n = pool->ncarry++;
+				pool->carry[n].from = (c->reg[i].from > c->own)
+					? c->reg[i].from - c->own : 0;
+				pool->carry[n].to = c->reg[i].to - c->own;
+				pool->carry[n].score = c->reg[i].score;
+			}
+		}
+	} else {
+		putchar('\n');
+	}
+	pool->head++;
+}
+
+/* next chunk to fill, writing out the oldest one if all are in use */
+static CHUNK *fresh(pool)
+POOL *pool;
+{
+	CHUNK *c;
+
+	if (pool->tail - pool->head == pool->nring) {
+		write_chunk(pool);
+	}
+	c = &pool->ring[pool->tail % pool->nring];
+	if (c->seq == NULL) {
+		c->cap = pool->cap;
+		c->seq = mymalloc(c->cap);
+	}
+	c->header = NULL;
+	c->len = 0;
+	c->own = 0;
+	c->last = 0;
+	c->nreg = 0;
+	c->done = 0;
+	return c;
+}
+
+/* hand the filled chunk to the workers and return the next one to fill */
+static CHUNK *submit(pool)
+POOL *pool;
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->tail++;
+	pthread_cond_signal(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	return fresh(pool);
+}
+
+void dust_stream(name, proto, nthreads, chunk)
+char *name;
+DUST *proto;
+int nthreads;
+int chunk;
+{
+	POOL pool;
+	pthread_t *threads;
+	CHUNK *c, *prev;
+	FILE *fp;
+	char *head;
+	int ch, len, headlen, overlap, i;
+
+	if (nthreads < 1) {
+		nthreads = 1;
+	}
+	if (chunk <= 0) {
+		chunk = DUST_CHUNK;
+	}
+	if (proto->window2 < 1) {
+		abo("Window too small");
+	}
+	/* own part of a chunk: a multiple of window2, at least one window */
+	overlap = proto->window - proto->window2;
+	if (chunk < proto->window) {
+		chunk = proto->window + proto->window2 - 1;
+	}
+	chunk -= chunk % proto->window2;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.nring = 2 * nthreads + 1;
+	pool.ring = mymalloc(pool.nring * sizeof(CHUNK));
+	memset(pool.ring, 0, pool.nring * sizeof(CHUNK));
+	pool.cap = chunk + overlap;
+	pool.proto = proto;
+	pool.whole = (proto->window % 2 != 0);
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.work, NULL);
+	pthread_cond_init(&pool.done, NULL);
+	threads = mymalloc(nthreads * sizeof(pthread_t));
+	for (i=0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, worker, &pool) != 0) {
+			abo("Cannot create thread");
+		}
+	}
+
+	fp = myfopen(name, "r");
+	ch = getc(fp);
+	if (ch == EOF || ch != '>') {
+		abo("Not a FASTA file");
+	}
+	c = fresh(&pool);
+	do {
+		/* header */
+		len = 0;
+		headlen = 64;
+		head = mymalloc(headlen);
+		while ((ch = getc(fp)) != EOF && ch != '\n') {
+			if (len >= headlen-1) {
+				headlen *= 2;
+				head = realloc(head, headlen);
+				if (head == NULL) {
+					abo("Not enough memory");
+				}
+			}
+			head[len++] = ch;
+		}
+		if (ch == EOF) {
+			abo("Not a FASTA file");
+		}
+		head[len] = '\0';
+		c->header = head;
+
+		/* sequence, in chunks overlapping by window - window2 */
+		while ((ch = getc(fp)) != EOF && ch != '>') {
+			if (isspace(ch)) {
+				continue;
+			}
+			if (c->len == c->cap && pool.whole) {
+				c->cap *= 2;
+				c->seq = realloc(c->seq, c->cap);
+				if (c->seq == NULL) {
+					abo("Not enough memory");
+				}
+			} else if (c->len == c->cap) {
+				c->own = chunk;
+				prev = c;
+				c = submit(&pool);
+				memcpy(c->seq, prev->seq + chunk, overlap);
+				c->len = overlap;
+			}
+			c->seq[c->len++] = ch;
+		}
+		c->own = c->len;
+		c->last = 1;
+		c = submit(&pool);
+	} while (ch == '>');
+	if (fp != stdin) {
+		fclose(fp);
+	}
+
+	while (pool.head < pool.tail) {
+		write_chunk(&pool);
+	}
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+	for (i=0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	for (i=0; i < pool.nring; i++) {
+		free(pool.ring[i].seq);
+		free(pool.ring[i].reg);
+	}
+	free(pool.ring);
+	free(pool.carry);
+	free(threads);
+	pthread_mutex_destroy(&pool.lock);
+	pthread_cond_destroy(&pool.work);
+	pthread_cond_destroy(&pool.done);
+}
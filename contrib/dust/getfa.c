@@ -80,13 +80,13 @@ char *name;
 	head = mymalloc(1);
 	while ((c = getc(fp)) != EOF && c != '\n') {
 		if (len >= buflen-1) {
-			buf = mymalloc(len + NINC);
+			buf = mymalloc(2 * len + NINC);
 			if (len > 0) {
 				memcpy(buf, head, len);
 				free(head);
 			}
 			head = buf;
-			buflen = len + NINC;
+			buflen = 2 * len + NINC;
 		}
 		head[len] = c;
 		len++;
@@ -101,13 +101,13 @@ char *name;
 			continue;
 		}
 		if (len >= buflen-1) {
-			buf = mymalloc(len + NINC);
+			buf = mymalloc(2 * len + NINC);
 			if (len > 0) {
 				memcpy(buf, sq, len);
 				free(sq);
 			}
 			sq = buf;
-			buflen = len + NINC;
+			buflen = 2 * len + NINC;
 		}
 		sq[len] = c;
 		len++;
@@ -130,14 +130,13 @@ char *name;
 	FILE *fp;
 	char *s;
 	int i, i60;
-	size_t ignore; /* keep compiler happy */
 
 	fp = myfopen(name, "w");
 	s = (fa->header == NULL) ? "ANONYMOUS" : fa->header;
 	if (*s != '>') {
 		putc('>', fp);
 	}
-	ignore = fwrite(s, 1, strlen(s), fp); /* keep compiler happy */
+	(void) fwrite(s, 1, strlen(s), fp);
 	i60 = 50;
 	for (i=0, s = fa->seq; i < fa->len; i++, s++, i60++) {
 		if (i60 == 50) {
@@ -177,13 +176,13 @@ void (*fun)();
 		len = 0;
 		while ((c = getc(fp)) != EOF && c != '\n') {
 			if (len >= headlen-1) {
-				buf = mymalloc(len + NINC);
+				buf = mymalloc(2 * len + NINC);
 				if (len > 0) {
 					memcpy(buf, head, len);
 					free(head);
 				}
 				head = buf;
-				headlen = len + NINC;
+				headlen = 2 * len + NINC;
 			}
 			head[len] = c;
 			len++;
@@ -196,13 +195,13 @@ void (*fun)();
 				continue;
 			}
 			if (len >= sqlen-1) {
-				buf = mymalloc(len + NINC);
+				buf = mymalloc(2 * len + NINC);
 				if (len > 0) {
 					memcpy(buf, sq, len);
 					free(sq);
 				}
 				sq = buf;
-				sqlen = len + NINC;
+				sqlen = 2 * len + NINC;
 			}
 			sq[len] = c;
 			len++;
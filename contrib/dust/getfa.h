@@ -1,3 +1,6 @@
+#ifndef GETFA_H
+#define GETFA_H
+
 typedef struct {
 	int len;
 	char *header;
@@ -7,8 +10,6 @@ typedef struct {
 FASTA *getfa();
 void *mymalloc();
 
-#define MAXREG    1001
-
 typedef struct {
 	int from;
 	int to;
@@ -17,5 +18,4 @@ typedef struct {
 
 REGION *dust_segs();
 
-
-
+#endif
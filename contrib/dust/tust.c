@@ -1,17 +1,15 @@
 #include <stdio.h>
 
 #include <stdlib.h> /* added for exit */
+#include <string.h>
 
-#include "getfa.h"
+#include "dust.h"
 
 int nword = 16;
 int nk = 3;
 
-void dust();
-
 void dust_rect() {}
 
-void set_dust_level(int value);
 void getfafun(char *name, void (*fun)());
 
 /*void main(argc, argv)
@@ -39,25 +37,35 @@ char *argv[];
 {
 	FASTA *fa;
 	REGION *reg;
+	DUST *d;
 	int level = 20;
+	int nthreads = 1;
 	int i;
 
+	/* -t N: number of masking threads */
+	if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+		nthreads = atoi(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
 	if (argc < 2) {
-		fprintf(stderr, "Usage: dust fasta-file [ cut-off ]\n");
+		fprintf(stderr, "Usage: dust [ -t threads ] fasta-file [ cut-off ]\n");
 		exit(1);
 	}
 	if (argc > 2) {
 		level = atoi(argv[2]);
 	}
-	set_dust_level(level);
+	d = dust_new();
+	dust_set_level(d, level);
 	if (argc >= 4) {
 		fa = getfa(argv[1]);
-		reg = dust_segs(fa->len, fa->seq);
+		reg = dust_regions(d, fa->len, fa->seq);
 		for (i=0; reg[i].to != -1; i++) {
 			printf("%6d..%d\n", reg[i].from, reg[i].to);
 		}
 	} else {
-		getfafun(argv[1], dust);
+		dust_stream(argv[1], d, nthreads, 0);
 	}
+	dust_free(d);
 	return(0);
 }
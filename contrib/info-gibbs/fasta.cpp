@@ -1,4 +1,6 @@
 #include "fasta.h"
+#include "zio.h"
+#include "dna.h"
 
 /***************************************************************************
  *                                                                         *
@@ -9,36 +11,20 @@
 Sequences convert_sequences(vector<string> &raw_sequences)
 {
     Sequences sequences = Sequences((int) raw_sequences.size());
+    int max_len = 0;
+    for (int s = 0; s < (int) raw_sequences.size(); s++)
+        max_len = max(max_len, (int) raw_sequences[s].size());
+    char *codes = new char[max_len + 1];
     for (int s = 0; s < sequences.size(); s++)
     {
         int len = (int) raw_sequences[s].size();
         sequences[s].data = new int[len];
         sequences[s].len = len;
-        for (int i = 0; i < sequences[s].size(); i++)
-        {
-            switch (raw_sequences[s][i])
-            {
-                case 'A':
-                sequences[s][i] = 0;
-                break;
-                
-                case 'C':
-                sequences[s][i] = 1;                
-                break;
-
-                case 'G':
-                sequences[s][i] = 2;
-                break;
-
-                case 'T':
-                sequences[s][i] = 3;
-                break;
-                
-                default:
-                sequences[s][i] = -1;
-            }
-        }
+        dna_encode_all(raw_sequences[s].data(), len, codes);
+        for (int i = 0; i < len; i++)
+            sequences[s][i] = codes[i];
     }
+    delete[] codes;
     return sequences;
 }
 
@@ -103,26 +89,19 @@ int read_fasta(vector<string> &sequences, char *filename, bool rc=false)
     vector<string> titles;
     int i = 0;
 
-    // read sequences
-    istream *f;
-    ifstream ifn;
-
-    if (filename == NULL)
-    {
-        f = &cin;
-    }
-    else
-    {
-        ifn.open(filename);
-        f = &ifn;
-    }
-
-    if (!f)
+    // read sequences (stdin if no filename, plain, gzip or BGZF)
+    FILE *f = zopen(filename);
+    if (f == NULL)
         return 0;
 
-    string line;
-    while (getline(*f, line))
+    char *buffer = NULL;
+    size_t capacity = 0;
+    ssize_t size;
+    while ((size = getline(&buffer, &capacity, f)) != -1)
     {
+        if (size > 0 && buffer[size - 1] == '\n')
+            buffer[--size] = '\0';
+        string line = string(buffer, size);
         if (line[0] == '>')
         {
             sequences.push_back(string());
@@ -134,9 +113,8 @@ int read_fasta(vector<string> &sequences, char *filename, bool rc=false)
                 sequences.back() += line;
         }
     }
-    
-    if (filename != NULL)
-        ifn.close();
+    free(buffer);
+    zclose(f);
 
     // convert sequences
     int n = sequences.size();
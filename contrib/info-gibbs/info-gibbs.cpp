@@ -112,6 +112,9 @@ void help()
 "                          [http://homes.esat.kuleuven.be/~thijs/help/help_motifsampler.html#background]    \n"
 "                          EXAMPLE --bgfile=mybgfile\n"
 "\n"
+"    --bg_format=#         format of the --bgfile file: inclusive (default) or oligos\n"
+"                          (oligo-analysis frequencies, 0.01 pseudo-frequency)\n"
+"\n"
 "    -d #, --dmin=#        set minimal distance between 2 motif occurrences to #\n"
 "\n"
 "    -t #                  set the temperature (should be in range [0.6 1.4])\n"
@@ -124,6 +127,9 @@ void help()
 "\n"
 "    --seedmatrix=#        start sampling form sites collected by scanning the sequences with matrix #\n"
 "\n"
+"    --seedmatrix_format=# format of the --seedmatrix file: tab (default), transfac, jaspar,\n"
+"                          meme or cluster-buster\n"
+"\n"
 "    --seedmatrix_sites=#  when using seed matrix specify the number of sites for each matrix (n1,n2,n3) \n"
 "\n"
 "    --flanks=#            when using --seedmatrix add extra # positions around the matrix\n"
@@ -197,7 +203,9 @@ int main(int argc, char *argv[])
     char *strand               = NULL;    // "+-" "+"
     char *seqfile              = NULL;
     char *bgfile               = NULL;
+    int  bg_format             = MARKOV_INCLUSIVE;
     char *matfile              = NULL;
+    int  matfile_format        = MATRIX_TAB;
     int  seedmatrix_sites[16];
     int  seedmatrix_sites_count = 0;
 
@@ -235,6 +243,7 @@ int main(int argc, char *argv[])
         { "iter",        required_argument, NULL, 'n' },
         { "temperature", required_argument, NULL, 't' },
         { "bgfile",      required_argument, NULL, 'b' },
+        { "bg_format",   required_argument, NULL, 'B' },
         { "verbose",     required_argument, NULL, 'v' },
         { "dmin",        required_argument, NULL, 'd' },
         { "motifs",      required_argument, NULL, 'm' },
@@ -243,6 +252,7 @@ int main(int argc, char *argv[])
         { "title",       required_argument, NULL, 'T' },
         { "seedmatrix",   required_argument, NULL, 'M' },
         { "seedmatrix_sites",  required_argument, NULL, 'Y' },
+        { "seedmatrix_format", required_argument, NULL, 'R' },
         { "flanks",      required_argument, NULL, 'K' },
         { "llr",         no_argument,       NULL, 'L' },
         { "pqllr",       no_argument,       NULL, 'X' },
@@ -352,6 +362,12 @@ int main(int argc, char *argv[])
             matfile = (char *) strdup(optarg);
             break;
 
+            case 'R':
+            matfile_format = parse_matrix_format(optarg);
+            if (matfile_format < 0)
+                ERROR("invalid matrix format '%s'", optarg);
+            break;
+
             case 'K': 
             params.flanks = atoi(optarg);
             CHECK_VALUE(params.flanks, 0, 100, "invalid number of run (should be between 0 and 100)")
@@ -365,6 +381,12 @@ int main(int argc, char *argv[])
             bgfile = (char *) strdup(optarg);
             break;
 
+            case 'B':
+            bg_format = parse_markov_format(optarg);
+            if (bg_format < 0)
+                ERROR("invalid background format '%s'", optarg);
+            break;
+
             case 'm':
             params.motifs = atoi(optarg);
             CHECK_VALUE(params.motifs, 1, 10, "invalid number of motifs (should be between 1 and 10)")
@@ -460,10 +482,11 @@ int main(int argc, char *argv[])
         params.n = (int) (sequences.len * params.e);
 
     // set bg model
-    Markov markov;
+    markov_t *bg;
     if (bgfile != NULL)
     {
-        if (load_inclusive(markov, bgfile) == 0)
+        bg = read_markov(bgfile, bg_format, 0.01);
+        if (bg == NULL)
         {
             ERROR("can not load bg model");
         }
@@ -471,9 +494,12 @@ int main(int argc, char *argv[])
     else
     {
         //double priori[4] = {0.25, 0.25, 0.25, 0.25};
-        //bernoulli(markov, priori);
-        bernoulli(markov, compute_priori(sequences));
+        //bg = new_markov_bernoulli(priori);
+        double *priori = compute_priori(sequences);
+        bg = new_markov_bernoulli(priori);
+        delete []priori;
     }
+    markov_t &markov = *bg;
 
     // read optional input sig matrices
     if (matfile != NULL)
@@ -481,16 +507,14 @@ int main(int argc, char *argv[])
         params.shift = false;
         if (params.dmin != 0)
             ERROR("option --seedmatrix is incompatible with --zoops or --dmin=#")
-        // open file
-        FILE *fp = fopen(matfile, "r");
-        if (fp == NULL)
-            ERROR("unable to open '%s'", matfile);
+        // read all the matrices
+        matrix_db_t *db = read_matrix_db(matfile, matfile_format);
+        if (db == NULL)
+            ERROR("unable to read matrices from '%s'", matfile);
         
-        while (1)
+        for (int k = 0; k < db->n; k++)
         {
-            Array matrix = read_matrix(fp);
-            if (matrix.J == 0)
-                break;
+            Array matrix = read_matrix(db, k);
             matrix.transform2logfreq(markov);
             params.start_from_sites = true;
             if (seedmatrix_sites_count > 0)
@@ -509,12 +533,14 @@ int main(int argc, char *argv[])
             run_sampler(raw_sequences, sequences, markov, params);
             params.id           += 1;
         }
+        free_matrix_db(db);
     }
     else
     {
         // run gibbs sampler
         run_sampler(raw_sequences, sequences, markov, params);
     }
+    free_markov(bg);
 
     //DEBUG("END info-gibbs");
     //VERBOSE1("end info-gibbs version %d\n", VERSION);
@@ -1,221 +1,206 @@
 /***************************************************************************
  *                                                                         *
  *  markov.h
- *  Markov chain
- *    
- *  
+ *  DNA Markov model (background) in oligo-analysis and INCLUSive formats
+ *
  *
  *                                                                         *
  ***************************************************************************/
+
 #ifndef __MARKOV__
 #define __MARKOV__
 
-#include <fstream>
-#include <iostream> 
-#include <vector>
-#include <algorithm>
-#include <string>
-#include <cmath>
+#include <stdio.h>
+#include <math.h>
 
-using namespace std;
-
-#define ALPHABET_SIZE 4
-#define ALPHABET "ACGT"
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-struct Markov
-{
 /*
-    Stationnary
-    Maximum Likelihood parameters estimation with pseudo count:
-    
-                       C(suffix|prefix) + pseudo
-    P(suffix|prefix) = -------------------------
-                         C(prefix) + N pseudo 
-
-    N: number of suffixes
-    P(suffix|prefix) (example P(C|AA))
-    C(suffix|prefix): prefix-suffix count (example AAC)
-    C(prefix): prefix count (example AA)
+  Model of order m on the residue codes 0 1 2 3 (A C G T, see dna.h):
+
+                                 C(prefix suffix)
+      P(suffix | prefix) = (1 - f) ---------------- + f / 4
+                                    C(prefix)
+
+  prefixes are the m-mers, f the pseudo-frequency (bg_pseudo). The
+  probabilities are stored in flat arrays indexed by the prefix (the
+  first residue in the high bits) and the suffix, with their logarithms,
+  so that evaluating a word is a few lookups and additions:
 
+      log P(w) = logS[w1..wm] + logT[w1..wm, wm+1] + ... + logT[wl-m..wl-1, wl]
+
+  Files (as convert-background-model):
+
+  - oligos      oligo-analysis frequencies of the (m+1)-mers, one per line
+                (word, id, frequency); with a "seq|revcpl" id (2str) the
+                frequency is shared by the word and its reverse complement
+  - inclusive   INCLUSive (MotifSampler) model: #Order, #snf (single
+                nucleotide frequencies), #oligo frequency (prefixes) and
+                #transition matrix
 */
 
+#define MARKOV_OLIGOS       0
+#define MARKOV_INCLUSIVE    1
+
+typedef struct markov_s
+{
     int order;
-    double pseudo;     // pseudo-count (used for smoothing)
-    double **T;        // transition matrix
-    double *S;         // stationary vector
-    int msize;         // transition matrix size (number of rows)
-    double *priori;    // priori vector (pA, pC, pG, pT)
-    int alphabet_size;
-    
-    double p;
-    int prefix;
-    int suffix;
-    int idx;
-    
-    Markov(int o=-1, double p=1.0)
-    {
-        order = o;
-        alphabet_size = ALPHABET_SIZE;
-        T = NULL;
-        S = NULL;
-        priori = NULL;
-        if (order >= 0)
-            alloc(o, p);
-    }
-    
-    void alloc(int o, double p=1.0)
-    {
-        pseudo = 1.0;
-        order = o;
-        msize = (int) pow((double) ALPHABET_SIZE, order);
-        priori = new double[ALPHABET_SIZE];
-        S = new double[msize];
-        T = new double*[msize];
-        for (int i = 0; i < msize; i++)
-            T[i] = new double[ALPHABET_SIZE];
-
-        // init values
-        for (int i = 0; i < msize; i++)
-        {
-            S[i] = 1.0;
-            for (int j = 0; j < ALPHABET_SIZE; j++)
-                T[i][j] = 0.0;
-        }
-    }
+    int msize;              // number of prefixes (4^order)
+    double *S;              // P(prefix) [msize]
+    double *T;              // P(suffix | prefix) [msize * 4]
+    double *logS;
+    double *logT;
+    double priori[4];       // single nucleotide frequencies (A C G T)
+    double logpriori[4];
+} markov_t;
 
-    void dealloc()
-    {
-        if (order != -1)
-        {
-            delete []priori;
-             for (int i = 0; i < msize; i++)
-                delete []T[i];
-            delete []T;
-            delete []S;     
-        }
-    }
+// create a new markov model (uniform)
+markov_t *new_markov(int order);
 
-    ~Markov() 
-    {
-        dealloc();
-    }
+// free the markov model
+void free_markov(markov_t *self);
 
-    Markov(const Markov& m)
-    {
-        order = m.order;
-        pseudo = m.pseudo;
-        msize = m.msize;
-        alloc(order, pseudo);
-
-        //copy values
-        for (int i = 0; i < msize; i++)
-        {
-            S[i] = m.S[i];
-            for (int j = 0; j < ALPHABET_SIZE; j++)
-                T[i][j] = m.T[i][j];
-        }
-        for (int j = 0; j < ALPHABET_SIZE; j++)
-            priori[j] = m.priori[j];
-    }
+// create a new markov uniform model
+markov_t *new_markov_uniform();
 
-    Markov& operator=(Markov &m)
-    {
-        dealloc();
-        order = m.order;
-        pseudo = m.pseudo;
-        msize = m.msize;
-        alloc(order, pseudo);
-    
-        //copy values
-        for (int i = 0; i < msize; i++)
-        {
-            S[i] = m.S[i];
-            for (int j = 0; j < ALPHABET_SIZE; j++)
-                T[i][j] = m.T[i][j];
-        }
-        for (int j = 0; j < ALPHABET_SIZE; j++)
-            priori[j] = m.priori[j];
-        return m;
-    }
+// create a Bernoulli model from priori probabilities (P(A), P(C), P(G), P(T))
+markov_t *new_markov_bernoulli(const double *priori);
 
-    int word2index(int *word, int len)
-    {
-        idx = 0;
-        int P = 1;
-        for (int i = 0; i < len; i++)
-        {
-            idx += word[len-i-1] * P;
-            P = P * ALPHABET_SIZE;
-        }
-        return idx;
-    }
+// format from its name (oligos, oligo-analysis, inclusive, ms or motifsampler), -1 if it is not supported
+int parse_markov_format(const char *name);
 
-    void count(int *s, int len)
-    {
-        int prefix;
-        int suffix;
+/*
+  load filename (plain or compressed) in format, pseudo is the pseudo-frequency
+  added to oligos frequencies (INCLUSive models already include it);
+  NULL if the file can not be read or is not valid
+*/
+markov_t *read_markov(const char *filename, int format, double pseudo);
 
-        for (int i = 0; i < len; i++)
-        {
-            suffix = s[i+order]; 
-            prefix = word2index(&s[i], order);
+// write the model in format
+void write_markov(FILE *fp, const markov_t *self, int format);
 
-            T[prefix][suffix] += 1;
-            S[prefix] += 1;
-        }
-    }
+// return the probability of seq[pos..pos+length-1] in self (0 if it contains N)
+double markov_P(markov_t *self, char *seq, int pos, int length);
 
-    double logP(int *word, int len)
-    {
-        if (order == 0)
-        {
-            p = 0.0;
-            for (int i = 0; i < len; i++)
-                p += log(priori[word[i]]);
-        }
-        else
-        {
-            prefix = word2index(word, order);
-            p = log(S[prefix]);
-            for (int i = order; i < len; i++)
-            {
-                suffix = word[i]; 
-                prefix = word2index(&word[i-order], order);
-                p += log(T[prefix][suffix]);
-            }
-        }
-        return p;
-    }
+// probability of the word of len <= order codes (sum of the prefixes it begins)
+double markov_prefix_P(const markov_t *self, const char *word, int len);
 
-    double P(int *word, int len)
+// log probability of the word of len codes (without N) with the single nucleotide frequencies
+static inline
+double markov_bernoulli_logP(const markov_t *self, const char *word, int len)
+{
+    double p = 0.0;
+    int i;
+    for (i = 0; i < len; i++)
+        p += self->logpriori[(int) word[i]];
+    return p;
+}
+
+// log probability of the word of len codes (without N)
+static inline
+double markov_logP(const markov_t *self, const char *word, int len)
+{
+    int i;
+    if (self->order == 0)
+        return markov_bernoulli_logP(self, word, len);
+    if (len <= self->order)
+        return log(markov_prefix_P(self, word, len));
+
+    int mask = self->msize - 1;
+    int prefix = 0;
+    for (i = 0; i < self->order; i++)
+        prefix = prefix * 4 + word[i];
+    double p = self->logS[prefix];
+    for (i = self->order; i < len; i++)
     {
-        if (order == 0)
-        {
-            p = 1.0;
-            for (int i = 0; i < len; i++)
-                p *= priori[word[i]];
-        }
-        else
-        {
-            prefix = word2index(word, order);
-            p = S[prefix];
-            for (int i = order; i < len; i++)
-            {
-                suffix = word[i]; 
-                prefix = word2index(&word[i-order], order);
-                p *= T[prefix][suffix];
-            }
-        }
-        return p;
+        p += self->logT[4 * prefix + word[i]];
+        prefix = (prefix * 4 + word[i]) & mask;
     }
+    return p;
+}
+
+/*
+  Rolling evaluation of n codes: the prefix index is shifted by one residue
+  per position, so that the whole sequence costs one lookup per position
+  whatever the order.
+
+  logS[i]   log P(codes[i..i+order-1]) (the prefix starting at i)
+  logT[i]   log P(codes[i] | codes[i-order..i-1])
+
+  both are 0 where a residue is N or missing; the log probability of a word
+  of length len > order starting at i is markov_track_logP.
+*/
+void markov_track(const markov_t *self, const char *codes, long n, double *logS, double *logT);
+
+static inline
+double markov_track_logP(const markov_t *self, const double *logS, const double *logT, long i, int len)
+{
+    double p = logS[i];
+    int j;
+    for (j = self->order; j < len; j++)
+        p += logT[i + j];
+    return p;
+}
+
+/*
+  Local (adaptive) model trained on a window of width residues centered
+  on the scanned word, as matrix-scan -window. The (order+1)-mer counts
+  of the window are updated when it slides by one position and only the
+  affected log transitions are recomputed, so that scoring a word costs
+  the same as with a global model.
 
-};
+  Pseudo-frequency f (matrix-scan uses sqrt(width) / (sqrt(width) + width)):
 
-// load the model from file in MotifSampler format
-// http://homes.esat.kuleuven.be/~thijs/help/help_motifsampler.html
-int load_inclusive(Markov &m, string filename);
+  P(suffix|prefix) = (1 - f) C(prefix suffix) / C(prefix) + f / 4
+  P(prefix)        = (1 - f) C(prefix) / C + f / 4^order
 
-// construct a Bernoulli model from priori probs (P(A), P(C), P(G), P(T))
-int bernoulli(Markov &m, double *priori);
+  Words containing invalid residues (N) are not counted.
+*/
+typedef struct
+{
+    int order;
+    int width;
+    double pseudo;          // pseudo-frequency
+    int msize;              // number of prefixes
+    int *C;                 // (order+1)-mer counts [msize * 4]
+    int *CP;                // prefix counts
+    int total;              // counted words
+    double *logT;           // log transitions [msize * 4]
+    double *logS;           // log prefix probabilities
+    int start;              // current window [start, start + width)
+    const char *data;       // sequence of the current window
+    int size;
+} markov_window_t;
+
+markov_window_t *new_markov_window(int order, int width, double pseudo);
+
+void free_markov_window(markov_window_t *self);
+
+// window centered on the word [i, i + l) of the sequence
+void markov_window_move(markov_window_t *self, const char *seq, int len, int i, int l);
+
+// log probability of the word of len codes in the current window
+double markov_window_logP(const markov_window_t *self, const char *word, int len);
+
+// oligo2index
+int oligo2index(char *seq, int pos, int l);
+
+// oligo2index reverse complement
+int oligo2index_rc(char *seq, int pos, int l);
+
+// index to oligo
+void index2oligo(int index, int l, char *buffer);
+
+// convert back index to oligo
+void index2oligo_char(int index, int l, char *buffer);
+
+// convert back index to oligo reverse complement
+void index2oligo_rc_char(int index, int l, char *buffer);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -18,6 +18,7 @@ using namespace std;
 #include "fasta.h"
 #include "utils.h"
 #include "markov.h"
+#include "matrixio.h"
 
 struct Array 
 {
@@ -115,7 +116,7 @@ struct Array
         return buf.str();
     }
 
-    void transform2logfreq(Markov &markov)
+    void transform2logfreq(markov_t &markov)
     {
         for (int j = 0; j < J; j++)
         {
@@ -147,6 +148,6 @@ struct Array
 
 };
 
-Array read_matrix(FILE *fp);
+Array read_matrix(matrix_db_t *db, int k);
 
 #endif
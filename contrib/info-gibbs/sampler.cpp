@@ -36,7 +36,7 @@ struct LLR
     double **logp;
 
     LLR(SITES &motif, int r, Array &matrix, int length, 
-        Markov &markov_model, Sequences &seqs, double **logprob, double pseudo = PSEUDO)
+        markov_t &markov_model, Sequences &seqs, double **logprob, double pseudo = PSEUDO)
     {
         l         = length;
         n         = motif.size();
@@ -140,7 +140,7 @@ void count_matrix(Array &matrix, SITES &motif, Sequences &sequences)
  *  m_{b,i} = ( f_{b,i} + p_i ) / (N + 1)
  */
 inline void freq_matrix(Array &matrix, SITES &motif, Sequences &sequences, \
-                        Markov &markov, double pseudo=PSEUDO, int r=-1)
+                        markov_t &markov, double pseudo=PSEUDO, int r=-1)
 {
     int i,j,k;
     int n = (int) motif.size();
@@ -176,7 +176,7 @@ inline void freq_matrix(Array &matrix, SITES &motif, Sequences &sequences, \
     p      -- priori probability [0.25, 0.25, 0.25, 0.25]
 */
 double IC_Bernoulli(SITES &motif, Sequences &sequences, Array &matrix, \
-                    Markov &markov, double pseudo=PSEUDO)
+                    markov_t &markov, double pseudo=PSEUDO)
 {
     // matrix
     freq_matrix(matrix, motif, sequences, markov, pseudo);
@@ -196,7 +196,7 @@ double IC_Bernoulli(SITES &motif, Sequences &sequences, Array &matrix, \
 
 // do not allow spaces
 double PQ_Bernoulli(SITES &motif, Sequences &sequences, Array &matrix, \
-                    Markov &markov, double pseudo=PSEUDO, int r = 0)
+                    markov_t &markov, double pseudo=PSEUDO, int r = 0)
 {
     // matrix
     freq_matrix(matrix, motif, sequences, markov, pseudo, r);
@@ -236,7 +236,7 @@ double P_M(Array &matrix, int w, int l, int start)
     IC = A - (X + Y)
 */
 double IC_Markov(SITES &motif, Sequences &sequences, Array &matrix, \
-                 Markov &markov, double pseudo = PSEUDO)
+                 markov_t &markov, double pseudo = PSEUDO)
 {
     // special Bernoulli case
     if (markov.order == 0)
@@ -263,7 +263,7 @@ double IC_Markov(SITES &motif, Sequences &sequences, Array &matrix, \
     int nwp = (int) pow((double) J, (double) order); // 4^order (size of S, stationnay vector)
     for (int wp = 0; wp < nwp; wp++) 
     {
-        X += P_M(matrix, wp, order, 0) * log(markov.S[wp]);
+        X += P_M(matrix, wp, order, 0) * markov.logS[wp];
     }
 
     //Y = sum[i in (0..l-1-order)] sum[ws in ALPHABET]
@@ -275,7 +275,7 @@ double IC_Markov(SITES &motif, Sequences &sequences, Array &matrix, \
         {
             for (int ws = 0; ws < ALPHABET_SIZE; ws++) 
             {
-                Y += P_M(matrix, wp * ALPHABET_SIZE + ws, order + 1, i) * log(markov.T[wp][ws]);
+                Y += P_M(matrix, wp * ALPHABET_SIZE + ws, order + 1, i) * markov.logT[wp * ALPHABET_SIZE + ws];
             }
         }
     }
@@ -289,7 +289,7 @@ double IC_Markov(SITES &motif, Sequences &sequences, Array &matrix, \
              P(w|Bg)
 */
 double llr_Bernoulli(SITES &motif, Sequences &sequences, Array &matrix, \
-                     Markov &markov, double pseudo = PSEUDO)
+                     markov_t &markov, double pseudo = PSEUDO)
 {
     // matrix
     freq_matrix(matrix, motif, sequences, markov, pseudo);
@@ -308,7 +308,7 @@ double llr_Bernoulli(SITES &motif, Sequences &sequences, Array &matrix, \
     return s;
 }
 
-double llr(SITES &motif, Sequences &sequences, Array &matrix, Markov &markov, double pseudo=PSEUDO)
+double llr(SITES &motif, Sequences &sequences, Array &matrix, markov_t &markov, double pseudo=PSEUDO)
 {
     // matrix
     freq_matrix(matrix, motif, sequences, markov, pseudo);
@@ -324,7 +324,7 @@ double llr(SITES &motif, Sequences &sequences, Array &matrix, Markov &markov, do
             j = (int) sequences[motif[k].s][motif[k].p+i];
             logP_m += log(matrix[i][j]);
         }
-        s += logP_m - markov.logP(&sequences[motif[k].s][motif[k].p], matrix.I);
+        s += logP_m - bg_word_logP(markov, &sequences[motif[k].s][motif[k].p], matrix.I);
     }
     return s;
 }
@@ -579,7 +579,7 @@ struct SamplingData
     double *cdf;         // cumulative dist function 
     Site *sampled_sites; // sites (corresponds to cdf)
 
-    SamplingData(Sequences &sequences, SITES &sites, Markov &markov, int l)
+    SamplingData(Sequences &sequences, SITES &sites, markov_t &markov, int l)
     {
         S = (int) sequences.size();
         nsites = (int) sites.size();
@@ -592,13 +592,7 @@ struct SamplingData
         {
             int len = sequences[s].size();
             logp[s] = new double[len];
-        }
-
-        for (int i = 0; i < nsites; i++)
-        {
-            int s = sites[i].s;
-            int p = sites[i].p; 
-            logp[s][p] = markov.logP(&sequences[s][p], l);
+            bg_seq_logP(markov, sequences[s], l, logp[s]);
         }
     }
 };
@@ -627,7 +621,7 @@ SITES shifted(SITES &motif, SITES &sites, int delta, Is_a_site &cache)
     return shifted_motif;
 }
 
-SITES shift(SITES &motif, Sequences &sequences, SITES &sites, Array &matrix, Markov &markov, Is_a_site &cache)
+SITES shift(SITES &motif, Sequences &sequences, SITES &sites, Array &matrix, markov_t &markov, Is_a_site &cache)
 {
     SITES best_motif;
     SITES current_motif;
@@ -653,7 +647,7 @@ SITES shift(SITES &motif, Sequences &sequences, SITES &sites, Array &matrix, Mar
  *                                                                         *
  ***************************************************************************/
 int UPDATE = 0;
-void sample_update(SITES &allsites, Sequences &sequences, SITES &motif, Array &matrix, Markov &markov,\
+void sample_update(SITES &allsites, Sequences &sequences, SITES &motif, Array &matrix, markov_t &markov,\
                     int l, double temperature, SamplingData &data, int nseq, int dmin=0, int score_type=LLR_SCORE)
 {
     int n = motif.size();
@@ -758,7 +752,7 @@ struct Result
     int l;
 };
 
-Result find_one_motif(vector<string> &raw_sequences, Sequences & sequences, SITES &sites, Markov &markov, Parameters &params)
+Result find_one_motif(vector<string> &raw_sequences, Sequences & sequences, SITES &sites, markov_t &markov, Parameters &params)
 {
     int l = params.m1 + params.m2;
     int n = params.n;
@@ -777,7 +771,7 @@ Result find_one_motif(vector<string> &raw_sequences, Sequences & sequences, SITE
     double avg_llr         = 0.0;
     double avg_ic          = 0.0;
 
-    Array matrix = Array(l, markov.alphabet_size);
+    Array matrix = Array(l, ALPHABET_SIZE);
     SITES motif;
     SITES best_motif;
     SITES best_motif_in_run;
@@ -876,7 +870,7 @@ Result find_one_motif(vector<string> &raw_sequences, Sequences & sequences, SITE
  *                                                                         *
  ***************************************************************************/
 // log P(site|M) - log P(site|Bg)
-double Score(Site &site, SITES &motif, Sequences &sequences, Array &matrix, Markov &markov, double pseudo=PSEUDO)
+double Score(Site &site, SITES &motif, Sequences &sequences, Array &matrix, markov_t &markov, double pseudo=PSEUDO)
 {
     // matrix
     freq_matrix(matrix, motif, sequences, markov, pseudo);
@@ -889,13 +883,13 @@ double Score(Site &site, SITES &motif, Sequences &sequences, Array &matrix, Mark
         j = (int) sequences[site.s][site.p+i];
         logP_m += log(matrix[i][j]);
     }
-    s += logP_m - markov.logP(&sequences[site.s][site.p], matrix.I);
+    s += logP_m - bg_word_logP(markov, &sequences[site.s][site.p], matrix.I);
     return s;
 }
 
-Result collect_sites(Result result, SITES &sites, Sequences &sequences, Markov &markov, Parameters &params)
+Result collect_sites(Result result, SITES &sites, Sequences &sequences, markov_t &markov, Parameters &params)
 {
-    Array matrix = Array(params.m1 + params.m2, markov.alphabet_size);
+    Array matrix = Array(params.m1 + params.m2, ALPHABET_SIZE);
     count_matrix(matrix, result.motif, sequences);
     matrix.transform2logfreq(markov);
     params.minspacing   = 0;
@@ -916,7 +910,7 @@ Result collect_sites(Result result, SITES &sites, Sequences &sequences, Markov &
  *  MAIN GIBBS
  *                                                                         *
  ***************************************************************************/
-void run_sampler(vector<string> &raw_sequences, Sequences &sequences, Markov &markov, Parameters &params)
+void run_sampler(vector<string> &raw_sequences, Sequences &sequences, markov_t &markov, Parameters &params)
 {
     
     //clock_t start_clock = clock();
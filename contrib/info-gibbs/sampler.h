@@ -95,6 +95,6 @@ struct Parameters
 };
 
 // run the sampler & print the results on stdout
-void run_sampler(vector<string> &raw_sequences, Sequences &sequences, Markov &markov, Parameters &params);
+void run_sampler(vector<string> &raw_sequences, Sequences &sequences, markov_t &markov, Parameters &params);
 
 #endif
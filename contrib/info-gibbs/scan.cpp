@@ -81,22 +81,64 @@ int word_is_valid(int *seq, int start, int l)
     return 1;
 }
 
-SITES matrix_scan(Sequences &sequences, Array &matrix, Markov &bg, Parameters &params)
+double bg_word_logP(markov_t &bg, int *word, int l)
+{
+    char codes[256];
+    ASSERT(l < 256, "invalid word size");
+    for (int i = 0; i < l; i++)
+        codes[i] = (char) word[i];
+    return markov_logP(&bg, codes, l);
+}
+
+void bg_seq_logP(markov_t &bg, Sequence &seq, int l, double *logp)
+{
+    int len = seq.size();
+    char *codes = new char[len];
+    for (int i = 0; i < len; i++)
+        codes[i] = (char) seq[i];
+
+    // rolling tracks: one lookup per position whatever the order
+    double *logS = NULL;
+    double *logT = NULL;
+    if (bg.order > 0 && l > bg.order)
+    {
+        logS = new double[len];
+        logT = new double[len];
+        markov_track(&bg, codes, len, logS, logT);
+    }
+    for (int i = 0; i + l <= len; i++)
+    {
+        if (!word_is_valid(seq.data, i, l))
+            logp[i] = 0.0;
+        else if (logS != NULL)
+            logp[i] = markov_track_logP(&bg, logS, logT, i, l);
+        else
+            logp[i] = markov_logP(&bg, &codes[i], l);
+    }
+    delete []logS;
+    delete []logT;
+    delete []codes;
+}
+
+SITES matrix_scan(Sequences &sequences, Array &matrix, markov_t &bg, Parameters &params)
 {
     int l = matrix.J;
     SITES sites = empty_sites(params.n, l + params.flanks * 2);
     for (int s = 0; s < sequences.size(); s++)
     {
         int maxpos = sequences[s].size() - (l + params.flanks);        
+        double *logp = new double[sequences[s].size()];
+        bg_seq_logP(bg, sequences[s], l, logp);
         for (int i = params.flanks; i <= maxpos; i++)
         {
             if (!word_is_valid(sequences[s].data, i - params.flanks, l + params.flanks * 2))
                 continue;            
             //double W = matrix.sum(&sequences[s].data[i]);
-            double W = matrix.logP(&sequences[s].data[i]) - bg.logP(&sequences[s].data[i], l);
+            double W = matrix.logP(&sequences[s].data[i]) - logp[i];
             try_add_sites(sites, s, i - params.flanks, W);
             //DEBUG("i=%d, w=%f", i, W);
         }
+        delete []logp;
     }
     
     check_sites(sites);
@@ -18,6 +18,12 @@ using namespace std;
 
 #include "sampler.h"
 
-SITES matrix_scan(Sequences &sequences, Array &matrix, Markov &bg, Parameters &params);
+SITES matrix_scan(Sequences &sequences, Array &matrix, markov_t &bg, Parameters &params);
+
+// log P(word | bg) of the word of l residues
+double bg_word_logP(markov_t &bg, int *word, int l);
+
+// log P(word | bg) of all the words of l residues of seq (0 for the words with N)
+void bg_seq_logP(markov_t &bg, Sequence &seq, int l, double *logp);
 
 #endif
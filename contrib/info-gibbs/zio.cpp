@@ -0,0 +1,532 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "zio.h"
+
+#define ZIO_CHUNK       (1 << 17)
+#define BGZF_HEADER     18
+#define BGZF_MAX_BLOCK  65536
+#define BGZF_BATCH      64
+
+int ZIO_THREADS = 0;
+
+static
+void zio_error(const char *message)
+{
+    fprintf(stderr, "ERROR %s\n", message);
+    exit(1);
+}
+
+/*
+  low level I/O
+*/
+static
+long read_full(int fd, unsigned char *buffer, long size)
+{
+    long n = 0;
+    while (n < size)
+    {
+        ssize_t r = read(fd, buffer + n, size - n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        n += r;
+    }
+    return n;
+}
+
+// 0 if the reader is gone (closed before the end)
+static
+int send_full(int fd, const unsigned char *buffer, long size)
+{
+    while (size > 0)
+    {
+        ssize_t w = send(fd, buffer, size, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return 0;
+        buffer += w;
+        size -= w;
+    }
+    return 1;
+}
+
+static
+int is_gzip(const unsigned char *head, long n)
+{
+    return n >= 3 && head[0] == 0x1f && head[1] == 0x8b && head[2] == 8;
+}
+
+// gzip member with the BC extra field of bgzip
+static
+int is_bgzf(const unsigned char *head, long n)
+{
+    return n >= BGZF_HEADER && is_gzip(head, n) && (head[3] & 4) && head[12] == 'B' && head[13] == 'C';
+}
+
+/*
+  decompression threads
+*/
+typedef struct zstream
+{
+    int in;             // compressed input
+    int out;            // write end of the socket
+    unsigned char head[BGZF_HEADER];
+    long head_size;     // bytes already read to detect the format
+    FILE *fp;           // read end returned by zopen
+    pthread_t thread;
+    struct zstream *next;
+} zstream_t;
+
+static zstream_t *STREAMS = NULL;
+static pthread_mutex_t STREAMS_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+// plain data from a pipe (stdin), only forwarded
+static
+void *copy_thread(void *arg)
+{
+    zstream_t *z = (zstream_t *) arg;
+    unsigned char *buffer = (unsigned char *) malloc(ZIO_CHUNK);
+    long n;
+    if (send_full(z->out, z->head, z->head_size))
+    {
+        while ((n = read_full(z->in, buffer, ZIO_CHUNK)) > 0)
+        {
+            if (!send_full(z->out, buffer, n))
+                break;
+        }
+    }
+    free(buffer);
+    close(z->out);
+    return NULL;
+}
+
+// gzip (possibly several members, as cat a.gz b.gz)
+static
+void *gzip_thread(void *arg)
+{
+    zstream_t *z = (zstream_t *) arg;
+    unsigned char *in = (unsigned char *) malloc(ZIO_CHUNK);
+    unsigned char *out = (unsigned char *) malloc(ZIO_CHUNK);
+    z_stream s;
+    memset(&s, 0, sizeof(s));
+    if (inflateInit2(&s, 15 + 16) != Z_OK)
+        zio_error("can not initialize zlib");
+
+    memcpy(in, z->head, z->head_size);
+    s.next_in = in;
+    s.avail_in = z->head_size;
+    int alive = 1;
+    int member_end = 0;     // 1 between two members (no input of the next one yet)
+    while (alive)
+    {
+        if (s.avail_in == 0)
+        {
+            long n = read_full(z->in, in, ZIO_CHUNK);
+            if (n == 0)
+            {
+                if (!member_end)
+                    zio_error("truncated gzip data");
+                break;
+            }
+            s.next_in = in;
+            s.avail_in = n;
+        }
+        s.next_out = out;
+        s.avail_out = ZIO_CHUNK;
+        unsigned int avail_in = s.avail_in;
+        int ret = inflate(&s, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+            zio_error("invalid gzip data");
+        alive = send_full(z->out, out, ZIO_CHUNK - s.avail_out);
+        if (ret == Z_STREAM_END)
+        {
+            inflateReset(&s);
+            member_end = 1;
+        }
+        else if (s.avail_in < avail_in)
+            member_end = 0;
+    }
+    inflateEnd(&s);
+    free(in);
+    free(out);
+    close(z->out);
+    return NULL;
+}
+
+typedef struct
+{
+    unsigned char *in[BGZF_BATCH];
+    long in_size[BGZF_BATCH];
+    unsigned char *out[BGZF_BATCH];
+    long out_size[BGZF_BATCH];
+    int nblocks;
+    int nthreads;
+} bgzf_batch_t;
+
+typedef struct
+{
+    bgzf_batch_t *batch;
+    int first;
+} bgzf_worker_t;
+
+// inflate a whole BGZF block, returns the uncompressed size
+static
+long inflate_block(z_stream *s, unsigned char *block, long size, unsigned char *out)
+{
+    int xlen = block[10] | (block[11] << 8);
+    long data = 12 + xlen;
+    long isize = block[size - 4] | (block[size - 3] << 8) | (block[size - 2] << 16) | ((long) block[size - 1] << 24);
+    if (data + 8 > size || isize > BGZF_MAX_BLOCK)
+        zio_error("invalid BGZF block");
+    inflateReset(s);
+    s->next_in = block + data;
+    s->avail_in = size - data - 8;
+    s->next_out = out;
+    s->avail_out = BGZF_MAX_BLOCK;
+    if (inflate(s, Z_FINISH) != Z_STREAM_END || (long) (BGZF_MAX_BLOCK - s->avail_out) != isize)
+        zio_error("invalid BGZF block");
+    return isize;
+}
+
+static
+void *bgzf_worker(void *arg)
+{
+    bgzf_worker_t *w = (bgzf_worker_t *) arg;
+    bgzf_batch_t *b = w->batch;
+    z_stream s;
+    memset(&s, 0, sizeof(s));
+    if (inflateInit2(&s, -15) != Z_OK)
+        zio_error("can not initialize zlib");
+    int i;
+    for (i = w->first; i < b->nblocks; i += b->nthreads)
+        b->out_size[i] = inflate_block(&s, b->in[i], b->in_size[i], b->out[i]);
+    inflateEnd(&s);
+    return NULL;
+}
+
+// read the next block (its header may already be in head), returns its size or 0 at the end
+static
+long read_block(int fd, unsigned char *block, unsigned char *head, long *head_size)
+{
+    long n = *head_size;
+    if (n > 0)
+        memcpy(block, head, n);
+    *head_size = 0;
+    n += read_full(fd, block + n, BGZF_HEADER - n);
+    if (n == 0)
+        return 0;
+    if (!is_bgzf(block, n))
+        zio_error("invalid BGZF block header");
+    long size = (block[16] | (block[17] << 8)) + 1;
+    if (read_full(fd, block + BGZF_HEADER, size - BGZF_HEADER) != size - BGZF_HEADER)
+        zio_error("truncated BGZF file");
+    return size;
+}
+
+static
+int zio_nthreads()
+{
+    if (ZIO_THREADS > 0)
+        return ZIO_THREADS;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (n > BGZF_BATCH ? BGZF_BATCH : (int) n);
+}
+
+// BGZF: batches of blocks read sequentially, inflated in parallel, written in order
+static
+void *bgzf_thread(void *arg)
+{
+    zstream_t *z = (zstream_t *) arg;
+    bgzf_batch_t b;
+    bgzf_worker_t workers[BGZF_BATCH];
+    pthread_t threads[BGZF_BATCH];
+    int i;
+    for (i = 0; i < BGZF_BATCH; i++)
+    {
+        b.in[i] = (unsigned char *) malloc(BGZF_MAX_BLOCK);
+        b.out[i] = (unsigned char *) malloc(BGZF_MAX_BLOCK);
+    }
+    b.nthreads = zio_nthreads();
+
+    int alive = 1;
+    while (alive)
+    {
+        b.nblocks = 0;
+        while (b.nblocks < BGZF_BATCH)
+        {
+            long size = read_block(z->in, b.in[b.nblocks], z->head, &z->head_size);
+            if (size == 0)
+                break;
+            b.in_size[b.nblocks++] = size;
+        }
+        if (b.nblocks == 0)
+            break;
+
+        int nthreads = b.nthreads < b.nblocks ? b.nthreads : b.nblocks;
+        for (i = 0; i < nthreads; i++)
+        {
+            workers[i].batch = &b;
+            workers[i].first = i;
+            if (i > 0 && pthread_create(&threads[i], NULL, bgzf_worker, &workers[i]) != 0)
+                zio_error("can not create thread");
+        }
+        // the first share is inflated by this thread
+        b.nthreads = nthreads;
+        bgzf_worker(&workers[0]);
+        for (i = 1; i < nthreads; i++)
+            pthread_join(threads[i], NULL);
+        b.nthreads = zio_nthreads();
+
+        for (i = 0; i < b.nblocks && alive; i++)
+            alive = send_full(z->out, b.out[i], b.out_size[i]);
+    }
+    for (i = 0; i < BGZF_BATCH; i++)
+    {
+        free(b.in[i]);
+        free(b.out[i]);
+    }
+    close(z->out);
+    return NULL;
+}
+
+FILE *zopen(const char *filename)
+{
+    int fd = 0;
+    if (filename != NULL && strcmp(filename, "-") != 0)
+    {
+        fd = open(filename, O_RDONLY);
+        if (fd < 0)
+            return NULL;
+    }
+
+    zstream_t *z = (zstream_t *) malloc(sizeof(zstream_t));
+    z->in = fd;
+    z->head_size = read_full(fd, z->head, BGZF_HEADER);
+
+    // plain file: rewind and read it directly
+    struct stat st;
+    if (!is_gzip(z->head, z->head_size) && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+        && lseek(fd, -z->head_size, SEEK_CUR) >= 0)
+    {
+        free(z);
+        return fdopen(fd, "r");
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        zio_error("can not create socket");
+    z->out = sv[1];
+    z->fp = fdopen(sv[0], "r");
+    void *(*run)(void *) = copy_thread;
+    if (is_bgzf(z->head, z->head_size))
+        run = bgzf_thread;
+    else if (is_gzip(z->head, z->head_size))
+        run = gzip_thread;
+    if (pthread_create(&z->thread, NULL, run, z) != 0)
+        zio_error("can not create thread");
+
+    pthread_mutex_lock(&STREAMS_LOCK);
+    z->next = STREAMS;
+    STREAMS = z;
+    pthread_mutex_unlock(&STREAMS_LOCK);
+    return z->fp;
+}
+
+void zclose(FILE *fp)
+{
+    pthread_mutex_lock(&STREAMS_LOCK);
+    zstream_t **p = &STREAMS;
+    while (*p != NULL && (*p)->fp != fp)
+        p = &(*p)->next;
+    zstream_t *z = *p;
+    if (z != NULL)
+        *p = z->next;
+    pthread_mutex_unlock(&STREAMS_LOCK);
+
+    // closing the read end stops the thread at its next write
+    fclose(fp);
+    if (z != NULL)
+    {
+        pthread_join(z->thread, NULL);
+        if (z->in != 0)
+            close(z->in);
+        free(z);
+    }
+}
+
+/*
+  random access
+*/
+struct bgzf_reader
+{
+    FILE *fp;
+    int nblocks;
+    uint64_t *coffset;  // compressed and uncompressed offsets of the blocks
+    uint64_t *uoffset;
+    int cached;         // block in cache (-1 if none)
+    long cached_size;
+    unsigned char *block;
+    unsigned char *data;
+    z_stream s;
+};
+
+static
+void add_block(bgzf_reader_t *r, int *capacity, uint64_t c, uint64_t u)
+{
+    if (r->nblocks == *capacity)
+    {
+        *capacity *= 2;
+        r->coffset = (uint64_t *) realloc(r->coffset, sizeof(uint64_t) * *capacity);
+        r->uoffset = (uint64_t *) realloc(r->uoffset, sizeof(uint64_t) * *capacity);
+    }
+    r->coffset[r->nblocks] = c;
+    r->uoffset[r->nblocks] = u;
+    r->nblocks++;
+}
+
+// .gzi: number of entries then (compressed, uncompressed) offsets, little endian, first block implicit
+static
+int read_gzi(bgzf_reader_t *r, const char *filename, int *capacity)
+{
+    char *gzi = (char *) malloc(strlen(filename) + 5);
+    sprintf(gzi, "%s.gzi", filename);
+    FILE *fp = fopen(gzi, "rb");
+    free(gzi);
+    if (fp == NULL)
+        return 0;
+    uint64_t n, i, offsets[2];
+    if (fread(&n, sizeof(n), 1, fp) != 1)
+    {
+        fclose(fp);
+        return 0;
+    }
+    add_block(r, capacity, 0, 0);
+    for (i = 0; i < n; i++)
+    {
+        if (fread(offsets, sizeof(uint64_t), 2, fp) != 2)
+            zio_error("truncated .gzi index");
+        add_block(r, capacity, offsets[0], offsets[1]);
+    }
+    fclose(fp);
+    return 1;
+}
+
+// without index, walk through the block headers
+static
+void scan_blocks(bgzf_reader_t *r, int *capacity)
+{
+    uint64_t c = 0, u = 0;
+    unsigned char head[BGZF_HEADER];
+    unsigned char tail[4];
+    while (fseek(r->fp, c, SEEK_SET) == 0 && fread(head, 1, BGZF_HEADER, r->fp) == BGZF_HEADER)
+    {
+        if (!is_bgzf(head, BGZF_HEADER))
+            zio_error("invalid BGZF block header");
+        long size = (head[16] | (head[17] << 8)) + 1;
+        if (fseek(r->fp, c + size - 4, SEEK_SET) != 0 || fread(tail, 1, 4, r->fp) != 4)
+            zio_error("truncated BGZF file");
+        add_block(r, capacity, c, u);
+        c += size;
+        u += tail[0] | (tail[1] << 8) | (tail[2] << 16) | ((uint64_t) tail[3] << 24);
+    }
+}
+
+bgzf_reader_t *bgzf_open(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+        return NULL;
+    unsigned char head[BGZF_HEADER];
+    if (fread(head, 1, BGZF_HEADER, fp) != BGZF_HEADER || !is_bgzf(head, BGZF_HEADER))
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    bgzf_reader_t *r = (bgzf_reader_t *) malloc(sizeof(bgzf_reader_t));
+    int capacity = 1024;
+    r->fp = fp;
+    r->nblocks = 0;
+    r->coffset = (uint64_t *) malloc(sizeof(uint64_t) * capacity);
+    r->uoffset = (uint64_t *) malloc(sizeof(uint64_t) * capacity);
+    if (!read_gzi(r, filename, &capacity))
+        scan_blocks(r, &capacity);
+    r->cached = -1;
+    r->cached_size = 0;
+    r->block = (unsigned char *) malloc(BGZF_MAX_BLOCK);
+    r->data = (unsigned char *) malloc(BGZF_MAX_BLOCK);
+    memset(&r->s, 0, sizeof(r->s));
+    if (inflateInit2(&r->s, -15) != Z_OK)
+        zio_error("can not initialize zlib");
+    return r;
+}
+
+void bgzf_close(bgzf_reader_t *r)
+{
+    inflateEnd(&r->s);
+    fclose(r->fp);
+    free(r->coffset);
+    free(r->uoffset);
+    free(r->block);
+    free(r->data);
+    free(r);
+}
+
+// load block k in the cache
+static
+void load_block(bgzf_reader_t *r, int k)
+{
+    if (r->cached == k)
+        return;
+    if (fseek(r->fp, r->coffset[k], SEEK_SET) != 0 || fread(r->block, 1, BGZF_HEADER, r->fp) != BGZF_HEADER
+        || !is_bgzf(r->block, BGZF_HEADER))
+        zio_error("invalid BGZF block");
+    long size = (r->block[16] | (r->block[17] << 8)) + 1;
+    if ((long) fread(r->block + BGZF_HEADER, 1, size - BGZF_HEADER, r->fp) != size - BGZF_HEADER)
+        zio_error("truncated BGZF file");
+    r->cached_size = inflate_block(&r->s, r->block, size, r->data);
+    r->cached = k;
+}
+
+long bgzf_read_at(bgzf_reader_t *r, long offset, char *buffer, long size)
+{
+    // last block starting at or before offset
+    int a = 0, b = r->nblocks - 1;
+    if (b < 0)
+        return 0;
+    while (a < b)
+    {
+        int m = (a + b + 1) / 2;
+        if (r->uoffset[m] <= (uint64_t) offset)
+            a = m;
+        else
+            b = m - 1;
+    }
+
+    long n = 0;
+    int k;
+    for (k = a; k < r->nblocks && n < size; k++)
+    {
+        load_block(r, k);
+        long from = offset + n - (long) r->uoffset[k];
+        if (from >= r->cached_size)
+            continue;
+        long len = r->cached_size - from;
+        if (len > size - n)
+            len = size - n;
+        memcpy(buffer + n, r->data + from, len);
+        n += len;
+    }
+    return n;
+}
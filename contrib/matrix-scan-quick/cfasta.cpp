@@ -1,6 +1,15 @@
+#include <limits.h>
+
 #include "cfasta.h"
 
-#define FASTA_READER_BUFSIZE 4096
+#define FASTA_READER_BUFSIZE 65536
+
+static
+int fill_from_file(fasta_reader_t *reader)
+{
+    reader->size = fread(reader->buffer, 1, reader->bufsize, reader->fp);
+    return reader->size > 0;
+}
 
 fasta_reader_t *new_fasta_reader(FILE *fp)
 {
@@ -8,67 +17,122 @@ fasta_reader_t *new_fasta_reader(FILE *fp)
     fasta_reader_t *fasta_reader = (fasta_reader_t *) malloc(sizeof(fasta_reader_t));
     fasta_reader->bufsize = FASTA_READER_BUFSIZE;
     fasta_reader->pos = 0;
+    fasta_reader->size = 0;
     fasta_reader->buffer = (char *) malloc(sizeof(char) * fasta_reader->bufsize);
     fasta_reader->fp = fp;
+    fasta_reader->in_record = 0;
+    fasta_reader->fill = fill_from_file;
+    fasta_reader->source = NULL;
     return fasta_reader;
 }
 
 void free_fasta_reader(fasta_reader_t *fasta_reader)
 {
-    free(fasta_reader->buffer);
+    if (fasta_reader->fill == fill_from_file)
+        free(fasta_reader->buffer);
     free(fasta_reader);
 }
 
+// 0 at the end of the input
 static inline
-char fasta_reader_getc(fasta_reader_t *reader)
+int fasta_reader_ready(fasta_reader_t *reader)
 {
-    return fgetc(reader->fp);
-    // if (reader->pos >= reader->bufsize) 
-    // {
-    //     int read_size = fread(reader->buffer, 1, reader->bufsize, reader->fp);
-    //     if (read_size != reader->bufsize)
-    //         reader->buffer[read_size] = EOF;
-    // 
-    //     reader->pos = 0;
-    // }
-    // 
-    // char c = reader->buffer[reader->pos];
-    // if (c != EOF)
-    //     reader->pos++;
-    // return c;
+    if (reader->pos < reader->size)
+        return 1;
+    reader->pos = 0;
+    reader->size = 0;
+    return reader->fill(reader);
 }
 
-seq_t *fasta_reader_next(fasta_reader_t *reader)
+int fasta_reader_begin(fasta_reader_t *reader, char *name)
 {
-    seq_t *seq = new_seq(1000);
+    // rest of the current record
+    if (reader->in_record)
+    {
+        seq_t *rest = new_seq(FASTA_READER_BUFSIZE);
+        while (fasta_reader_read(reader, rest, FASTA_READER_BUFSIZE) == FASTA_READER_BUFSIZE)
+            rest->size = 0;
+        free_seq(rest);
+    }
 
-    // read header
-    char c;
+    // the name is the first word of the header line
     int i = 0;
     int short_name_found = 0;
-    do 
+    while (1)
     {
-        c = fasta_reader_getc(reader);
-        if ((c == '\t' || c == ' ' || c == '\r') && i > 0)
-            short_name_found = 1;
-        if (!short_name_found && i < 1024 && \
-            c!= EOF && c != '\n' && c != '\t' && c != ' ' && c != '\r' && c != '>')
-            seq->name[i++] = c;
-    } while (c != EOF && c != '\n');
-    seq->name[i] = '\0';
-    if (c == EOF)
-        return NULL;
+        if (!fasta_reader_ready(reader))
+        {
+            name[i] = '\0';
+            return 0;
+        }
+        char *start = reader->buffer + reader->pos;
+        char *eol = (char *) memchr(start, '\n', reader->size - reader->pos);
+        char *end = eol != NULL ? eol : reader->buffer + reader->size;
+        char *p;
+        for (p = start; p < end && !short_name_found; p++)
+        {
+            char c = *p;
+            if ((c == '\t' || c == ' ' || c == '\r') && i > 0)
+                short_name_found = 1;
+            else if (i < 1023 && c != '\t' && c != ' ' && c != '\r' && c != '>')
+                name[i++] = c;
+        }
+        if (eol != NULL)
+        {
+            reader->pos = eol - reader->buffer + 1;
+            break;
+        }
+        reader->pos = reader->size;
+    }
+    name[i] = '\0';
+    reader->in_record = 1;
+    return 1;
+}
 
-    // read sequence
-    do 
+int fasta_reader_read(fasta_reader_t *reader, seq_t *seq, int max)
+{
+    int n = 0;
+    while (reader->in_record && n < max)
     {
-        c = fasta_reader_getc(reader);
-        if (c == EOF)
-          break;
-        if (c != '\n' && c != '>') 
-            seq_append_c(seq, c);
+        if (!fasta_reader_ready(reader))
+        {
+            reader->in_record = 0;
+            break;
+        }
+
+        // the record ends at the next '>'
+        char *start = reader->buffer + reader->pos;
+        char *next = (char *) memchr(start, '>', reader->size - reader->pos);
+        char *end = next != NULL ? next : reader->buffer + reader->size;
+        if (end - start > max - n)
+            end = start + (max - n);
 
-    } while (c != '>');
+        if (seq->size + (end - start) > seq->msize)
+        {
+            seq->msize = MAX(2 * seq->msize, seq->size + (int) (end - start));
+            seq->data = (char *) realloc(seq->data, sizeof(char) * seq->msize);
+        }
+        int added = dna_encode(start, end - start, seq->data + seq->size);
+        seq->size += added;
+        n += added;
+        reader->pos = end - reader->buffer;
+        if (end == next)
+        {
+            reader->pos++;
+            reader->in_record = 0;
+        }
+    }
+    return n;
+}
 
+seq_t *fasta_reader_next(fasta_reader_t *reader)
+{
+    seq_t *seq = new_seq(1000);
+    if (!fasta_reader_begin(reader, seq->name))
+    {
+        free_seq(seq);
+        return NULL;
+    }
+    fasta_reader_read(reader, seq, INT_MAX);
     return seq;
 }
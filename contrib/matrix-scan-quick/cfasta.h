@@ -2,7 +2,7 @@
  *                                                                         *
  *  cfasta.h
  *  fast fasta reader
- *   
+ *
  *
  *                                                                         *
  ***************************************************************************/
@@ -12,16 +12,27 @@
 #include "seq.h"
 #include "utils.h"
 
-#ifdef __cplusplus 
+#ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef struct
+/*
+  The input is read by blocks: the records are split with memchr and
+  the residues are encoded by blocks (dna_encode). A record can also be
+  read by pieces (fasta_reader_begin / fasta_reader_read) so that a long
+  record can be processed before it is completely read.
+*/
+typedef struct fasta_reader
 {
-    char *buffer;
+    char *buffer;       // current block
     int bufsize;
     int pos;
+    int size;
     FILE *fp;
+    int in_record;      // 1 while the residues of a record are read
+    // next block of the input in buffer / size, 0 at the end (fread on fp by default)
+    int (*fill)(struct fasta_reader *reader);
+    void *source;       // used by fill
 } fasta_reader_t;
 
 fasta_reader_t *new_fasta_reader(FILE *fp);
@@ -30,6 +41,12 @@ void free_fasta_reader(fasta_reader_t *fasta_reader);
 
 seq_t *fasta_reader_next(fasta_reader_t *reader);
 
+// read the next header into name (1024 chars), 0 at the end of the input
+int fasta_reader_begin(fasta_reader_t *reader, char *name);
+
+// append at most max residues of the current record to seq, less than max at the end of the record
+int fasta_reader_read(fasta_reader_t *reader, seq_t *seq, int max);
+
 #ifdef __cplusplus
 }
 #endif
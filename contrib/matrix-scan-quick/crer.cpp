@@ -0,0 +1,244 @@
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+
+#include "crer.h"
+
+void crer_params_init(crer_params_t *params)
+{
+    params->min_size = 0;
+    params->max_size = INT_MAX;
+    params->min_sites = 2;
+    params->max_sites = INT_MAX;
+    params->min_distance = 1;
+    params->max_distance = INT_MAX;
+    params->max_pval = 1.0;
+    params->min_sig = -DBL_MAX;
+    params->ids = 0;
+}
+
+int crer_params_set(crer_params_t *params, const char *field, double value, int upper)
+{
+    if (strcmp(field, "crer_size") == 0)
+        *(upper ? &params->max_size : &params->min_size) = (int) value;
+    else if (strcmp(field, "crer_sites") == 0)
+        *(upper ? &params->max_sites : &params->min_sites) = (int) value;
+    else if (strcmp(field, "crer_site_distance") == 0)
+        *(upper ? &params->max_distance : &params->min_distance) = (int) value;
+    else if (strcmp(field, "crer_pval") == 0 && upper)
+        params->max_pval = value;
+    else if (strcmp(field, "crer_sig") == 0 && !upper)
+        params->min_sig = value;
+    else
+        return 0;
+    return 1;
+}
+
+/*
+  continued fraction of the incomplete beta function (Numerical Recipes)
+*/
+static
+double betacf(double a, double b, double x)
+{
+    const double EPS = 1e-14;
+    const double FPMIN = 1e-300;
+    double qab = a + b;
+    double qap = a + 1.0;
+    double qam = a - 1.0;
+    double c = 1.0;
+    double d = 1.0 - qab * x / qap;
+    if (fabs(d) < FPMIN)
+        d = FPMIN;
+    d = 1.0 / d;
+    double h = d;
+    int m;
+    for (m = 1; m <= 10000; m++)
+    {
+        int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1.0 + aa * d;
+        if (fabs(d) < FPMIN)
+            d = FPMIN;
+        c = 1.0 + aa / c;
+        if (fabs(c) < FPMIN)
+            c = FPMIN;
+        d = 1.0 / d;
+        h *= d * c;
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1.0 + aa * d;
+        if (fabs(d) < FPMIN)
+            d = FPMIN;
+        c = 1.0 + aa / c;
+        if (fabs(c) < FPMIN)
+            c = FPMIN;
+        d = 1.0 / d;
+        double del = d * c;
+        h *= del;
+        if (fabs(del - 1.0) < EPS)
+            break;
+    }
+    return h;
+}
+
+// regularized incomplete beta function I_x(a, b)
+static
+double betai(double a, double b, double x)
+{
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+    double lbt = lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1.0 - x);
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return exp(lbt) * betacf(a, b, x) / a;
+    else
+        return 1.0 - exp(lbt) * betacf(b, a, 1.0 - x) / b;
+}
+
+// constant time whatever n, unlike the sum of the binomial terms
+double binomial_upper_tail(double p, int n, int k)
+{
+    if (k <= 0)
+        return 1.0;
+    if (k > n)
+        return 0.0;
+    return betai(k, n - k + 1, p);
+}
+
+crer_t *new_crer(crer_params_t *params, double hit_pval, int rc)
+{
+    crer_t *crer = new crer_t;
+    crer->params = *params;
+    crer->p = rc ? 1.0 - (1.0 - hit_pval) * (1.0 - hit_pval) : hit_pval;
+    crer->strand = rc ? "DR" : "D";
+    crer->fout = stdout;
+    crer->seq_name = NULL;
+    crer->count = 0;
+    return crer;
+}
+
+void free_crer(crer_t *crer)
+{
+    delete crer;
+}
+
+void crer_print_header(FILE *fout)
+{
+    fprintf(fout, "#seq_id\tft_type\tft_name\tstrand\tstart\tend\thit_sum\tcrer_sig\tcrer_pval\tpval_prod\tweight_sum\tcrer_size\n");
+}
+
+static
+void print_region(crer_t *crer, crer_region_t *r)
+{
+    fprintf(crer->fout, "%s\tCRER\t", crer->seq_name);
+    crer->count++;
+    if (crer->params.ids)
+        fprintf(crer->fout, "crer_%d", crer->count);
+    else
+        fprintf(crer->fout, "crer");
+    fprintf(crer->fout, "\t%s\t%d\t%d\t%d", crer->strand, r->start, r->end, r->last - r->first + 1);
+    if (r->pval > 0)
+        fprintf(crer->fout, "\t%.3f", fmax(0.0, -log10(r->pval)));
+    else
+        fprintf(crer->fout, "\tInf");
+    fprintf(crer->fout, "\t%.1e\t%.1e\t%G\t%d\n", r->pval, exp(r->logP), r->W, r->end - r->start + 1);
+}
+
+// print the pending regions starting before the first kept site
+static
+void flush_regions(crer_t *crer, int all)
+{
+    while (!crer->pending.empty()
+           && (all || crer->sites.empty() || crer->pending.front().first < crer->sites.front().rank))
+    {
+        print_region(crer, &crer->pending.front());
+        crer->pending.pop_front();
+    }
+}
+
+void crer_begin(crer_t *crer, FILE *fout, const char *seq_name)
+{
+    crer->fout = fout;
+    crer->seq_name = seq_name;
+    crer->rank = 0;
+    crer->logP = 0.0;
+    crer->W = 0.0;
+    crer->sites.clear();
+    crer->pending.clear();
+}
+
+void crer_add(crer_t *crer, int start, int end, double pval, double W)
+{
+    crer_params_t *params = &crer->params;
+    deque<crer_site_t> &sites = crer->sites;
+
+    if (!sites.empty())
+    {
+        int distance = start - sites.back().start;
+        // too close to the previous site: discarded
+        if (distance < params->min_distance)
+            return;
+        // too far: no region can contain both sites
+        if (distance > params->max_distance)
+        {
+            sites.clear();
+            flush_regions(crer, 1);
+        }
+    }
+
+    crer_site_t site;
+    site.start = start;
+    site.end = end;
+    site.rank = crer->rank++;
+    site.logP = crer->logP;
+    site.W = crer->W;
+    sites.push_back(site);
+    crer->logP += log(pval);
+    crer->W += W;
+
+    // sites that can not start a region ending here (or later)
+    while ((double) end - sites.front().start + 1 > params->max_size)
+        sites.pop_front();
+    flush_regions(crer, 0);
+
+    // largest enriched region ending on this site
+    int i;
+    for (i = 0; i < (int) sites.size(); i++)
+    {
+        crer_site_t *first = &sites[i];
+        int k = site.rank - first->rank + 1;
+        if (k > params->max_sites)
+            continue;
+        if (k < params->min_sites || end - first->start + 1 < params->min_size)
+            break;
+
+        // possible site positions, minus the ones masked by the minimal distance
+        int n = start - first->start + 1 - (k - 1) * (params->min_distance - 1);
+        double pval = binomial_upper_tail(crer->p, MAX(n, k), k);
+        if (pval > params->max_pval)
+            continue;
+        if (pval > 0 && -log10(pval) < params->min_sig)
+            continue;
+
+        crer_region_t r;
+        r.first = first->rank;
+        r.last = site.rank;
+        r.start = first->start;
+        r.end = end;
+        r.pval = pval;
+        r.logP = crer->logP - first->logP;
+        r.W = crer->W - first->W;
+
+        // pending regions starting at or after it are contained in it
+        while (!crer->pending.empty() && crer->pending.back().first >= r.first)
+            crer->pending.pop_back();
+        crer->pending.push_back(r);
+        break;
+    }
+}
+
+void crer_end(crer_t *crer)
+{
+    flush_regions(crer, 1);
+    crer->sites.clear();
+}
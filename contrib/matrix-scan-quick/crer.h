@@ -0,0 +1,103 @@
+/***************************************************************************
+ *                                                                         *
+ *  crer.h
+ *  cis-regulatory element enriched regions (CRER)
+ *
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __CRER__
+#define __CRER__
+
+#include <deque>
+
+#include "utils.h"
+
+using namespace std;
+
+/*
+  Streaming CRER detection (-return crer). The hits of a sequence are
+  given by increasing start position; the engine keeps the hits that can
+  still be in a region (a deque, bounded by the maximal region size or
+  site distance) and, for each new hit, looks for the largest enriched
+  region ending on it. A region of n possible site positions containing
+  k sites is enriched if the binomial P-value P(X >= k) with the
+  probability p of a hit at a position passes the thresholds (as in
+  matrix-scan). Only maximal regions, not contained in another enriched
+  region, are printed.
+*/
+
+// thresholds (same names as the matrix-scan -lth/-uth fields)
+typedef struct
+{
+    int min_size;       // crer_size
+    int max_size;
+    int min_sites;      // crer_sites
+    int max_sites;
+    int min_distance;   // crer_site_distance
+    int max_distance;
+    double max_pval;    // crer_pval
+    double min_sig;     // crer_sig
+    int ids;            // number the regions (crer_1, crer_2, ...)
+} crer_params_t;
+
+typedef struct
+{
+    int start;
+    int end;
+    int rank;           // rank of the site in the sequence
+    double logP;        // sum of the log P-values of the sites before
+    double W;           // sum of the weights of the sites before
+} crer_site_t;
+
+typedef struct
+{
+    int first;          // rank of the first and last sites
+    int last;
+    int start;
+    int end;
+    double pval;
+    double logP;        // sums over the sites of the region
+    double W;
+} crer_region_t;
+
+typedef struct
+{
+    crer_params_t params;
+    double p;           // probability of a hit at a position (any strand)
+    const char *strand;
+    FILE *fout;
+    const char *seq_name;
+    int rank;
+    int count;          // printed regions
+    double logP;        // sums over the sites of the sequence
+    double W;
+    deque<crer_site_t> sites;
+    deque<crer_region_t> pending;
+} crer_t;
+
+// default thresholds
+void crer_params_init(crer_params_t *params);
+
+// set the threshold of field ("crer_size", ...), upper if upper, returns 0 for unknown fields
+int crer_params_set(crer_params_t *params, const char *field, double value, int upper);
+
+// hit_pval is the P-value threshold of the sites, rc if both strands are scanned
+crer_t *new_crer(crer_params_t *params, double hit_pval, int rc);
+
+void free_crer(crer_t *crer);
+
+void crer_print_header(FILE *fout);
+
+void crer_begin(crer_t *crer, FILE *fout, const char *seq_name);
+
+// site at [start, end] (increasing starts), with its P-value and weight
+void crer_add(crer_t *crer, int start, int end, double pval, double W);
+
+// print the regions left at the end of the sequence
+void crer_end(crer_t *crer);
+
+// P(X >= k) for X ~ binomial(n, p)
+double binomial_upper_tail(double p, int n, int k);
+
+#endif
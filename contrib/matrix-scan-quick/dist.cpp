@@ -1,3 +1,5 @@
+#include <math.h>
+
 #include "dist.h"
 
 values_t *new_values(double min, double max, double e)
@@ -30,6 +32,12 @@ void values_add(values_t *values, double value)
 }
 
 void values_print(FILE *fout, values_t *values)
+{
+    fprintf(fout, "#score\tocc\tco\tcco\tdCDF\n");
+    values_print_label(fout, values, NULL);
+}
+
+void values_print_label(FILE *fout, values_t *values, const char *label)
 {
     int i;
 
@@ -52,12 +60,160 @@ void values_print(FILE *fout, values_t *values)
         total += values->data[i];
     
     // print
-    fprintf(fout, "#score\tocc\tco\tcco\tdCDF\n");
     int cum = 0;
     for (i = a; i <= b; i++)
     {
         cum += values->data[i];
+        if (label != NULL)
+            fprintf(fout, "%s\t", label);
         fprintf(fout, "%G\t%d\t%d\t%d\t%G\n", 
             values->min + i * values->e, values->data[i], cum, total - cum, (total - cum) / (double) total);
     }
 }
+
+void values_merge(values_t *values, values_t *other)
+{
+    ASSERT(values->size == other->size, "incompatible score tables");
+    int i;
+    for (i = 0; i < values->size; i++)
+        values->data[i] += other->data[i];
+}
+
+void values_print_sets(FILE *fout, values_t **values, const char **labels, int n, pvalues_t *pvalues)
+{
+    int i, k;
+
+    // [a,b] over all the sets
+    int a = values[0]->size;
+    int b = -1;
+    for (k = 0; k < n; k++)
+    {
+        ASSERT(values[k]->size == values[0]->size, "incompatible score tables");
+        for (i = 0; i < values[k]->size; i++)
+        {
+            if (values[k]->data[i] != 0)
+            {
+                a = MIN(a, i);
+                b = MAX(b, i);
+            }
+        }
+    }
+
+    fprintf(fout, "#score");
+    if (pvalues != NULL)
+        fprintf(fout, "\tPval");
+    for (k = 0; k < n; k++)
+        fprintf(fout, "\t%s_occ\t%s_inv_cum", labels[k], labels[k]);
+    fprintf(fout, "\n");
+
+    int *inv_cum = (int *) malloc(sizeof(int) * n);
+    for (k = 0; k < n; k++)
+    {
+        inv_cum[k] = 0;
+        for (i = a; i <= b; i++)
+            inv_cum[k] += values[k]->data[i];
+    }
+    for (i = a; i <= b; i++)
+    {
+        double score = values[0]->min + i * values[0]->e;
+        fprintf(fout, "%G", score);
+        if (pvalues != NULL)
+            fprintf(fout, "\t%G", score2pvalue(pvalues, score));
+        for (k = 0; k < n; k++)
+        {
+            fprintf(fout, "\t%d\t%d", values[k]->data[i], inv_cum[k]);
+            inv_cum[k] -= values[k]->data[i];
+        }
+        fprintf(fout, "\n");
+    }
+    free(inv_cum);
+}
+
+pos_hist_t *new_pos_hist(int bin)
+{
+    pos_hist_t *hist = (pos_hist_t *) malloc(sizeof(pos_hist_t));
+    hist->bin = bin;
+    hist->first = 0;
+    hist->size = 0;
+    hist->capacity = 0;
+    hist->data[0] = NULL;
+    hist->data[1] = NULL;
+    return hist;
+}
+
+void free_pos_hist(pos_hist_t *hist)
+{
+    free(hist->data[0]);
+    free(hist->data[1]);
+    free(hist);
+}
+
+// make room for the bin indexes [kmin, kmax]
+static
+void pos_hist_extend(pos_hist_t *hist, int kmin, int kmax)
+{
+    if (hist->size > 0)
+    {
+        kmin = MIN(kmin, hist->first);
+        kmax = MAX(kmax, hist->first + hist->size - 1);
+    }
+    int size = kmax - kmin + 1;
+    if (hist->size > 0 && kmin == hist->first && size <= hist->capacity)
+    {
+        hist->size = size;
+        return;
+    }
+
+    int capacity = MAX(size, 2 * hist->capacity);
+    int shift = hist->size > 0 ? hist->first - kmin : 0;
+    int s, i;
+    for (s = 0; s < 2; s++)
+    {
+        int *data = (int *) malloc(sizeof(int) * capacity);
+        ASSERT(data != NULL, "can not allocate positional histogram");
+        for (i = 0; i < capacity; i++)
+            data[i] = 0;
+        for (i = 0; i < hist->size; i++)
+            data[i + shift] = hist->data[s][i];
+        free(hist->data[s]);
+        hist->data[s] = data;
+    }
+    hist->first = kmin;
+    hist->size = size;
+    hist->capacity = capacity;
+}
+
+void pos_hist_add(pos_hist_t *hist, int a, int b, char strand)
+{
+    // bin of the site center (a + b) / 2, rounded down
+    int k = (int) floor((a + b) / (2.0 * hist->bin));
+    if (hist->size == 0 || k < hist->first || k >= hist->first + hist->size)
+        pos_hist_extend(hist, k, k);
+    hist->data[strand == 'R'][k - hist->first] += 1;
+}
+
+void pos_hist_merge(pos_hist_t *hist, pos_hist_t *other)
+{
+    ASSERT(hist->bin == other->bin, "incompatible positional histograms");
+    if (other->size == 0)
+        return;
+    pos_hist_extend(hist, other->first, other->first + other->size - 1);
+    int s, i;
+    for (s = 0; s < 2; s++)
+    {
+        for (i = 0; i < other->size; i++)
+            hist->data[s][i + other->first - hist->first] += other->data[s][i];
+    }
+}
+
+void pos_hist_print(FILE *fout, pos_hist_t *hist, const char *label)
+{
+    int i;
+    for (i = 0; i < hist->size; i++)
+    {
+        int start = (hist->first + i) * hist->bin;
+        int D = hist->data[0][i];
+        int R = hist->data[1][i];
+        fprintf(fout, "%s\t%d\t%d\t%d\t%d\t%d\n", label, start, start + hist->bin - 1, D, R, D + R);
+    }
+}
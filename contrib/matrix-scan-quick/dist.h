@@ -10,6 +10,7 @@
 #define __DIST__
 
 #include "utils.h"
+#include "pval.h"
 
 #ifdef __cplusplus 
 extern "C" {
@@ -32,6 +33,43 @@ void values_add(values_t *values, double value);
 
 void values_print(FILE *fout, values_t *values);
 
+// print the table rows (without header), each one starting with label if not NULL
+void values_print_label(FILE *fout, values_t *values, const char *label);
+
+// add the counts of other to values (same min, max and e)
+void values_merge(values_t *values, values_t *other);
+
+/*
+  print the distributions of several sets (same min, max and e) as one
+  table: for each score, the P-value (if pvalues is not NULL) then the
+  occurrences and the inverse cumulative occurrences (score >= this one)
+  of each set
+*/
+void values_print_sets(FILE *fout, values_t **values, const char **labels, int n, pvalues_t *pvalues);
+
+// positional histogram of the site centers, per strand (-return pos_hist)
+typedef struct
+{
+    int bin;            // bin width
+    int first;          // bin index of data[0], i.e. positions [first * bin, (first + 1) * bin)
+    int size;           // used bins
+    int capacity;
+    int *data[2];       // counts on the D and R strands
+} pos_hist_t;
+
+pos_hist_t *new_pos_hist(int bin);
+
+void free_pos_hist(pos_hist_t *hist);
+
+// count a site [a, b] (positions relative to the origin) on strand 'D' or 'R'
+void pos_hist_add(pos_hist_t *hist, int a, int b, char strand);
+
+// add the counts of other to hist (same bin width)
+void pos_hist_merge(pos_hist_t *hist, pos_hist_t *other);
+
+// print one row per bin from the first to the last non empty one, starting with label
+void pos_hist_print(FILE *fout, pos_hist_t *hist, const char *label);
+
 #ifdef __cplusplus
 }
 #endif
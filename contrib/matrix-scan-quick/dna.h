@@ -0,0 +1,288 @@
+/***************************************************************************
+ *                                                                         *
+ *  dna.h
+ *  nucleotide encoding, reverse complement and 2-bit packing kernels
+ *
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __DNA__
+#define __DNA__
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define DNA_SSSE3
+#endif
+
+/*
+  Residue codes used by all the tools: A C G T (any case) are 0 1 2 3,
+  N and the other IUPAC codes (B D H K M R S V W Y) are DNA_N, so that
+  they keep their position but are never part of a word. The other
+  characters (end of lines, spaces, digits, gaps...) are not residues.
+
+  The kernels work on 16 characters at once with SSSE3 (pshufb table
+  lookups on the low and high nibbles) when the processor has it, and
+  fall back to a lookup table otherwise.
+*/
+
+#define DNA_N    -1
+#define DNA_SKIP  4
+
+static const signed char DNA_CODES[256] =
+{
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  0, -1,  1, -1,  4,  4,  2, -1,  4,  4, -1,  4, -1, -1,  4,
+     4,  4, -1, -1,  3,  4, -1, -1,  4, -1,  4,  4,  4,  4,  4,  4,
+     4,  0, -1,  1, -1,  4,  4,  2, -1,  4,  4, -1,  4, -1, -1,  4,
+     4,  4, -1, -1,  3,  4, -1, -1,  4, -1,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+     4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+};
+
+// code of an ASCII character, DNA_SKIP if it is not a residue
+static inline
+char dna_code(char c)
+{
+    return DNA_CODES[(unsigned char) c];
+}
+
+#ifdef DNA_SSSE3
+
+static inline
+int dna_has_ssse3()
+{
+    static int has = -1;
+    if (has < 0)
+    {
+        __builtin_cpu_init();
+        has = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    }
+    return has;
+}
+
+/*
+  codes of 16 characters; *skip is the mask of the characters that are not
+  residues (bitmaps indexed by the low nibble, one bit per high nibble)
+*/
+__attribute__((target("ssse3"))) static inline
+__m128i dna_encode16(__m128i v, int *skip)
+{
+    const __m128i ACGT_LO  = _mm_setr_epi8(0, 0x50, 0, 0x50, (char) 0xA0, 0, 0, 0x50, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i IUPAC_LO = _mm_setr_epi8(0, 0, (char) 0xF0, (char) 0xA0, 0x50, 0, (char) 0xA0, (char) 0xA0,
+                                           0x50, (char) 0xA0, 0, 0x50, 0, 0x50, 0x50, 0);
+    const __m128i HI_BIT   = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char) 128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i CODE_LO  = _mm_setr_epi8(0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i NIBBLE   = _mm_set1_epi8(0x0F);
+    const __m128i zero     = _mm_setzero_si128();
+
+    __m128i lo = _mm_and_si128(v, NIBBLE);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), NIBBLE);
+    __m128i bit = _mm_shuffle_epi8(HI_BIT, hi);
+    __m128i not_acgt = _mm_cmpeq_epi8(_mm_and_si128(_mm_shuffle_epi8(ACGT_LO, lo), bit), zero);
+    __m128i not_iupac = _mm_cmpeq_epi8(_mm_and_si128(_mm_shuffle_epi8(IUPAC_LO, lo), bit), zero);
+    *skip = _mm_movemask_epi8(_mm_and_si128(not_acgt, not_iupac));
+    // not ACGT: all bits set (DNA_N)
+    return _mm_or_si128(_mm_andnot_si128(not_acgt, _mm_shuffle_epi8(CODE_LO, lo)), not_acgt);
+}
+
+__attribute__((target("ssse3"))) static inline
+long dna_encode_ssse3(const char *in, long n, char *out)
+{
+    const __m128i index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    long i, k = 0;
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        int skip;
+        __m128i codes = dna_encode16(_mm_loadu_si128((const __m128i *) (in + i)), &skip);
+        if (skip == 0)
+        {
+            _mm_storeu_si128((__m128i *) (out + k), codes);
+            k += 16;
+        }
+        else if ((skip & (skip - 1)) == 0)
+        {
+            // a single end of line: the next codes are shifted by one
+            int p = __builtin_ctz(skip);
+            __m128i shift = _mm_sub_epi8(index, _mm_cmpgt_epi8(index, _mm_set1_epi8(p - 1)));
+            _mm_storeu_si128((__m128i *) (out + k), _mm_shuffle_epi8(codes, shift));
+            k += 15;
+        }
+        else
+        {
+            long j;
+            for (j = i; j < i + 16; j++)
+            {
+                char c = dna_code(in[j]);
+                if (c != DNA_SKIP)
+                    out[k++] = c;
+            }
+        }
+    }
+    for (; i < n; i++)
+    {
+        char c = dna_code(in[i]);
+        if (c != DNA_SKIP)
+            out[k++] = c;
+    }
+    return k;
+}
+
+__attribute__((target("ssse3"))) static inline
+void dna_encode_all_ssse3(const char *in, long n, char *out)
+{
+    long i;
+    int skip;
+    for (i = 0; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i *) (out + i), dna_encode16(_mm_loadu_si128((const __m128i *) (in + i)), &skip));
+    for (; i < n; i++)
+    {
+        char c = dna_code(in[i]);
+        out[i] = c == DNA_SKIP ? DNA_N : c;
+    }
+}
+
+__attribute__((target("ssse3"))) static inline
+void dna_revcomp_ssse3(const char *in, long n, char *out)
+{
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i zero = _mm_setzero_si128();
+    long i;
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (in + n - i - 16)), reverse);
+        __m128i invalid = _mm_cmpgt_epi8(zero, x);
+        x = _mm_or_si128(_mm_and_si128(invalid, x), _mm_andnot_si128(invalid, _mm_sub_epi8(three, x)));
+        _mm_storeu_si128((__m128i *) (out + i), x);
+    }
+    for (; i < n; i++)
+    {
+        char c = in[n - i - 1];
+        out[i] = c < 0 ? c : 3 - c;
+    }
+}
+
+#endif
+
+/*
+  encode n characters into out (room for n codes, out may be in), the
+  characters that are not residues are removed; returns the number of codes
+*/
+static inline
+long dna_encode(const char *in, long n, char *out)
+{
+#ifdef DNA_SSSE3
+    if (dna_has_ssse3())
+        return dna_encode_ssse3(in, n, out);
+#endif
+    long i, k = 0;
+    for (i = 0; i < n; i++)
+    {
+        char c = dna_code(in[i]);
+        if (c != DNA_SKIP)
+            out[k++] = c;
+    }
+    return k;
+}
+
+// encode n characters into n codes, every character that is not A C G T is DNA_N
+static inline
+void dna_encode_all(const char *in, long n, char *out)
+{
+#ifdef DNA_SSSE3
+    if (dna_has_ssse3())
+    {
+        dna_encode_all_ssse3(in, n, out);
+        return;
+    }
+#endif
+    long i;
+    for (i = 0; i < n; i++)
+    {
+        char c = dna_code(in[i]);
+        out[i] = c == DNA_SKIP ? DNA_N : c;
+    }
+}
+
+// reverse complement of n codes (out must not overlap in), DNA_N stays DNA_N
+static inline
+void dna_revcomp(const char *in, long n, char *out)
+{
+#ifdef DNA_SSSE3
+    if (dna_has_ssse3())
+    {
+        dna_revcomp_ssse3(in, n, out);
+        return;
+    }
+#endif
+    long i;
+    for (i = 0; i < n; i++)
+    {
+        char c = in[n - i - 1];
+        out[i] = c < 0 ? c : 3 - c;
+    }
+}
+
+/*
+  2-bit packing, 4 residues per byte, the first one in the high bits (as
+  in UCSC 2bit files); DNA_N is packed as 0. Returns the number of bytes.
+*/
+static inline
+long dna_pack(const char *codes, long n, unsigned char *packed)
+{
+    long i;
+    for (i = 0; i < n / 4; i++)
+    {
+        const char *c = codes + 4 * i;
+        packed[i] = (c[0] < 0 ? 0 : c[0] << 6) | (c[1] < 0 ? 0 : c[1] << 4) | (c[2] < 0 ? 0 : c[2] << 2) | (c[3] < 0 ? 0 : c[3]);
+    }
+    if (n % 4 != 0)
+    {
+        packed[i] = 0;
+        long k;
+        for (k = 0; k < n % 4; k++)
+        {
+            if (codes[4 * i + k] > 0)
+                packed[i] |= codes[4 * i + k] << (6 - 2 * k);
+        }
+        i++;
+    }
+    return i;
+}
+
+/*
+  residues [start, start + n) of packed into out; map gives the code of
+  each 2-bit value (0 1 2 3 for dna_pack, 3 1 0 2 for UCSC 2bit files)
+*/
+static inline
+void dna_unpack(const unsigned char *packed, long start, long n, char *out, const char *map)
+{
+    long p = start;
+    long end = start + n;
+    for (; p < end && p % 4 != 0; p++)
+        *out++ = map[(packed[p / 4] >> (6 - 2 * (p % 4))) & 3];
+    for (; p + 4 <= end; p += 4)
+    {
+        unsigned char b = packed[p / 4];
+        out[0] = map[b >> 6];
+        out[1] = map[(b >> 4) & 3];
+        out[2] = map[(b >> 2) & 3];
+        out[3] = map[b & 3];
+        out += 4;
+    }
+    for (; p < end; p++)
+        *out++ = map[(packed[p / 4] >> (6 - 2 * (p % 4))) & 3];
+}
+
+#endif
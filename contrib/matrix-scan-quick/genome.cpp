@@ -0,0 +1,254 @@
+#include <stdint.h>
+
+#include "genome.h"
+
+#define TWOBIT_SIGNATURE 0x1A412743
+
+static
+int compare_seqs(const void *a, const void *b)
+{
+    return strcmp(((const genome_seq_t *) a)->name, ((const genome_seq_t *) b)->name);
+}
+
+static
+genome_seq_t *find_seq(genome_t *genome, const char *chrom)
+{
+    genome_seq_t key;
+    key.name = (char *) chrom;
+    return (genome_seq_t *) bsearch(&key, genome->seqs, genome->nseqs, sizeof(genome_seq_t), compare_seqs);
+}
+
+static
+uint32_t read_uint32(genome_t *genome)
+{
+    uint32_t x;
+    if (fread(&x, sizeof(x), 1, genome->fp) != 1)
+        ERROR("truncated 2bit file");
+    if (genome->swap)
+        x = ((x >> 24) & 0xff) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+    return x;
+}
+
+static
+void read_2bit_index(genome_t *genome)
+{
+    uint32_t signature;
+    if (fread(&signature, sizeof(signature), 1, genome->fp) != 1)
+        ERROR("truncated 2bit file");
+    if (signature != TWOBIT_SIGNATURE)
+    {
+        genome->swap = 1;
+        fseek(genome->fp, 0, SEEK_SET);
+        if (read_uint32(genome) != TWOBIT_SIGNATURE)
+            ERROR("invalid 2bit file");
+    }
+    if (read_uint32(genome) != 0)
+        ERROR("unsupported 2bit version");
+    genome->nseqs = read_uint32(genome);
+    read_uint32(genome);
+    genome->seqs = (genome_seq_t *) malloc(sizeof(genome_seq_t) * genome->nseqs);
+    int i;
+    for (i = 0; i < genome->nseqs; i++)
+    {
+        int size = fgetc(genome->fp);
+        ASSERT(size != EOF, "truncated 2bit file");
+        genome_seq_t *s = &genome->seqs[i];
+        s->name = (char *) malloc(size + 1);
+        if (fread(s->name, 1, size, genome->fp) != (size_t) size)
+            ERROR("truncated 2bit file");
+        s->name[size] = '\0';
+        s->offset = read_uint32(genome);
+    }
+    // sequence sizes
+    for (i = 0; i < genome->nseqs; i++)
+    {
+        fseek(genome->fp, genome->seqs[i].offset, SEEK_SET);
+        genome->seqs[i].size = read_uint32(genome);
+    }
+}
+
+// samtools faidx index: name, length, offset, line bases, line width
+static
+void read_fai_index(genome_t *genome, const char *filename)
+{
+    char *fai = (char *) malloc(strlen(filename) + 5);
+    sprintf(fai, "%s.fai", filename);
+    FILE *fp = fopen(fai, "r");
+    if (fp == NULL)
+        ERROR("unable to open the index '%s' (see samtools faidx)", fai);
+    free(fai);
+
+    int capacity = 64;
+    genome->seqs = (genome_seq_t *) malloc(sizeof(genome_seq_t) * capacity);
+    char name[1024];
+    long size, offset;
+    int line_bases, line_width;
+    while (fscanf(fp, "%1023s %ld %ld %d %d%*[^\n]", name, &size, &offset, &line_bases, &line_width) == 5)
+    {
+        if (genome->nseqs == capacity)
+        {
+            capacity *= 2;
+            genome->seqs = (genome_seq_t *) realloc(genome->seqs, sizeof(genome_seq_t) * capacity);
+        }
+        genome_seq_t *s = &genome->seqs[genome->nseqs++];
+        s->name = strdup(name);
+        s->size = size;
+        s->offset = offset;
+        s->line_bases = line_bases;
+        s->line_width = line_width;
+    }
+    fclose(fp);
+}
+
+genome_t *open_genome(const char *filename)
+{
+    genome_t *genome = (genome_t *) malloc(sizeof(genome_t));
+    genome->fp = fopen(filename, "rb");
+    if (genome->fp == NULL)
+        ERROR("unable to open '%s'", filename);
+    int len = strlen(filename);
+    genome->twobit = len > 5 && strcmp(filename + len - 5, ".2bit") == 0;
+    genome->swap = 0;
+    genome->nseqs = 0;
+    genome->current = -1;
+    genome->nblocks = 0;
+    genome->nstarts = NULL;
+    genome->nsizes = NULL;
+    genome->bgzf = NULL;
+    if (genome->twobit)
+        read_2bit_index(genome);
+    else
+    {
+        genome->bgzf = bgzf_open(filename);
+        read_fai_index(genome, filename);
+    }
+    qsort(genome->seqs, genome->nseqs, sizeof(genome_seq_t), compare_seqs);
+    return genome;
+}
+
+void free_genome(genome_t *genome)
+{
+    int i;
+    for (i = 0; i < genome->nseqs; i++)
+        free(genome->seqs[i].name);
+    free(genome->seqs);
+    free(genome->nstarts);
+    free(genome->nsizes);
+    if (genome->bgzf != NULL)
+        bgzf_close(genome->bgzf);
+    fclose(genome->fp);
+    free(genome);
+}
+
+static
+void fetch_fai(genome_t *genome, genome_seq_t *s, long start, long end, seq_t *seq)
+{
+    long first = s->offset + (start / s->line_bases) * s->line_width + start % s->line_bases;
+    long last = s->offset + ((end - 1) / s->line_bases) * s->line_width + (end - 1) % s->line_bases;
+    char *buffer = (char *) malloc(last - first + 1);
+    long n;
+    if (genome->bgzf != NULL)
+        n = bgzf_read_at(genome->bgzf, first, buffer, last - first + 1);
+    else
+    {
+        fseek(genome->fp, first, SEEK_SET);
+        n = fread(buffer, 1, last - first + 1, genome->fp);
+    }
+    if (n != last - first + 1)
+        ERROR("truncated FASTA file (check the .fai index)");
+    // line by line, the other letters keep their position but are not scanned
+    char *line = buffer;
+    long p = start;
+    while (p < end)
+    {
+        long len = MIN(s->line_bases - p % s->line_bases, end - p);
+        dna_encode_all(line, len, seq->data + seq->size);
+        seq->size += len;
+        p += len;
+        line += len + s->line_width - s->line_bases;
+    }
+    free(buffer);
+}
+
+static
+void fetch_2bit(genome_t *genome, genome_seq_t *s, long start, long end, seq_t *seq)
+{
+    // T, C, A, G in 2bit
+    static const char CODE[4] = {3, 1, 0, 2};
+
+    int index = s - genome->seqs;
+    if (genome->current != index)
+    {
+        fseek(genome->fp, s->offset + 4, SEEK_SET);
+        genome->nblocks = read_uint32(genome);
+        genome->nstarts = (unsigned int *) realloc(genome->nstarts, sizeof(unsigned int) * (genome->nblocks + 1));
+        genome->nsizes = (unsigned int *) realloc(genome->nsizes, sizeof(unsigned int) * (genome->nblocks + 1));
+        int i;
+        for (i = 0; i < genome->nblocks; i++)
+            genome->nstarts[i] = read_uint32(genome);
+        for (i = 0; i < genome->nblocks; i++)
+            genome->nsizes[i] = read_uint32(genome);
+        uint32_t nmasks = read_uint32(genome);
+        genome->dna_offset = s->offset + 4 * (4 + 2 * genome->nblocks + 2 * nmasks);
+        genome->current = index;
+    }
+
+    long first = start / 4;
+    long last = (end - 1) / 4;
+    unsigned char *buffer = (unsigned char *) malloc(last - first + 1);
+    fseek(genome->fp, genome->dna_offset + first, SEEK_SET);
+    if (fread(buffer, 1, last - first + 1, genome->fp) != (size_t) (last - first + 1))
+        ERROR("truncated 2bit file");
+    dna_unpack(buffer, start - 4 * first, end - start, seq->data + seq->size, CODE);
+    seq->size += end - start;
+    free(buffer);
+
+    int i;
+    for (i = 0; i < genome->nblocks; i++)
+    {
+        long a = MAX((long) genome->nstarts[i], start);
+        long b = MIN((long) genome->nstarts[i] + genome->nsizes[i], end);
+        if (a < b)
+            memset(seq->data + a - start, DNA_N, b - a);
+    }
+}
+
+seq_t *genome_fetch(genome_t *genome, const char *chrom, long start, long end)
+{
+    genome_seq_t *s = find_seq(genome, chrom);
+    if (s == NULL)
+        return NULL;
+    start = MAX(start, 0);
+    end = MIN(end, s->size);
+    seq_t *seq = new_seq(MAX(end - start, 1));
+    snprintf(seq->name, 1024, "%s", chrom);
+    if (start >= end)
+        return seq;
+    if (genome->twobit)
+        fetch_2bit(genome, s, start, end, seq);
+    else
+        fetch_fai(genome, s, start, end, seq);
+    return seq;
+}
+
+seq_t *genome_next_region(genome_t *genome, FILE *bed, long *start)
+{
+    char line[4096];
+    char chrom[1024];
+    long end;
+    while (fgets(line, sizeof(line), bed) != NULL)
+    {
+        if (line[0] == '#' || strncmp(line, "track", 5) == 0 || strncmp(line, "browser", 7) == 0)
+            continue;
+        if (sscanf(line, "%1023s %ld %ld", chrom, start, &end) != 3)
+            continue;
+        seq_t *seq = genome_fetch(genome, chrom, *start, end);
+        if (seq != NULL)
+        {
+            *start = MAX(*start, 0);
+            return seq;
+        }
+        WARNING("unknown sequence %s in regions", chrom);
+    }
+    return NULL;
+}
@@ -0,0 +1,72 @@
+/***************************************************************************
+ *                                                                         *
+ *  genome.h
+ *  random access to indexed genomes (faidx FASTA or 2bit)
+ *
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __GENOME__
+#define __GENOME__
+
+#include "seq.h"
+#include "utils.h"
+#include "zio.h"
+#include "dna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  A genome is either a FASTA file indexed with samtools faidx (the index
+  genome.fa.fai must exist) or a UCSC 2bit file (*.2bit). Only the index
+  is read when the genome is opened; each region is then read directly
+  at its offset in the file. The FASTA file can be compressed with bgzip
+  (samtools faidx indexes genome.fa.gz and writes genome.fa.gz.gzi).
+*/
+
+typedef struct
+{
+    char *name;
+    long size;
+    long offset;        // faidx: first base, 2bit: sequence record
+    int line_bases;     // faidx only
+    int line_width;
+} genome_seq_t;
+
+typedef struct
+{
+    FILE *fp;
+    bgzf_reader_t *bgzf; // bgzipped FASTA
+    int twobit;
+    int swap;           // 2bit file of the other endianness
+    int nseqs;
+    genome_seq_t *seqs; // sorted by name
+    // N blocks of the last 2bit sequence read
+    int current;
+    long dna_offset;
+    int nblocks;
+    unsigned int *nstarts;
+    unsigned int *nsizes;
+} genome_t;
+
+genome_t *open_genome(const char *filename);
+
+void free_genome(genome_t *genome);
+
+// sequence [start, end) (0-based) of chrom, named chrom; NULL if chrom is unknown
+seq_t *genome_fetch(genome_t *genome, const char *chrom, long start, long end);
+
+/*
+  sequence of the next region of a BED file (chrom, start, end), clipped
+  to the chromosome; start is set to the region start. Header lines and
+  unknown chromosomes are skipped. NULL at the end of the file.
+*/
+seq_t *genome_next_region(genome_t *genome, FILE *bed, long *start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
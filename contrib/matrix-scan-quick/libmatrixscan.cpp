@@ -0,0 +1,148 @@
+#include "matrixscan.h"
+#include "markov.h"
+#include "matrix.h"
+#include "dna.h"
+
+struct ms_background
+{
+    markov_t *markov;
+};
+
+struct ms_matrix
+{
+    Array array;
+};
+
+int ms_api_version(void)
+{
+    return MATRIXSCAN_API_VERSION;
+}
+
+ms_background_t *ms_background_load(const char *filename)
+{
+    markov_t *markov = read_markov(filename, MARKOV_INCLUSIVE, 0.0);
+    if (markov == NULL)
+        return NULL;
+    ms_background_t *bg = new ms_background_t;
+    bg->markov = markov;
+    return bg;
+}
+
+ms_background_t *ms_background_bernoulli(const double priori[4])
+{
+    ms_background_t *bg = new ms_background_t;
+    bg->markov = new_markov_bernoulli(priori);
+    return bg;
+}
+
+void ms_background_free(ms_background_t *bg)
+{
+    free_markov(bg->markov);
+    delete bg;
+}
+
+ms_matrix_t *ms_matrix_load(const char *filename, const ms_background_t *bg, double pseudo)
+{
+    ms_matrix_t *matrix = new ms_matrix_t;
+    if (!read_matrix(matrix->array, filename, pseudo) || matrix->array.J >= 256)
+    {
+        delete matrix;
+        return NULL;
+    }
+    matrix->array.transform2logfreq(*bg->markov);
+    return matrix;
+}
+
+ms_matrix_t *ms_matrix_new(const double *counts, int width, const ms_background_t *bg, double pseudo)
+{
+    if (width <= 0 || width >= 256)
+        return NULL;
+    ms_matrix_t *matrix = new ms_matrix_t;
+    matrix->array.alloc(4, width);
+    matrix->array.pseudo = pseudo;
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < width; j++)
+            matrix->array[i][j] = counts[i * width + j];
+    }
+    matrix->array.transform2logfreq(*bg->markov);
+    return matrix;
+}
+
+int ms_matrix_width(const ms_matrix_t *matrix)
+{
+    return matrix->array.J;
+}
+
+void ms_matrix_free(ms_matrix_t *matrix)
+{
+    delete matrix;
+}
+
+void ms_encode(const char *bases, int size, char *data)
+{
+    dna_encode_all(bases, size, data);
+}
+
+static inline
+double word_score(const Array &array, const markov_t *markov, const char *word)
+{
+    return array.logP(word) - markov_logP(markov, word, array.J);
+}
+
+double ms_score(const ms_matrix_t *matrix, const ms_background_t *bg, const char *word)
+{
+    return word_score(matrix->array, bg->markov, word);
+}
+
+long ms_scan(const ms_matrix_t *matrix, const ms_background_t *bg, const ms_seqview_t *seq,
+             int both_strands, double threshold, ms_hit_callback callback, void *data)
+{
+    const Array &array = matrix->array;
+    const markov_t *markov = bg->markov;
+    int l = array.J;
+    char rcword[256];
+    long scanned = 0;
+    ms_hit_t hit;
+
+    if (seq == NULL || seq->size < 0 || (seq->size > 0 && seq->data == NULL))
+        return -1;
+
+    // next invalid residue at or after i, so that each residue is checked once
+    int invalid = -1;
+    for (int i = 0; i + l <= seq->size; i++)
+    {
+        if (invalid < i)
+        {
+            invalid = i;
+            while (invalid < seq->size && seq->data[invalid] >= 0)
+                invalid++;
+        }
+        if (invalid < i + l)
+            continue;
+
+        const char *word = &seq->data[i];
+        scanned++;
+        hit.pos = i;
+        hit.weight = word_score(array, markov, word);
+        if (hit.weight >= threshold)
+        {
+            hit.strand = 'D';
+            if (callback(&hit, data))
+                return scanned;
+        }
+
+        if (!both_strands)
+            continue;
+
+        dna_revcomp(word, l, rcword);
+        hit.weight = word_score(array, markov, rcword);
+        if (hit.weight >= threshold)
+        {
+            hit.strand = 'R';
+            if (callback(&hit, data))
+                return scanned;
+        }
+    }
+    return scanned;
+}
@@ -25,6 +25,11 @@ using namespace std;
 #include "seq.h"
 #include "dist.h"
 #include "pval.h"
+#include "server.h"
+#include "crer.h"
+#include "genome.h"
+#include "zio.h"
+#include "pipeline.h"
 
 int VERSION = 20160208;
 char *COMMAND_LINE;
@@ -68,12 +73,13 @@ void help()
 "    Only sequences in FASTA format are supported.\n"
 "\n"
 "  Matrix file\n"
-"    Only the tab format is supported.\n"
-"    Only the first matrix in the file is used.\n"
+"    tab (default), transfac, jaspar, meme or cluster-buster format (-matrix_format).\n"
+"    Only the first matrix in the file is used, or the one given by -matrix_id.\n"
 "    See convert-matrix for details.\n"
 "\n"
 "  Background file\n"
-"    Only the INCLUSive format is supported.\n"
+"    INCLUSive (default) or oligo-analysis format (-bg_format), the\n"
+"    latter converted to transitions with the -bg_pseudo pseudo-frequency.\n"
 "    See convert-background-model for details.\n"
 "\n"
 "OUTPUT FORMAT\n"
@@ -86,17 +92,59 @@ void help()
 "ARGUMENTS\n"
 "    -h, --help            show this help message and exit.\n"
 "\n"
-"    -i #                  read sequence from filename # (FASTA format).\n"
+"    -i #                  read sequence from filename # (FASTA format, plain or\n"
+"                          compressed with gzip or bgzip).\n"
 "                          if not specified, the standard input is used.\n"
+"                          A pipe or a compressed file is read, parsed and scanned by\n"
+"                          concurrent stages; with -origin start, long sequences are\n"
+"                          scanned while they are read.\n"
+"\n"
+"    -set label #          scan the sequences of filename # as the set label. The option\n"
+"                          can be repeated (e.g. a positive set and control sets); all\n"
+"                          the sets are scanned with the same matrix, and the output is\n"
+"                          one score distribution table with, for each set, the number\n"
+"                          of sites with this score (label_occ) and with a score >= this\n"
+"                          one (label_inv_cum), and the P-value of the score with -distrib.\n"
+"\n"
+"    -regions #            scan the regions of the BED file # (chrom, start, end) read\n"
+"                          directly in the -genome file instead of the -i sequences.\n"
+"                          The sequence names are the chromosomes and the positions\n"
+"                          are genome coordinates (1-based, -origin is ignored).\n"
+"\n"
+"    -genome #             indexed genome for -regions: a FASTA file with its samtools\n"
+"                          faidx index (#.fai), possibly compressed with bgzip, or a\n"
+"                          UCSC 2bit file (*.2bit).\n"
 "\n"
 "    -o #                  print the output to filename #.\n"
 "                          if not specified, the standard output is used.\n"
 "\n"
-"    -m #                  read the matrix # or first matrix in # (must be in tab format).\n"
+"    -m #                  read the matrix # or first matrix in # (tab format by default).\n"
 " \n"
-"    -bgfile #             use # as background model (must be in INCLUSive format).\n"
+"    -matrix_format #      format of the -m file: tab, transfac, jaspar, meme or\n"
+"                          cluster-buster (cb).\n"
+"\n"
+"    -matrix_id #          scan with the matrix of id (or name) # of the -m file, e.g. a\n"
+"                          motif database, instead of the first one.\n"
+"\n"
+"    -bgfile #             use # as background model (INCLUSive format by default).\n"
 "                          by default an equiprobable model is used.\n"
 "\n"
+"    -bg_format #          format of the -bgfile: inclusive or oligos (oligo-analysis\n"
+"                          frequencies, plain or compressed).\n"
+"\n"
+"    -window #             use a local background model trained on a sliding window of\n"
+"                          # residues centered on each scanned word (as matrix-scan\n"
+"                          -window). The model is updated incrementally, so the scan\n"
+"                          is barely slower than with a global model. The matrix\n"
+"                          pseudo-counts still use the -bgfile (or equiprobable) priors,\n"
+"                          and -distrib P-values are only approximate.\n"
+"\n"
+"    -markov #             order of the local background model (0 by default).\n"
+"\n"
+"    -bg_pseudo #          pseudo-frequency of the local background model\n"
+"                          (sqrt(window) / (sqrt(window) + window) by default) and of\n"
+"                          an oligos -bgfile (0.01 by default).\n"
+"\n"
 "    -2str                 scan both DNA strands.\n"
 "\n"
 "    -1str                 scan only one DNA strand.\n"
@@ -110,6 +158,32 @@ void help()
 "\n"
 "    -return sites         output the list of sites (default).\n"
 "\n"
+"    -return seq_stats     output one line per sequence with the number of sites, the\n"
+"                          best site (weight, strand, start, end) and, with -distrib,\n"
+"                          the sum and the minimum of the site P-values.\n"
+"\n"
+"    -return pos_hist      output the positional histogram of the sites instead of sites:\n"
+"                          one row per bin of -bin positions (relative to -origin and\n"
+"                          -offset) with the number of site centers on each strand.\n"
+"                          Bins are counted during the scan, sites are not stored.\n"
+"\n"
+"    -bin #                bin width for -return pos_hist (50 by default).\n"
+"\n"
+"    -return crer          output the cis-regulatory element enriched regions (CRER)\n"
+"                          instead of sites, in the matrix-scan format. Requires -distrib,\n"
+"                          -t is then the P-value of the sites. Each region is the\n"
+"                          largest one ending on a site whose binomial P-value passes\n"
+"                          the thresholds; regions contained in another one are not\n"
+"                          reported. Sequences are scanned with a single thread.\n"
+"\n"
+"    -lth field #, -uth field #\n"
+"                          lower and upper thresholds on the CRER fields crer_size,\n"
+"                          crer_sites (lower 2 by default), crer_site_distance (lower 1\n"
+"                          by default, closer sites are discarded), crer_pval (upper)\n"
+"                          and crer_sig (lower), as in matrix-scan.\n"
+"\n"
+"    -crer_ids             number the regions (crer_1, crer_2, ...) in the ft_name column.\n"
+"\n"
 "    -distrib #            read score distrib file # (generated by matrix-distrib).\n"
 "\n"
 "    -decimals #           precision parameter for the -return distrib option.\n"
@@ -125,6 +199,31 @@ void help()
 "                           (see matrix-scan manual for details).\n"
 "\n"
 "    -offset #             add an offset to the origin (0 by default)\n"
+"\n"
+"    -threads #            number of threads used to scan long sequences (1 by default).\n"
+"                          sequences longer than the chunk size are cut in chunks\n"
+"                          scanned in parallel; the output is the same as with one thread.\n"
+"\n"
+"    -chunk #              number of positions per chunk for -threads (1000000 by default).\n"
+"\n"
+"    -perm #               also score # column-permuted copies of the matrix in the same\n"
+"                          pass over the sequences, and output the weight score\n"
+"                          distribution of each matrix (original first) instead of sites,\n"
+"                          with the matrix name (or name_perm_col_N) in the first column.\n"
+"\n"
+"    -seed #               seed of the random permutations (by default the time).\n"
+"\n"
+"SERVER MODE\n"
+"    matrix-scan-quick -server socket [-i seq.fa]... [-m matrix]... [-matrix_format #]\n"
+"                      [-bgfile background]...\n"
+"                          load the given sequences, matrix files (all the matrices of\n"
+"                          each file, in the -matrix_format format, tab by default) and\n"
+"                          (INCLUSive) background models once and answer scan requests\n"
+"                          on the Unix socket.\n"
+"\n"
+"    -socket #             send the scan to the server listening on socket #. All the\n"
+"                          other options are the usual ones; the files loaded by the\n"
+"                          server are used from memory, the others are read as usual.\n"
 "\n"
    );
 }
@@ -134,16 +233,24 @@ void help()
  * MAIN
  *
  */
-int main(int argc, char *argv[])
+int scan_main(int argc, char *argv[])
 {
     VERBOSITY = 0;
 
     char *outfile     = NULL;
     char *seqfile     = NULL;
     char *bgfile      = NULL;
+    int bg_format     = MARKOV_INCLUSIVE;
     char *matfile     = NULL;
+    int matrix_format = MATRIX_TAB;
+    char *matrix_id   = NULL;
     char *distribfile = NULL;
     int distrib       = 0;
+    int seq_stats     = 0;
+    int crer_mode     = 0;
+    int pos_hist_mode = 0;
+    int bin           = 50;
+    crer_params_t crer_params;
     int rc            = TRUE;
     char *matrix_name = (char *) "matrix";
     double precision  = 0.1;
@@ -153,8 +260,21 @@ int main(int argc, char *argv[])
     int    offset     = 0;
     int    first_hit  = FALSE;
     int    best_hit  = FALSE;
+    int    nthreads   = 1;
+    int    chunk      = 1000000;
+    int    perm       = 0;
+    vector< pair<char *, char *> > sets;
+    char *regionsfile = NULL;
+    char *genomefile  = NULL;
+    int    window     = 0;
+    int    markov_order = 0;
+    double bg_pseudo  = -1;
+    unsigned int seed = (unsigned int) time(NULL);
     FILE *fout        = NULL;
     pvalues_t *pvalues = NULL;
+    crer_t *crer      = NULL;
+
+    crer_params_init(&crer_params);
 
     // construct command line string
     string cmdline = "";
@@ -211,6 +331,22 @@ int main(int argc, char *argv[])
             ASSERT(argc > i + 1, "-i requires a filename");
             seqfile = argv[++i];
         }
+        else if (strcmp(argv[i], "-set") == 0)
+        {
+            ASSERT(argc > i + 2, "-set requires a label and a filename");
+            sets.push_back(make_pair(argv[i + 1], argv[i + 2]));
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-regions") == 0)
+        {
+            ASSERT(argc > i + 1, "-regions requires a filename");
+            regionsfile = argv[++i];
+        }
+        else if (strcmp(argv[i], "-genome") == 0)
+        {
+            ASSERT(argc > i + 1, "-genome requires a filename");
+            genomefile = argv[++i];
+        }
         else if (strcmp(argv[i], "-origin") == 0)
         {
             ASSERT(argc > i + 1, "-origin requires a value");
@@ -234,11 +370,30 @@ int main(int argc, char *argv[])
             ASSERT(argc > i + 1, "-m requires a filename");
             matfile = argv[++i];
         }
+        else if (strcmp(argv[i], "-matrix_format") == 0)
+        {
+            ASSERT(argc > i + 1, "-matrix_format requires a value");
+            matrix_format = parse_matrix_format(argv[++i]);
+            if (matrix_format < 0)
+                ERROR("invalid value for option -matrix_format");
+        }
+        else if (strcmp(argv[i], "-matrix_id") == 0)
+        {
+            ASSERT(argc > i + 1, "-matrix_id requires a value");
+            matrix_id = argv[++i];
+        }
         else if (strcmp(argv[i], "-bgfile") == 0)
         {
             ASSERT(argc > i + 1, "-bgfile requires a filename");
             bgfile = argv[++i];
         }
+        else if (strcmp(argv[i], "-bg_format") == 0)
+        {
+            ASSERT(argc > i + 1, "-bg_format requires a value");
+            bg_format = parse_markov_format(argv[++i]);
+            if (bg_format < 0)
+                ERROR("invalid value for option -bg_format");
+        }
         else if (strcmp(argv[i], "-distrib") == 0)
         {
             ASSERT(argc > i + 1, "-distrib requires a filename");
@@ -250,8 +405,34 @@ int main(int argc, char *argv[])
             char *roption = argv[++i];
             if (strcmp(roption, "distrib") == 0)
                 distrib = TRUE;
+            else if (strcmp(roption, "seq_stats") == 0)
+                seq_stats = TRUE;
+            else if (strcmp(roption, "crer") == 0)
+                crer_mode = TRUE;
+            else if (strcmp(roption, "pos_hist") == 0)
+                pos_hist_mode = TRUE;
+            else if (strcmp(roption, "sites") == 0)
+                distrib = seq_stats = crer_mode = pos_hist_mode = FALSE;
             // TODO: add more options
         }
+        else if (strcmp(argv[i], "-lth") == 0 || strcmp(argv[i], "-uth") == 0)
+        {
+            ASSERT(argc > i + 2, "-lth and -uth require a field and a value");
+            int upper = strcmp(argv[i], "-uth") == 0;
+            if (!crer_params_set(&crer_params, argv[i + 1], atof(argv[i + 2]), upper))
+                WARNING("unsupported threshold %s %s", argv[i], argv[i + 1]);
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-bin") == 0)
+        {
+            ASSERT(argc > i + 1, "-bin requires a number");
+            bin = atoi(argv[++i]);
+            ASSERT(bin >= 1, "invalid bin width");
+        }
+        else if (strcmp(argv[i], "-crer_ids") == 0)
+        {
+            crer_params.ids = TRUE;
+        }
         else if (strcmp(argv[i], "-decimals") == 0)
         {
             ASSERT(argc > i + 1, "-decimals requires a number");
@@ -275,6 +456,47 @@ int main(int argc, char *argv[])
             ASSERT(argc > i + 1, "-pseudo requires a number");
             pseudo = atof(argv[++i]);
         }
+        else if (strcmp(argv[i], "-threads") == 0)
+        {
+            ASSERT(argc > i + 1, "-threads requires a number");
+            nthreads = atoi(argv[++i]);
+            ASSERT(nthreads >= 1, "invalid number of threads");
+        }
+        else if (strcmp(argv[i], "-chunk") == 0)
+        {
+            ASSERT(argc > i + 1, "-chunk requires a number");
+            chunk = atoi(argv[++i]);
+            ASSERT(chunk >= 1, "invalid chunk size");
+        }
+        else if (strcmp(argv[i], "-window") == 0)
+        {
+            ASSERT(argc > i + 1, "-window requires a number");
+            window = atoi(argv[++i]);
+            ASSERT(window >= 1, "invalid window size");
+        }
+        else if (strcmp(argv[i], "-markov") == 0)
+        {
+            ASSERT(argc > i + 1, "-markov requires a number");
+            markov_order = atoi(argv[++i]);
+            ASSERT(markov_order >= 0 && markov_order <= 5, "invalid markov order (should be between 0 and 5)");
+        }
+        else if (strcmp(argv[i], "-bg_pseudo") == 0)
+        {
+            ASSERT(argc > i + 1, "-bg_pseudo requires a number");
+            bg_pseudo = atof(argv[++i]);
+            ASSERT(bg_pseudo >= 0 && bg_pseudo <= 1, "invalid pseudo-frequency (should be between 0 and 1)");
+        }
+        else if (strcmp(argv[i], "-perm") == 0)
+        {
+            ASSERT(argc > i + 1, "-perm requires a number");
+            perm = atoi(argv[++i]);
+            ASSERT(perm >= 0, "invalid number of permutations");
+        }
+        else if (strcmp(argv[i], "-seed") == 0)
+        {
+            ASSERT(argc > i + 1, "-seed requires a number");
+            seed = (unsigned int) atol(argv[++i]);
+        }
         else if (strcmp(argv[i], "-offset") == 0)
         {
             ASSERT(argc > i + 1, "-oofset requires a number");
@@ -309,18 +531,37 @@ int main(int argc, char *argv[])
    if (VERBOSITY >= 1)
         fprintf(stdout, "; %s\n", COMMAND_LINE);
 
-    // set bg model
-    Markov markov;
-    if (bgfile != NULL)
+    // set bg model (resident if run by the server)
+    markov_t *bg = NULL;
+    markov_t *markov = NULL;
+    if (bgfile != NULL && bg_format == MARKOV_INCLUSIVE && resident_bg(bgfile) != NULL)
+    {
+        bg = resident_bg(bgfile);
+    }
+    else if (bgfile != NULL)
     {
-        if (!load_inclusive(markov, bgfile))
+        markov = read_markov(bgfile, bg_format, bg_pseudo < 0 ? 0.01 : bg_pseudo);
+        if (markov == NULL)
             ERROR("can not load bg model");
+        bg = markov;
     }
     else
     {
         VERBOSE2("using default bernoulli model (computed using input)");
         double priori[4] = {0.25, 0.25, 0.25, 0.25};
-        bernoulli(markov, priori);
+        markov = new_markov_bernoulli(priori);
+        bg = markov;
+    }
+
+    // local background (-window)
+    markov_window_t *window_bg = NULL;
+    if (window > 0)
+    {
+        if (window < markov_order + 1)
+            ERROR("window size (%d) must be larger than markov order + 1", window);
+        if (bg_pseudo < 0)
+            bg_pseudo = sqrt((double) window) / (sqrt((double) window) + window);
+        window_bg = new_markov_window(markov_order, window, bg_pseudo);
     }
 
     if (matfile == NULL)
@@ -332,27 +573,146 @@ int main(int argc, char *argv[])
 
     // matrix
     Array matrix;
-    read_matrix(matrix, matfile, pseudo);
-    matrix.transform2logfreq(markov);
+    matrix_db_t *db = resident_matrices(matfile, matrix_format);
+    if (db != NULL)
+    {
+        int k = matrix_id != NULL ? matrix_db_find(db, matrix_id) : 0;
+        if (!db_matrix(matrix, db, k, pseudo))
+            ERROR("can not load matrix '%s'", matrix_id != NULL ? matrix_id : matfile);
+    }
+    else
+    {
+        if (!read_matrix(matrix, matfile, pseudo, matrix_format, matrix_id))
+            ERROR("can not load matrix '%s'", matrix_id != NULL ? matrix_id : matfile);
+    }
+    matrix.transform2logfreq(*bg);
+
+    // regions of an indexed genome (-regions)
+    genome_t *genome = NULL;
+    FILE *bed = NULL;
+    if (regionsfile != NULL)
+    {
+        if (genomefile == NULL)
+            ERROR("-regions requires -genome");
+        if (!sets.empty())
+            ERROR("-regions can not be used with -set");
+        genome = open_genome(genomefile);
+        bed = fopen(regionsfile, "r");
+        if (bed == NULL)
+            ERROR("unable to open '%s'", regionsfile);
+        origin = -1;
+    }
+
+    // an explicit -return distrib replaces the other outputs
+    if (distrib)
+        seq_stats = crer_mode = pos_hist_mode = FALSE;
+
+    if (crer_mode)
+    {
+        if (distribfile == NULL)
+            ERROR("-return crer requires -distrib");
+        if (perm > 0)
+            ERROR("-return crer can not be used with -perm");
+        if (seq_stats || first_hit || best_hit)
+            ERROR("-return crer can not be used with seq_stats, -first_hit_per_seq or -best_hit_per_seq");
+        if (theshold < 0 || theshold > 1)
+            ERROR("-return crer requires a P-value threshold on the sites (-t)");
+        crer = new_crer(&crer_params, theshold, rc);
+    }
+
+    // input sets (-set) are score distributions
+    if (!sets.empty())
+    {
+        if (perm > 0)
+            ERROR("-set can not be used with -perm");
+        if (seq_stats || pos_hist_mode || crer_mode)
+            ERROR("-set can not be used with -return seq_stats, pos_hist or crer");
+        distrib = TRUE;
+    }
 
     // values (distrib)
     values_t *values = NULL;
-    if (distrib)
+    if (distrib && sets.empty())
         values = new_values(-1000, 10000.0, precision);
 
-    // sequences
-    FILE *fp;
-    if (seqfile == NULL)
-        fp = stdin;
-    else
-        fp = fopen(seqfile, "r");
-
-    if (fp == NULL)
-        ERROR("unable to open '%s'", seqfile);
+    // column-permuted matrices (-perm), matrices[0] is the original one
+    Array **matrices = NULL;
+    values_t **perm_values = NULL;
+    if (perm > 0)
+    {
+        if (distribfile != NULL)
+            ERROR("-perm can not be used with -distrib");
+        if (seq_stats)
+            ERROR("-perm can not be used with -return seq_stats");
+        if (pos_hist_mode)
+            ERROR("-perm can not be used with -return pos_hist");
+        if (window_bg != NULL)
+            ERROR("-perm can not be used with -window");
+        distrib = TRUE;
+        srand(seed);
+        matrices = new Array*[perm + 1];
+        perm_values = new values_t*[perm + 1];
+        int k;
+        for (k = 0; k <= perm; k++)
+        {
+            matrices[k] = new Array(matrix);
+            perm_values[k] = new_values(-1000, 10000.0, precision);
+            if (k == 0)
+                continue;
+
+            // shuffle the columns (Fisher-Yates)
+            int j;
+            int *columns = new int[matrix.J];
+            for (j = 0; j < matrix.J; j++)
+                columns[j] = j;
+            for (j = matrix.J - 1; j > 0; j--)
+            {
+                int r = rand() % (j + 1);
+                int tmp = columns[j];
+                columns[j] = columns[r];
+                columns[r] = tmp;
+            }
+            for (j = 0; j < matrix.J; j++)
+            {
+                int b;
+                for (b = 0; b < matrix.I; b++)
+                    (*matrices[k])[b][j] = matrix[b][columns[j]];
+            }
+            if (VERBOSITY >= 1)
+            {
+                fprintf(stdout, "; %s_perm_col_%d columns", matrix_name, k);
+                for (j = 0; j < matrix.J; j++)
+                    fprintf(stdout, "%c%d", j == 0 ? ' ' : ',', columns[j] + 1);
+                fprintf(stdout, "\n");
+            }
+            delete []columns;
+        }
+        if (VERBOSITY >= 1)
+            fprintf(stdout, "; seed %u\n", seed);
+    }
 
-    fasta_reader_t *reader = new_fasta_reader(fp);
+    // positional histogram (-return pos_hist), for all the sequences
+    pos_hist_t *hist = NULL;
+    if (pos_hist_mode)
+    {
+        if (seq_stats || crer_mode || best_hit)
+            ERROR("-return pos_hist can not be used with seq_stats, crer or -best_hit_per_seq");
+        hist = new_pos_hist(bin);
+    }
 
-    if (!distrib)
+    if (crer != NULL)
+    {
+        crer_print_header(fout);
+    }
+    else if (seq_stats)
+    {
+        fprintf(fout, "#seq_id\tft_name\tscanned\thits\tmax_weight\tmax_strand\tmax_start\tmax_end");
+        if (distribfile)
+            fprintf(fout, "\tsum_Pval\tmin_Pval\n");
+        else
+            fprintf(fout, "\n");
+    }
+    else if (!distrib && hist == NULL)
     {
         fprintf(fout, "#seq_id\tft_type\tft_name\tstrand\tstart\tend\tsequence\tweight");
         if (distribfile)
@@ -361,23 +721,155 @@ int main(int argc, char *argv[])
             fprintf(fout, "\n");
     }
 
-    // scan all sequences
-    int s = 1;
+    // input sets (-set), each one with its own score distribution
+    if (sets.empty())
+        sets.push_back(make_pair((char *) NULL, seqfile));
+    int nsets = (int) sets.size();
+    values_t **set_values = new values_t*[nsets];
+    int *set_scanned = new int[nsets];
+
+    // scan all sequences of all the sets
     int scanned_pos = 0;
-    while (1)
+    int k;
+    for (k = 0; k < nsets; k++)
     {
-        seq_t *seq = fasta_reader_next(reader);
-        if (seq == NULL)
-            break;
-        scan_seq(fout, seq, s++, matrix, markov, values, theshold, rc, pvalues, origin, offset, matrix_name, &scanned_pos, first_hit, best_hit);
-        free_seq(seq);
+        seqfile = sets[k].second;
+        set_values[k] = values;
+        if (sets[k].first != NULL)
+            set_values[k] = new_values(-1000, 10000.0, precision);
+
+        // sequences (resident if run by the server)
+        int nseqs = 0;
+        seq_t **seqs = NULL;
+        fasta_reader_t *reader = NULL;
+        fasta_pipeline_t *pipeline = NULL;
+        FILE *fp = NULL;
+        if (seqfile != NULL)
+            seqs = resident_seqs(seqfile, &nseqs);
+        if (seqs == NULL && bed == NULL)
+        {
+            // stdin if no file, plain, gzip or BGZF
+            fp = zopen(seqfile);
+            if (fp == NULL)
+                ERROR("unable to open '%s'", seqfile);
+
+            // non-seekable input (pipe, compressed file): read, parse and scan in stages
+            if (is_seekable(fp))
+                reader = new_fasta_reader(fp);
+            else
+                pipeline = new_fasta_pipeline(fp, MAX(PIPELINE_PIECE_SIZE, nthreads * chunk));
+        }
+
+        int scanned_before = scanned_pos;
+
+        // a record is scanned by pieces while it is read when the positions do not depend on its length
+        if (pipeline != NULL && perm == 0 && origin == -1 && window_bg == NULL)
+        {
+            scan_stream_t *stream = NULL;
+            fasta_piece_t *piece;
+            while ((piece = fasta_pipeline_next_piece(pipeline)) != NULL)
+            {
+                if (stream == NULL)
+                    stream = scan_stream_begin(fout, piece->seq->name, matrix, *bg, set_values[k], theshold, rc, pvalues, origin, offset,
+                                               matrix_name, &scanned_pos, first_hit, best_hit, seq_stats, hist, crer, window_bg, nthreads, chunk);
+                scan_stream_add(stream, piece->seq, piece->position);
+                if (piece->last)
+                {
+                    scan_stream_end(stream);
+                    stream = NULL;
+                }
+                free_fasta_piece(piece);
+            }
+        }
+
+        int s = 1;
+        while (1)
+        {
+            seq_t *seq;
+            long region_start = 0;
+            if (seqs != NULL)
+                seq = s <= nseqs ? seqs[s - 1] : NULL;
+            else if (bed != NULL)
+                seq = genome_next_region(genome, bed, &region_start);
+            else if (pipeline != NULL)
+                seq = fasta_pipeline_next(pipeline);
+            else
+                seq = fasta_reader_next(reader);
+            if (seq == NULL)
+                break;
+            if (perm > 0)
+                scan_seq_perm(seq, matrices, perm + 1, *bg, perm_values, theshold, rc, &scanned_pos, nthreads, chunk);
+            else
+                scan_seq(fout, seq, s, matrix, *bg, set_values[k], theshold, rc, pvalues, origin, offset - (int) region_start, matrix_name, &scanned_pos, first_hit, best_hit, seq_stats, hist, crer, window_bg, nthreads, chunk);
+            s++;
+            if (seqs == NULL)
+                free_seq(seq);
+        }
+        set_scanned[k] = scanned_pos - scanned_before;
+        if (reader != NULL)
+            free_fasta_reader(reader);
+        if (pipeline != NULL)
+            free_fasta_pipeline(pipeline);
+        if (fp != NULL)
+            zclose(fp);
     }
 
-    if (distrib)
+    if (perm > 0)
+    {
+        // one distribution per matrix, labeled in the first column
+        fprintf(fout, "#matrix\tscore\tocc\tco\tcco\tdCDF\n");
+        char label[1024];
+        int k;
+        for (k = 0; k <= perm; k++)
+        {
+            if (k == 0)
+                snprintf(label, sizeof(label), "%s", matrix_name);
+            else
+                snprintf(label, sizeof(label), "%s_perm_col_%d", matrix_name, k);
+            values_print_label(fout, perm_values[k], label);
+            free_values(perm_values[k]);
+            delete matrices[k];
+        }
+        delete []perm_values;
+        delete []matrices;
+    }
+    else if (sets[0].first != NULL)
+    {
+        // one column pair per set, for enrichment and ROC curves
+        for (k = 0; k < nsets; k++)
+            fprintf(fout, "; set %s\t%s\t%d scanned positions\n", sets[k].first, sets[k].second, set_scanned[k]);
+        const char **labels = new const char*[nsets];
+        for (k = 0; k < nsets; k++)
+            labels[k] = sets[k].first;
+        values_print_sets(fout, set_values, labels, nsets, pvalues);
+        for (k = 0; k < nsets; k++)
+            free_values(set_values[k]);
+        delete []labels;
+    }
+    else if (distrib)
         values_print(fout, values);
+    else if (hist != NULL)
+    {
+        fprintf(fout, "#ft_name\tbin_start\tbin_end\tocc_D\tocc_R\tocc\n");
+        pos_hist_print(fout, hist, matrix_name);
+        free_pos_hist(hist);
+    }
 
+    delete []set_values;
+    if (genome != NULL)
+    {
+        free_genome(genome);
+        fclose(bed);
+    }
+    delete []set_scanned;
     if (distribfile)
         free_pvalues(pvalues);
+    if (crer != NULL)
+        free_crer(crer);
+    if (window_bg != NULL)
+        free_markov_window(window_bg);
+    if (markov != NULL)
+        free_markov(markov);
 
     // time info
     char time_buffer[256];
@@ -392,5 +884,29 @@ int main(int argc, char *argv[])
         strftime (time_buffer, 256, "%Y_%m_%d.%H%M%S", end_time);
         printf("; Job done    %s\n", time_buffer);
     }
+    if (fout != stdout)
+        fclose(fout);
     return 0;
 }
+
+int main(int argc, char *argv[])
+{
+    // server and client modes
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-server") == 0)
+            return server_main(argc, argv);
+    }
+    for (i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "-socket") == 0)
+        {
+            char *socket_path = argv[i + 1];
+            for (; i + 2 < argc; i++)
+                argv[i] = argv[i + 2];
+            return client_main(socket_path, argc - 2, argv);
+        }
+    }
+    return scan_main(argc, argv);
+}
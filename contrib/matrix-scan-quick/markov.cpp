@@ -1,141 +1,722 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
 #include "markov.h"
-#include "utils.h"
+#include "dna.h"
+#include "zio.h"
+
+#define MARKOV_LINE_SIZE 4096
+
+markov_t *new_markov(int order)
+{
+    markov_t *self = (markov_t *) malloc(sizeof(markov_t));
+    self->order = order;
+    self->msize = 1 << (2 * order);
+    self->S     = (double *) malloc(sizeof(double) * self->msize);
+    self->T     = (double *) malloc(sizeof(double) * self->msize * 4);
+    self->logS  = (double *) malloc(sizeof(double) * self->msize);
+    self->logT  = (double *) malloc(sizeof(double) * self->msize * 4);
+    int i;
+    for (i = 0; i < self->msize; i++)
+        self->S[i] = 1.0 / self->msize;
+    for (i = 0; i < self->msize * 4; i++)
+        self->T[i] = 0.25;
+    for (i = 0; i < 4; i++)
+        self->priori[i] = 0.25;
+    return self;
+}
+
+void free_markov(markov_t *self)
+{
+    free(self->S);
+    free(self->T);
+    free(self->logS);
+    free(self->logT);
+    free(self);
+}
+
+// logarithms of S, T and priori
+static
+void markov_update_logs(markov_t *self)
+{
+    int i;
+    for (i = 0; i < self->msize; i++)
+        self->logS[i] = log(self->S[i]);
+    for (i = 0; i < self->msize * 4; i++)
+        self->logT[i] = log(self->T[i]);
+    for (i = 0; i < 4; i++)
+        self->logpriori[i] = log(self->priori[i]);
+}
+
+markov_t *new_markov_uniform()
+{
+    markov_t *self = new_markov(0);
+    markov_update_logs(self);
+    return self;
+}
+
+markov_t *new_markov_bernoulli(const double *priori)
+{
+    markov_t *self = new_markov(0);
+    self->S[0] = 1.0;
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        self->priori[i] = priori[i];
+        self->T[i] = priori[i];
+    }
+    markov_update_logs(self);
+    return self;
+}
+
+static inline
+int char2int(char c)
+{
+    int code = dna_code(c);
+    return code == DNA_SKIP ? -1 : code;
+}
+
+static inline
+int int2char(int i)
+{
+    switch (i)
+    {
+    case 0:
+        return 'a';
+    case 1:
+        return 'c';
+    case 2:
+        return 'g';
+    case 3:
+        return 't';
+    default:
+        return 'n';
+    }
+}
+
+static
+int oligo2index_char(const char *seq, int pos, int l)
+{
+    int value = 0;
+    int S = 1;
+    int i;
+    for (i = l - 1; i >= 0; i--)
+    {
+        int v = char2int(seq[pos + i]);
+        if (v == -1)
+            return -1;
+        value += S * v;
+        S *= 4;
+    }
+    return value;
+}
+
+int oligo2index(char *seq, int pos, int l)
+{
+    int value = 0;
+    int S = 1;
+    int i;
+    for (i = l - 1; i >= 0; i--)
+    {
+        int v = seq[pos + i];
+        if (v == -1)
+            return -1;
+        value += S * v;
+        S *= 4;
+    }
+    return value;
+}
+
+int oligo2index_rc(char *seq, int pos, int l)
+{
+    int value = 0;
+    int S = 1;
+    int i;
+    for (i = 0; i < l; i++)
+    {
+        int v = seq[pos + i];
+        if (v == -1)
+            return -1;
+        value += S * (3 - v);
+        S *= 4;
+    }
+    return value;
+}
+
+void index2oligo(int index, int l, char *buffer)
+{
+    int S = 1;
+    int i;
+    buffer[l] = '\0';
+    for (i = l - 1; i >= 0; i--)
+    {
+        buffer[i] = (index / S) % 4;
+        S *= 4;
+    }
+}
+
+void index2oligo_char(int index, int l, char *buffer)
+{
+    int S = 1;
+    int i;
+    buffer[l] = '\0';
+    for (i = l - 1; i >= 0; i--)
+    {
+        buffer[i] = int2char((index / S) % 4);
+        S *= 4;
+    }
+}
 
-#define SNF               1
-#define OLIGO_FREQUENCY   2
-#define TRANSITION_MATRIX 3
+void index2oligo_rc_char(int index, int l, char *buffer)
+{
+    int S = 1;
+    int i;
+    buffer[l] = '\0';
+    for (i = l - 1; i >= 0; i--)
+    {
+        buffer[l - i - 1] = int2char(3 - (index / S) % 4);
+        S *= 4;
+    }
+}
+
+// index of the reverse complement of the word index of length l
+static
+int index_rc(int index, int l)
+{
+    int rc = 0;
+    int i;
+    for (i = 0; i < l; i++)
+    {
+        rc = rc * 4 + (3 - index % 4);
+        index /= 4;
+    }
+    return rc;
+}
+
+int parse_markov_format(const char *name)
+{
+    if (strcmp(name, "oligos") == 0 || strcmp(name, "oligo-analysis") == 0)
+        return MARKOV_OLIGOS;
+    else if (strcmp(name, "inclusive") == 0 || strcmp(name, "ms") == 0 || strcmp(name, "motifsampler") == 0)
+        return MARKOV_INCLUSIVE;
+    return -1;
+}
+
+// remove the end of line and the trailing spaces, 0 if the line is then empty
+static
+int chomp(char *line)
+{
+    int n = strlen(line);
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r' || line[n - 1] == ' ' || line[n - 1] == '\t'))
+        line[--n] = '\0';
+    return n;
+}
 
-int bernoulli(Markov &m, double *priori)
+/*
+  oligo-analysis file: frequencies of the (order+1)-mers, converted to
+  transitions with the pseudo-frequency as convert-background-model
+*/
+static
+markov_t *read_markov_oligos(FILE *fp, double pseudo)
 {
-    m.dealloc();
-    m.alloc(0);
-    m.S[0] = 1.0;
-    for (int i = 0; i < ALPHABET_SIZE; i++)
+    char line[MARKOV_LINE_SIZE];
+    double *freq = NULL;        // frequency of each (order+1)-mer
+    int l = 0;
+    int two_strands = 0;
+    int valid = 1;
+
+    while (valid && fgets(line, sizeof(line), fp) != NULL)
+    {
+        if (chomp(line) == 0 || line[0] == ';' || line[0] == '#' || strncmp(line, "--", 2) == 0)
+            continue;
+        char *fields[3];
+        int nfields = 0;
+        char *p = strtok(line, " \t");
+        while (p != NULL && nfields < 3)
+        {
+            fields[nfields++] = p;
+            p = strtok(NULL, " \t");
+        }
+        if (nfields < 2)
+        {
+            valid = 0;
+            break;
+        }
+        if (freq == NULL)
+        {
+            l = strlen(fields[0]);
+            if (l < 1 || l > 8)
+            {
+                valid = 0;
+                break;
+            }
+            freq = (double *) calloc(1 << (2 * l), sizeof(double));
+        }
+
+        // word freq (old format), or word id freq
+        char *end;
+        double f = strtod(fields[1], &end);
+        int old_format = *end == '\0';
+        if (!old_format && nfields == 3)
+            f = strtod(fields[2], &end);
+        int index = oligo2index_char(fields[0], 0, l);
+        if ((int) strlen(fields[0]) != l || *end != '\0' || f < 0)
+            valid = 0;
+        else if (index >= 0)
+        {
+            freq[index] = f;
+            if (!old_format && strchr(fields[1], '|') != NULL)
+            {
+                two_strands = 1;
+                freq[index_rc(index, l)] = f;
+            }
+        }
+    }
+    if (!valid || freq == NULL)
+    {
+        free(freq);
+        return NULL;
+    }
+
+    // the words of 2str files are counted on both strands
+    int nwords = 1 << (2 * l);
+    int i;
+    if (two_strands)
+    {
+        for (i = 0; i < nwords; i++)
+        {
+            if (index_rc(i, l) != i)
+                freq[i] /= 2;
+        }
+    }
+
+    markov_t *self = new_markov(l - 1);
+    double sum = 0.0;
+    for (i = 0; i < nwords; i++)
+        sum += freq[i];
+    if (sum <= 0)
     {
-        m.priori[i] = priori[i];
-        m.logpriori[i] = log(priori[i]);
-        m.T[0][i] = priori[i];
+        free(freq);
+        free_markov(self);
+        return NULL;
     }
-    return 1;
+
+    double suffix_sum[4] = {0.0, 0.0, 0.0, 0.0};
+    for (i = 0; i < self->msize; i++)
+    {
+        double prefix_sum = 0.0;
+        int j;
+        for (j = 0; j < 4; j++)
+        {
+            prefix_sum += freq[4 * i + j];
+            suffix_sum[j] += freq[4 * i + j];
+        }
+        self->S[i] = (prefix_sum * (1 - pseudo) + sum * pseudo / self->msize) / sum;
+        for (j = 0; j < 4; j++)
+        {
+            if (prefix_sum > 0)
+                self->T[4 * i + j] = (1 - pseudo) * freq[4 * i + j] / prefix_sum + pseudo / 4;
+            else
+                self->T[4 * i + j] = 0.25;
+        }
+    }
+    for (i = 0; i < 4; i++)
+        self->priori[i] = (suffix_sum[i] * (1 - pseudo) + sum * pseudo / 4) / sum;
+
+    // order 0: Bernoulli on the single nucleotide frequencies (as INCLUSive)
+    if (self->order == 0)
+    {
+        self->S[0] = 1.0;
+        for (i = 0; i < 4; i++)
+            self->T[i] = self->priori[i];
+    }
+    free(freq);
+    return self;
 }
 
+#define INCLUSIVE_SNF               1
+#define INCLUSIVE_OLIGO_FREQUENCY   2
+#define INCLUSIVE_TRANSITION_MATRIX 3
+
 // --
 // #INCLUSive Background Model v1.0
 // #
 // #Order = 1
 // #Organism = athaliana
 // #Sequences = /users/sista/thijs/scratch/DNA/intergenic.tfa
-// #Path = 
+// #Path =
 // #
-// 
+//
 // #snf
-// 0.3449  0.1581  0.1556  0.3414  
-// 
-// #oligo frequency 
+// 0.3449  0.1581  0.1556  0.3414
+//
+// #oligo frequency
 // 0.3449
 // 0.1581
 // 0.1556
 // 0.3414
-// 
+//
 // #transition matrix
-// 0.3911  0.1516  0.1482  0.3091  
-// 0.3760  0.1703  0.1268  0.3269  
-// 0.3630  0.1389  0.1671  0.3311  
-// 0.2756  0.1678  0.1711  0.3855  
+// 0.3911  0.1516  0.1482  0.3091
+// 0.3760  0.1703  0.1268  0.3269
+// 0.3630  0.1389  0.1671  0.3311
+// 0.2756  0.1678  0.1711  0.3855
 // --
-
-int load_inclusive(Markov &m, string filename)
+static
+markov_t *read_markov_inclusive(FILE *fp)
 {
-    m.dealloc();
-
-    ifstream f;
-    f.open(filename.c_str());
-    if (!f) 
-    {
-        ERROR("unable to open '%s'", filename.c_str());
-        return 0;
-    }
-    string line;
-    char const *buffer;
-    int order = -1;
+    char line[MARKOV_LINE_SIZE];
+    markov_t *self = NULL;
     int step = 0;
+    int snf = 0;
     int s = 0;
     int t = 0;
-    float val[4];
-    
-    getline(f, line);
-    if (strncmp(line.c_str(), "#INCLUSive", 10) != 0)
-    {
-        f.close();
-        return 0;
-    }
-    
-    while (getline(f, line))
+    double val[4];
+
+    while (fgets(line, sizeof(line), fp) != NULL)
     {
-        buffer = line.c_str();
+        if (chomp(line) == 0)
+            continue;
         if (line[0] == '#')
         {
-            if (sscanf(buffer, "%*s %*s %d", &order) == 1)
-                m.alloc(order);
-            else if (line == "#snf")
-                step = SNF;
-            else if (line == "#oligo frequency")
-                step = OLIGO_FREQUENCY;
-            else if (line == "#transition matrix")
-                step = TRANSITION_MATRIX;
-        }
-        else
-        {
-            if (order == -1)
-                break;
-            if (step == SNF)
+            int order;
+            if (strncmp(line, "#Order", 6) == 0 && sscanf(line, "%*s %*s %d", &order) == 1)
             {
-                if (sscanf(buffer, "%f %f %f %f", &val[0], &val[1], &val[2], &val[3]) == 4)
-                {
-                    m.priori[0] = (double) val[0];
-                    m.priori[1] = (double) val[1];
-                    m.priori[2] = (double) val[2];
-                    m.priori[3] = (double) val[3];
-
-                    m.logpriori[0] = log(m.priori[0]);
-                    m.logpriori[1] = log(m.priori[1]);
-                    m.logpriori[2] = log(m.priori[2]);
-                    m.logpriori[3] = log(m.priori[3]);
-                }
+                if (self != NULL || order < 0 || order > 8)
+                    break;
+                self = new_markov(order);
             }
-            else if (step == OLIGO_FREQUENCY)
+            else if (strcmp(line, "#snf") == 0)
+                step = INCLUSIVE_SNF;
+            else if (strcmp(line, "#oligo frequency") == 0)
+                step = INCLUSIVE_OLIGO_FREQUENCY;
+            else if (strcmp(line, "#transition matrix") == 0)
+                step = INCLUSIVE_TRANSITION_MATRIX;
+            continue;
+        }
+        if (self == NULL)
+            break;
+        if (step == INCLUSIVE_SNF)
+        {
+            if (sscanf(line, "%lf %lf %lf %lf", &val[0], &val[1], &val[2], &val[3]) == 4)
             {
-                 if (s < m.msize)
-                 {
-                    sscanf(buffer, "%f", &val[0]);
-                    m.S[s] = (double) val[0];
-                    s++;
-                 }
+                memcpy(self->priori, val, sizeof(val));
+                snf = 1;
             }
-            else if (step == TRANSITION_MATRIX)
+        }
+        else if (step == INCLUSIVE_OLIGO_FREQUENCY)
+        {
+            if (s < self->msize && sscanf(line, "%lf", &val[0]) == 1)
+                self->S[s++] = val[0];
+        }
+        else if (step == INCLUSIVE_TRANSITION_MATRIX)
+        {
+            if (t < self->msize && sscanf(line, "%lf %lf %lf %lf", &val[0], &val[1], &val[2], &val[3]) == 4)
             {
-                if (t < m.msize)
-                {
-                    if (sscanf(buffer, "%f %f %f %f", &val[0], &val[1], &val[2], &val[3]) == 4)
-                    {
-                        m.T[t][0] = (double) val[0];
-                        m.T[t][1] = (double) val[1];
-                        m.T[t][2] = (double) val[2];
-                        m.T[t][3] = (double) val[3];                                        
-                        t++;
-                    }
-                }
+                memcpy(self->T + 4 * t, val, sizeof(val));
+                t++;
             }
         }
     }
-    f.close();
+    if (self == NULL)
+        return NULL;
+    if (s < self->msize || t < self->msize)
+    {
+        free_markov(self);
+        return NULL;
+    }
+
+    int i, j;
+    if (!snf)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            self->priori[j] = 0.0;
+            for (i = 0; i < self->msize; i++)
+                self->priori[j] += self->S[i] * self->T[4 * i + j];
+        }
+    }
+
+    // special case when order=0: Bernoulli on the single nucleotide frequencies
+    if (self->order == 0)
+    {
+        self->S[0] = 1.0;
+        for (j = 0; j < 4; j++)
+            self->T[j] = self->priori[j];
+    }
+    return self;
+}
+
+markov_t *read_markov(const char *filename, int format, double pseudo)
+{
+    FILE *fp = zopen(filename);
+    if (fp == NULL)
+        return NULL;
+    markov_t *self = NULL;
+    if (format == MARKOV_OLIGOS)
+        self = read_markov_oligos(fp, pseudo);
+    else if (format == MARKOV_INCLUSIVE)
+        self = read_markov_inclusive(fp);
+    zclose(fp);
+    if (self != NULL)
+        markov_update_logs(self);
+    return self;
+}
+
+void write_markov(FILE *fp, const markov_t *self, int format)
+{
+    int i, j;
+    if (format == MARKOV_OLIGOS)
+    {
+        char word[16];
+        fprintf(fp, "#seq\tid\tfreq\n");
+        for (i = 0; i < self->msize * 4; i++)
+        {
+            index2oligo_char(i, self->order + 1, word);
+            fprintf(fp, "%s\t%s\t%.8f\n", word, word, self->S[i / 4] * self->T[i]);
+        }
+        return;
+    }
 
-    // special case when order=0
-    if (m.order == 0)
-        m.S[0] = 1.0;
+    fprintf(fp, "#INCLUSive Background Model v1.0\n#\n#Order = %d\n#Organism = unknown\n#Sequences = \n#Path = \n#\n",
+            self->order);
+    fprintf(fp, "\n#snf\n%.5f\t%.5f\t%.5f\t%.5f\n", self->priori[0], self->priori[1], self->priori[2], self->priori[3]);
 
-    if (m.order == -1)
-        return 0;
+    // for order 0, the oligo frequencies are the nucleotide frequencies, repeated 4 times as transitions
+    fprintf(fp, "\n#oligo frequency\n");
+    if (self->order == 0)
+    {
+        for (j = 0; j < 4; j++)
+            fprintf(fp, "%.5f\n", self->priori[j]);
+    }
     else
-        return 1;
+    {
+        for (i = 0; i < self->msize; i++)
+            fprintf(fp, "%.5f\n", self->S[i]);
+    }
+    fprintf(fp, "\n#transition matrix\n");
+    int rows = self->order == 0 ? 4 : self->msize;
+    for (i = 0; i < rows; i++)
+    {
+        const double *T = self->T + (self->order == 0 ? 0 : 4 * i);
+        fprintf(fp, "%.5f\t%.5f\t%.5f\t%.5f\n", T[0], T[1], T[2], T[3]);
+    }
+}
+
+double markov_prefix_P(const markov_t *self, const char *word, int len)
+{
+    int index = 0;
+    int i;
+    for (i = 0; i < len; i++)
+        index = index * 4 + word[i];
+    int n = 1 << (2 * (self->order - len));
+    double p = 0.0;
+    for (i = index * n; i < (index + 1) * n; i++)
+        p += self->S[i];
+    return p;
+}
+
+double markov_P(markov_t *self, char *seq, int pos, int length)
+{
+    char *word = seq + pos;
+    int i;
+    for (i = 0; i < length; i++)
+    {
+        if (word[i] < 0)
+            return 0.0;
+    }
+    if (length <= self->order)
+        return markov_prefix_P(self, word, length);
+
+    int mask = self->msize - 1;
+    int prefix = 0;
+    for (i = 0; i < self->order; i++)
+        prefix = prefix * 4 + word[i];
+    double p = self->S[prefix];
+    for (i = self->order; i < length; i++)
+    {
+        p *= self->T[4 * prefix + word[i]];
+        prefix = (prefix * 4 + word[i]) & mask;
+    }
+    return p;
+}
+
+void markov_track(const markov_t *self, const char *codes, long n, double *logS, double *logT)
+{
+    int order = self->order;
+    int mask = self->msize - 1;
+    int prefix = 0;
+    int valid = 0;      // valid residues before i (at most order)
+    long i;
+    for (i = 0; i < n; i++)
+    {
+        int c = codes[i];
+        logT[i] = valid == order && c >= 0 ? self->logT[4 * prefix + c] : 0.0;
+        if (c < 0)
+        {
+            valid = 0;
+            prefix = 0;
+        }
+        else
+        {
+            prefix = (prefix * 4 + c) & mask;
+            if (valid < order)
+                valid++;
+        }
+        // the prefix [i - order + 1, i] is complete
+        if (order > 0 && i + 1 >= order)
+            logS[i + 1 - order] = valid == order ? self->logS[prefix] : 0.0;
+    }
+    if (order == 0)
+    {
+        for (i = 0; i < n; i++)
+            logS[i] = self->logS[0];
+    }
+    else
+    {
+        for (i = n - order + 1 > 0 ? n - order + 1 : 0; i < n; i++)
+            logS[i] = 0.0;
+    }
+}
+
+/*
+  local model
+*/
+markov_window_t *new_markov_window(int order, int width, double pseudo)
+{
+    markov_window_t *self = (markov_window_t *) malloc(sizeof(markov_window_t));
+    self->order = order;
+    self->width = width;
+    self->pseudo = pseudo;
+    self->msize = 1 << (2 * order);
+    self->C = (int *) malloc(sizeof(int) * self->msize * 4);
+    self->CP = (int *) malloc(sizeof(int) * self->msize);
+    self->logT = (double *) malloc(sizeof(double) * self->msize * 4);
+    self->logS = (double *) malloc(sizeof(double) * self->msize);
+    self->total = 0;
+    self->data = NULL;
+    self->size = 0;
+    self->start = -1;
+    return self;
+}
+
+void free_markov_window(markov_window_t *self)
+{
+    free(self->C);
+    free(self->CP);
+    free(self->logT);
+    free(self->logS);
+    free(self);
+}
+
+// index of the (order+1)-mer at position i, -1 if invalid
+static inline
+int window_word_index(const markov_window_t *self, int i)
+{
+    int idx = 0;
+    int k;
+    for (k = 0; k <= self->order; k++)
+    {
+        if (self->data[i + k] < 0)
+            return -1;
+        idx = idx * 4 + self->data[i + k];
+    }
+    return idx;
+}
+
+static
+void window_update_prefix(markov_window_t *self, int prefix)
+{
+    double pseudo = self->pseudo;
+    int s;
+    for (s = 0; s < 4; s++)
+    {
+        double f = self->CP[prefix] == 0 ? 0.25 : (double) self->C[prefix * 4 + s] / self->CP[prefix];
+        self->logT[prefix * 4 + s] = log((1.0 - pseudo) * f + pseudo / 4);
+    }
+    double f = self->total == 0 ? 1.0 / self->msize : (double) self->CP[prefix] / self->total;
+    self->logS[prefix] = log((1.0 - pseudo) * f + pseudo / self->msize);
+}
+
+static
+void window_add(markov_window_t *self, int i, int n)
+{
+    int idx = window_word_index(self, i);
+    if (idx < 0)
+        return;
+    self->C[idx] += n;
+    self->CP[idx / 4] += n;
+    self->total += n;
+}
+
+// count the window [start, start + width) of the sequence
+static
+void window_reset(markov_window_t *self, const char *seq, int len, int start)
+{
+    self->data = seq;
+    self->size = len;
+    self->start = start;
+    memset(self->C, 0, sizeof(int) * self->msize * 4);
+    memset(self->CP, 0, sizeof(int) * self->msize);
+    self->total = 0;
+    int end = start + self->width < len ? start + self->width : len;
+    int i;
+    for (i = start; i + self->order < end; i++)
+        window_add(self, i, 1);
+    for (i = 0; i < self->msize; i++)
+        window_update_prefix(self, i);
+}
+
+void markov_window_move(markov_window_t *self, const char *seq, int len, int i, int l)
+{
+    int s = i + l / 2 - self->width / 2;
+    if (s > len - self->width)
+        s = len - self->width;
+    if (s < 0)
+        s = 0;
+    if (seq != self->data || len != self->size || s < self->start || s > self->start + 1)
+    {
+        window_reset(self, seq, len, s);
+        return;
+    }
+    if (s == self->start)
+        return;
+
+    // slide by one: the first word leaves, a new last word enters
+    int start = self->start;
+    int last = start + self->width - self->order;
+    int out = window_word_index(self, start);
+    int in = window_word_index(self, last);
+    window_add(self, start, -1);
+    window_add(self, last, 1);
+    self->start = s;
+    if (out == in)
+        return;
+    if ((out < 0) != (in < 0))
+    {
+        // the number of words changed
+        int p;
+        for (p = 0; p < self->msize; p++)
+            window_update_prefix(self, p);
+        return;
+    }
+    // otherwise only the two prefixes changed
+    window_update_prefix(self, out / 4);
+    window_update_prefix(self, in / 4);
+}
+
+double markov_window_logP(const markov_window_t *self, const char *word, int len)
+{
+    int prefix = 0;
+    int i;
+    for (i = 0; i < self->order; i++)
+        prefix = prefix * 4 + word[i];
+    double p = self->logS[prefix];
+    for (i = self->order; i < len; i++)
+    {
+        p += self->logT[prefix * 4 + word[i]];
+        prefix = (prefix * 4 + word[i]) % self->msize;
+    }
+    return p;
 }
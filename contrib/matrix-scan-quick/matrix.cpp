@@ -2,12 +2,8 @@
 #include "utils.h"
 
 /*
-  restrictive matrix reader
-  only well formatted matrices in tab format can be read
-  base order must be A C G T
-  SHOULD BE REWRITTEN IN A LESS RESTRICTIVE WAY
-
-  example of valid format:
+  the matrix id of filename (the first one if id is NULL), in any format
+  of matrixio.h; the tab format is as follows:
 ; motif.length                  6       
 ; motif.conservation            0.91    
 ; 
@@ -16,65 +12,35 @@ c |     0.030   0.910   0.910   0.030   0.030   0.030
 g |     0.910   0.030   0.030   0.030   0.030   0.910
 t |     0.030   0.030   0.030   0.030   0.030   0.030
 */
-int read_matrix(Array &matrix, char *filename, double pseudo)
+int read_matrix(Array &matrix, const char *filename, double pseudo, int format, const char *id)
 {
-    // open file
-    FILE *fp = fopen(filename, "r");
-
-    if (fp == NULL)
-        ERROR("unable to open '%s'", filename);
-
-    // read data
-    float p[4][256];
-    char base[4];
-    int l = 0;
-    int c = -1;
-    while (l < 4 && !feof(fp))
-    {
-        if (fscanf(fp, "%c", &base[l]) < 0)
-            return 0;
-
-        if (base[l] == ';') // skip comments
-        {
-            char buffer[1024];
-            if (fgets(buffer, 1024, fp) == NULL)
-                return 0;
-            continue;
-        }
-
-        if (fscanf(fp, " | ") < 0)
-            return 0;
-        c = -1;
-        while (++c < 256)
-        {
-            float v;
-            if (fscanf(fp, "%f", &v) != 1)
-                break;
-            p[l][c] = v;
-        }
-        l++;
-    }
+    matrix_db_t *db = read_matrix_db(filename, format);
+    if (db == NULL)
+        return 0;
+
+    int k = id != NULL ? matrix_db_find(db, id) : 0;
+    int ok = db_matrix(matrix, db, k, pseudo);
+    free_matrix_db(db);
+    return ok;
+}
 
-    // check validity
-    ASSERT(base[0] == 'a' || base[0] == 'A', "invalid matrix format");
-    ASSERT(base[1] == 'c' || base[1] == 'C', "invalid matrix format");
-    ASSERT(base[2] == 'g' || base[2] == 'G', "invalid matrix format");
-    ASSERT(base[3] == 't' || base[3] == 'T', "invalid matrix format");
+int db_matrix(Array &matrix, const matrix_db_t *db, int k, double pseudo)
+{
+    if (k < 0 || k >= db->n || db->matrices[k].width >= 256)
+        return 0;
 
     // convert to matrix
-    matrix.alloc(l, c);
+    int c = db->matrices[k].width;
+    matrix.alloc(4, c);
     matrix.pseudo = pseudo;
 
-    int i;
-    for (i = 0; i < l; i++)
+    int j;
+    for (j = 0; j < c; j++)
     {
-        int j;
-        for (j = 0; j < c; j++)
-            matrix[i][j] = p[i][j];
+        double *column = matrix_db_column(db, k, j);
+        int i;
+        for (i = 0; i < 4; i++)
+            matrix[i][j] = column[i];
     }
-
-    // close stream
-    fclose(fp);
-    
     return 1;
 }
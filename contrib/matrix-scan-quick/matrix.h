@@ -15,13 +15,13 @@
 
 #include "utils.h"
 #include "markov.h"
+#include "matrixio.h"
 
 struct Array 
 {
     double **data;
     int I;
     int J;
-    double p;
     double pseudo;
     
     Array(int dim1=0, int dim2=0, double val=0.0, double pseudo_value=1.0)
@@ -58,7 +58,6 @@ struct Array
         I = a.I;
         J = a.J;
         pseudo = a.pseudo;
-        p = a.p;
         alloc(I, J);
         for (int i = 0; i < I; i++)
         {
@@ -82,7 +81,6 @@ struct Array
         I = a.I;
         J = a.J;
         pseudo = a.pseudo;
-        p = a.p;
         alloc(I, J);
         for (int i = 0; i < I; i++)
         {
@@ -114,7 +112,7 @@ struct Array
         return buf.str();
     }
 
-    void transform2logfreq(Markov &markov)
+    void transform2logfreq(const markov_t &markov)
     {
         for (int j = 0; j < J; j++)
         {
@@ -161,9 +159,9 @@ struct Array
     }
 
     // need to call transform2logfreq before
-    double logP(char *word)
+    double logP(const char *word) const
     {
-        p = 0.0;
+        double p = 0.0;
         for (int i = 0; i < J; i++)
             p += data[(int) word[i]][i];
         return p;
@@ -171,6 +169,10 @@ struct Array
 
 };
 
-int read_matrix(Array &matrix, char *filename, double pseudo);
+// returns 0 if the file can not be read, is not valid in this format or has no matrix id
+int read_matrix(Array &matrix, const char *filename, double pseudo, int format=MATRIX_TAB, const char *id=NULL);
+
+// matrix k of db, returns 0 if there is no such matrix
+int db_matrix(Array &matrix, const matrix_db_t *db, int k, double pseudo);
 
 #endif
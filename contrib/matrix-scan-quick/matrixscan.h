@@ -0,0 +1,97 @@
+/***************************************************************************
+ *                                                                         *
+ *  matrixscan.h
+ *  C API of libmatrixscan (PSSM scanning library)
+ *
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __MATRIXSCAN__
+#define __MATRIXSCAN__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Scoring of matrix-scan-quick as a shared library, for programs that
+  scan many sequences or matrices in a single process (e.g. from Perl
+  through FFI::Platypus) instead of running the executable.
+
+  Backgrounds and matrices are read only once created, so they can be
+  shared by threads; ms_scan only uses its own stack. Functions that
+  create objects return NULL on error, they never exit the program.
+
+  The weight of a word is the one of matrix-scan-quick:
+      log P(word | matrix) - log P(word | background)
+  where the matrix frequencies are smoothed with pseudo-counts spread
+  according to the background residue priors.
+*/
+
+#define MATRIXSCAN_API_VERSION 1
+
+typedef struct ms_background ms_background_t;
+typedef struct ms_matrix ms_matrix_t;
+
+/* view on an encoded sequence (see ms_encode), the data is not copied */
+typedef struct
+{
+    const char *data;
+    int size;
+} ms_seqview_t;
+
+typedef struct
+{
+    int pos;            /* start of the site, 0-based on the direct strand */
+    char strand;        /* 'D' or 'R' */
+    double weight;
+} ms_hit_t;
+
+/* called for each hit, a non-zero return value stops the scan */
+typedef int (*ms_hit_callback)(const ms_hit_t *hit, void *data);
+
+/* MATRIXSCAN_API_VERSION of the library */
+int ms_api_version(void);
+
+/* background model in INCLUSive format (see convert-background-model) */
+ms_background_t *ms_background_load(const char *filename);
+
+/* Bernoulli background with priors pA, pC, pG, pT */
+ms_background_t *ms_background_bernoulli(const double priori[4]);
+
+void ms_background_free(ms_background_t *bg);
+
+/* first matrix of a tab file, compiled for bg */
+ms_matrix_t *ms_matrix_load(const char *filename, const ms_background_t *bg, double pseudo);
+
+/* matrix from counts[4 * width] (rows A, C, G, T), compiled for bg */
+ms_matrix_t *ms_matrix_new(const double *counts, int width, const ms_background_t *bg, double pseudo);
+
+int ms_matrix_width(const ms_matrix_t *matrix);
+
+void ms_matrix_free(ms_matrix_t *matrix);
+
+/*
+  encodes size bases (A, C, G, T in any case) into data, other letters
+  (N, ...) are encoded as -1 and no word containing them is scored
+*/
+void ms_encode(const char *bases, int size, char *data);
+
+/* weight of the encoded word of ms_matrix_width(matrix) bases */
+double ms_score(const ms_matrix_t *matrix, const ms_background_t *bg, const char *word);
+
+/*
+  reports the words of seq with a weight >= threshold on the direct
+  strand (and the reverse one if both_strands), by increasing position,
+  the direct strand first; bg must be the model the matrix was compiled
+  for. Returns the number of scored positions (until the callback stopped
+  the scan) or -1 on error.
+*/
+long ms_scan(const ms_matrix_t *matrix, const ms_background_t *bg, const ms_seqview_t *seq,
+             int both_strands, double threshold, ms_hit_callback callback, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,222 @@
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pipeline.h"
+
+#define PIPELINE_BLOCK_SIZE (1 << 20)
+#define PIPELINE_PIECES     4
+
+/*
+  SPSC queue
+*/
+spsc_queue_t *new_spsc_queue(long capacity)
+{
+    spsc_queue_t *q = (spsc_queue_t *) malloc(sizeof(spsc_queue_t));
+    q->items = (void **) malloc(sizeof(void *) * capacity);
+    q->capacity = capacity;
+    q->head = 0;
+    q->tail = 0;
+    return q;
+}
+
+void free_spsc_queue(spsc_queue_t *q)
+{
+    free(q->items);
+    free(q);
+}
+
+// the other side is late: spin a little, then leave it the processor
+static inline
+void spsc_wait(int *tries)
+{
+    if (++(*tries) < 64)
+        sched_yield();
+    else
+        usleep(50);
+}
+
+void spsc_push(spsc_queue_t *q, void *item)
+{
+    long tail = q->tail;
+    int tries = 0;
+    while (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == q->capacity)
+        spsc_wait(&tries);
+    q->items[tail % q->capacity] = item;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void *spsc_pop(spsc_queue_t *q)
+{
+    long head = q->head;
+    int tries = 0;
+    while (__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == head)
+        spsc_wait(&tries);
+    void *item = q->items[head % q->capacity];
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+/*
+  stages
+*/
+static
+void *reader_stage(void *arg)
+{
+    fasta_pipeline_t *p = (fasta_pipeline_t *) arg;
+    int fd = fileno(p->fp);
+    while (1)
+    {
+        fasta_block_t *block = (fasta_block_t *) spsc_pop(p->free_blocks);
+        // what is available, a pipe does not wait for the whole block
+        ssize_t n;
+        do
+            n = read(fd, block->data, PIPELINE_BLOCK_SIZE);
+        while (n < 0 && errno == EINTR);
+        block->size = n > 0 ? n : 0;
+        spsc_push(p->full_blocks, block);
+        if (block->size == 0)
+            return NULL;
+    }
+}
+
+// fill function of the reader of the encoder stage
+static
+int fill_from_blocks(fasta_reader_t *reader)
+{
+    fasta_pipeline_t *p = (fasta_pipeline_t *) reader->source;
+    if (p->eof)
+        return 0;
+    if (p->current != NULL)
+        spsc_push(p->free_blocks, p->current);
+    p->current = (fasta_block_t *) spsc_pop(p->full_blocks);
+    if (p->current->size == 0)
+    {
+        p->eof = 1;
+        return 0;
+    }
+    reader->buffer = p->current->data;
+    reader->size = p->current->size;
+    return 1;
+}
+
+static
+void *encoder_stage(void *arg)
+{
+    fasta_pipeline_t *p = (fasta_pipeline_t *) arg;
+    char name[1024];
+    while (fasta_reader_begin(p->reader, name))
+    {
+        long position = 0;
+        int last = 0;
+        while (!last)
+        {
+            fasta_piece_t *piece = (fasta_piece_t *) malloc(sizeof(fasta_piece_t));
+            piece->seq = new_seq(MIN(p->piece_size, 4096));
+            strcpy(piece->seq->name, name);
+            piece->position = position;
+            last = fasta_reader_read(p->reader, piece->seq, p->piece_size) < p->piece_size;
+            piece->last = last;
+            position += piece->seq->size;
+            spsc_push(p->pieces, piece);
+        }
+    }
+    spsc_push(p->pieces, NULL);
+    return NULL;
+}
+
+fasta_pipeline_t *new_fasta_pipeline(FILE *fp, int piece_size)
+{
+    fasta_pipeline_t *p = (fasta_pipeline_t *) malloc(sizeof(fasta_pipeline_t));
+    p->fp = fp;
+    p->piece_size = piece_size;
+    p->current = NULL;
+    p->eof = 0;
+    p->done = 0;
+    p->free_blocks = new_spsc_queue(2);
+    p->full_blocks = new_spsc_queue(2);
+    p->pieces = new_spsc_queue(PIPELINE_PIECES);
+    int i;
+    for (i = 0; i < 2; i++)
+    {
+        p->blocks[i].data = (char *) malloc(PIPELINE_BLOCK_SIZE);
+        p->blocks[i].size = 0;
+        spsc_push(p->free_blocks, &p->blocks[i]);
+    }
+
+    // the encoder parses the blocks in place
+    p->reader = new_fasta_reader(fp);
+    free(p->reader->buffer);
+    p->reader->buffer = NULL;
+    p->reader->fill = fill_from_blocks;
+    p->reader->source = p;
+
+    if (pthread_create(&p->reader_thread, NULL, reader_stage, p) != 0)
+        ERROR("can not create thread");
+    if (pthread_create(&p->encoder_thread, NULL, encoder_stage, p) != 0)
+        ERROR("can not create thread");
+    return p;
+}
+
+void free_fasta_pipeline(fasta_pipeline_t *p)
+{
+    fasta_piece_t *piece;
+    while ((piece = fasta_pipeline_next_piece(p)) != NULL)
+        free_fasta_piece(piece);
+    pthread_join(p->encoder_thread, NULL);
+    pthread_join(p->reader_thread, NULL);
+    free_fasta_reader(p->reader);
+    free(p->blocks[0].data);
+    free(p->blocks[1].data);
+    free_spsc_queue(p->free_blocks);
+    free_spsc_queue(p->full_blocks);
+    free_spsc_queue(p->pieces);
+    free(p);
+}
+
+fasta_piece_t *fasta_pipeline_next_piece(fasta_pipeline_t *p)
+{
+    if (p->done)
+        return NULL;
+    fasta_piece_t *piece = (fasta_piece_t *) spsc_pop(p->pieces);
+    if (piece == NULL)
+        p->done = 1;
+    return piece;
+}
+
+void free_fasta_piece(fasta_piece_t *piece)
+{
+    free_seq(piece->seq);
+    free(piece);
+}
+
+seq_t *fasta_pipeline_next(fasta_pipeline_t *p)
+{
+    fasta_piece_t *piece = fasta_pipeline_next_piece(p);
+    if (piece == NULL)
+        return NULL;
+    seq_t *seq = piece->seq;
+    int last = piece->last;
+    free(piece);
+    while (!last)
+    {
+        piece = fasta_pipeline_next_piece(p);
+        if (seq->size + piece->seq->size > seq->msize)
+        {
+            seq->msize = MAX(2 * seq->msize, seq->size + piece->seq->size);
+            seq->data = (char *) realloc(seq->data, sizeof(char) * seq->msize);
+        }
+        memcpy(seq->data + seq->size, piece->seq->data, piece->seq->size);
+        seq->size += piece->seq->size;
+        last = piece->last;
+        free_fasta_piece(piece);
+    }
+    return seq;
+}
+
+int is_seekable(FILE *fp)
+{
+    struct stat st;
+    return fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode);
+}
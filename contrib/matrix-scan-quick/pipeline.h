@@ -0,0 +1,108 @@
+/***************************************************************************
+ *                                                                         *
+ *  pipeline.h
+ *  staged reading of non-seekable input (pipes, compressed files)
+ *
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __PIPELINE__
+#define __PIPELINE__
+
+#include <pthread.h>
+
+#include "seq.h"
+#include "cfasta.h"
+#include "utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Single producer / single consumer queue: a ring of pointers where only
+  the producer moves the tail and only the consumer moves the head, so
+  no lock is needed. A full (or empty) queue makes the producer (or the
+  consumer) spin, then sleep.
+*/
+typedef struct
+{
+    void **items;
+    long capacity;
+    long head;          // next item to pop (consumer)
+    long tail;          // next item to push (producer)
+} spsc_queue_t;
+
+spsc_queue_t *new_spsc_queue(long capacity);
+
+void free_spsc_queue(spsc_queue_t *q);
+
+void spsc_push(spsc_queue_t *q, void *item);
+
+void *spsc_pop(spsc_queue_t *q);
+
+/*
+  The input is read, parsed and scanned by three stages connected by
+  queues:
+
+  - the reader thread reads large blocks of the input into a pair of
+    buffers (double buffering), one being filled while the other is parsed
+  - the encoder thread splits the blocks in records and encodes them in
+    pieces of at most piece_size residues
+  - the caller gets the pieces (fasta_pipeline_next_piece), so that a
+    long record is scanned while the end of it is still read, or whole
+    records (fasta_pipeline_next)
+*/
+// residues per piece (at least)
+#define PIPELINE_PIECE_SIZE (1 << 20)
+
+typedef struct
+{
+    seq_t *seq;         // residues of the piece, seq->name is the name of the record
+    long position;      // position of the first residue in the record
+    int last;           // 1 for the last piece of the record
+} fasta_piece_t;
+
+typedef struct
+{
+    char *data;
+    int size;           // 0 at the end of the input
+} fasta_block_t;
+
+typedef struct
+{
+    FILE *fp;
+    int piece_size;
+    fasta_block_t blocks[2];
+    fasta_block_t *current;     // block parsed by the encoder
+    int eof;
+    spsc_queue_t *free_blocks;  // encoder -> reader
+    spsc_queue_t *full_blocks;  // reader -> encoder
+    spsc_queue_t *pieces;       // encoder -> caller
+    fasta_reader_t *reader;
+    int done;                   // 1 once the last piece was returned
+    pthread_t reader_thread;
+    pthread_t encoder_thread;
+} fasta_pipeline_t;
+
+fasta_pipeline_t *new_fasta_pipeline(FILE *fp, int piece_size);
+
+// read the whole input and free the pipeline
+void free_fasta_pipeline(fasta_pipeline_t *pipeline);
+
+// next piece, NULL at the end of the input
+fasta_piece_t *fasta_pipeline_next_piece(fasta_pipeline_t *pipeline);
+
+void free_fasta_piece(fasta_piece_t *piece);
+
+// next whole record, NULL at the end of the input
+seq_t *fasta_pipeline_next(fasta_pipeline_t *pipeline);
+
+// 1 if fp can be rewound (regular file)
+int is_seekable(FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
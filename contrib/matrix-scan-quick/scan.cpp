@@ -1,5 +1,51 @@
+#include <pthread.h>
+
 #include "scan.h"
 
+// words per block of the background tracks
+#define BG_TRACK_BLOCK 4096
+
+// scanning parameters shared by all the chunks of a sequence
+typedef struct
+{
+    seq_t *seq;
+    seq_t *seqrc;
+    Array *matrix;
+    markov_t *bg;
+    double threshold;
+    pvalues_t *pvalues;
+    int origin;
+    int offset;
+    char *matrix_name;
+    int first_hit;
+    int best_hit;
+    crer_t *crer;
+    markov_window_t *window_bg;
+} scan_args_t;
+
+// a site (best hit of a sequence or of a chunk)
+typedef struct
+{
+    double W;
+    double Pval;
+    int a;
+    int b;
+    char strand;
+    char site[256];
+} hit_t;
+
+// per-sequence summary of the hits (-return seq_stats)
+typedef struct
+{
+    int hits;
+    double max_W;
+    char max_strand;
+    int max_a;
+    int max_b;
+    double sum_Pval;
+    double min_Pval;
+} stats_t;
+
 static inline
 int word_is_valid(seq_t *seq, int start, int l)
 {
@@ -24,175 +70,826 @@ void set_buffer(char *buffer, char *seq, int i, int l)
     }
 }
 
-int scan_seq(FILE *fout,         // output file
-	     seq_t *seq,         // sequence to scan
-	     int s,              
-	     Array &matrix,      // position-specific scoring matrix
-	     Markov &bg,         // background model
-	     values_t *values,   
-	     double threshold,   // shreshold on either weight score or P-value
-	     int rc,             // if 1, also scan reverse complementary sequence
-	     pvalues_t *pvalues, 
-	     int origin,         // reference for the position 0
-	     int offset,         // offset added to each position
-	     char *matrix_name,  // name of the position-specific scoring matrix, printed in 3rd column
-	     int *scanned_pos,    
-	     int first_hit,      // if 1, only print the first hit per sequence
-	     int best_hit        // if 1, only print the best hit per sequence
-	     )
+static
+void print_hit(FILE *fout, char *seq_name, char *matrix_name, char strand, int a, int b,
+               char *site, double W, double Pval, pvalues_t *pvalues)
+{
+    fprintf(fout, "%s\t%s\t%s\t%c\t%d\t%d\t%s\t%G", seq_name, "site", matrix_name, strand, a, b, site, W);
+    if (pvalues != NULL)
+        fprintf(fout, "\t%G", Pval);
+    fprintf(fout, "\n");
+}
+
+// keep hit if it is strictly better than best (ties keep the first one)
+static
+void update_best(hit_t *best, char strand, int a, int b, char *site, double W, double Pval)
+{
+    if (W > best->W)
+    {
+        best->W = W;
+        best->a = a;
+        best->b = b;
+        best->strand = strand;
+        strcpy(best->site, site);
+        best->Pval = Pval;
+    }
+}
+
+static
+void init_stats(stats_t *stats)
+{
+    stats->hits = 0;
+    stats->max_W = 0;
+    stats->max_strand = '.';
+    stats->max_a = 0;
+    stats->max_b = 0;
+    stats->sum_Pval = 0;
+    stats->min_Pval = 1;
+}
+
+// add a hit, or the stats of a later chunk of the same sequence
+static
+void merge_stats(stats_t *stats, stats_t *other)
+{
+    if (other->hits > 0 && (stats->hits == 0 || other->max_W > stats->max_W))
+    {
+        stats->max_W = other->max_W;
+        stats->max_strand = other->max_strand;
+        stats->max_a = other->max_a;
+        stats->max_b = other->max_b;
+    }
+    stats->hits += other->hits;
+    stats->sum_Pval += other->sum_Pval;
+    stats->min_Pval = MIN(stats->min_Pval, other->min_Pval);
+}
+
+static
+void add_stats(stats_t *stats, char strand, int a, int b, double W, double Pval)
+{
+    stats_t hit;
+    hit.hits = 1;
+    hit.max_W = W;
+    hit.max_strand = strand;
+    hit.max_a = a;
+    hit.max_b = b;
+    hit.sum_Pval = Pval;
+    hit.min_Pval = Pval;
+    merge_stats(stats, &hit);
+}
+
+static
+void print_stats(FILE *fout, char *seq_name, char *matrix_name, int scanned, stats_t *stats, pvalues_t *pvalues)
+{
+    fprintf(fout, "%s\t%s\t%d\t%d", seq_name, matrix_name, scanned, stats->hits);
+    if (stats->hits > 0)
+        fprintf(fout, "\t%G\t%c\t%d\t%d", stats->max_W, stats->max_strand, stats->max_a, stats->max_b);
+    else
+        fprintf(fout, "\tNA\t.\tNA\tNA");
+    if (pvalues != NULL)
+    {
+        if (stats->hits > 0)
+            fprintf(fout, "\t%G\t%G", stats->sum_Pval, stats->min_Pval);
+        else
+            fprintf(fout, "\t0\tNA");
+    }
+    fprintf(fout, "\n");
+}
+
+/*
+  scan the words starting at positions [from, to) of the sequence
+  the words may extend up to to + l - 1, so consecutive ranges overlap by l - 1
+  returns 1 if the scan stopped on a first hit
+*/
+static
+int scan_range(scan_args_t *args, FILE *fout, values_t *values, stats_t *stats, pos_hist_t *hist, int from, int to, int *scanned_pos, hit_t *best)
 {
+    seq_t *seq = args->seq;
+    seq_t *seqrc = args->seqrc;
+    Array &matrix = *args->matrix;
+    markov_t &bg = *args->bg;
+    pvalues_t *pvalues = args->pvalues;
+    double threshold = args->threshold;
     char buffer[256];
-    char bestBuffer[256] =".";
     int l = matrix.J;
-    ASSERT(l < 256, "invalid matrix size");
     int a = 0;
     int b = 0;
-    seq_t *seqrc = NULL;
 
-    // Best values for option -best_hit_per_seq
-    double bestW = -1000000; // Best weight score for current sequence
-    double bestPval = 1;
-    int bestA = 0;
-    int bestB = 0;
-    char bestS = '.';
-    //    char *bestWline;            // line to print for the best score of the current sequence
-      
-    if (rc)
-        seqrc = new_seq_rc(seq);
+    // local background (-window), slid along the range
+    markov_window_t *local = NULL;
+    if (args->window_bg != NULL)
+        local = new_markov_window(args->window_bg->order, args->window_bg->width, args->window_bg->pseudo);
 
     int maxpos = seq->size - l;
+
+    // words scanned by blocks; global background of order > 0 from rolling tracks of both strands, per block
+    int track = local == NULL && bg.order > 0 && l > bg.order;
+    int block;
+    int block_end;
+    int track_size = MIN(BG_TRACK_BLOCK, to - from) + l;
+    double *logS = NULL;
+    double *logT = NULL;
+    double *logS_rc = NULL;
+    double *logT_rc = NULL;
+    if (track)
+    {
+        logS = (double *) malloc(sizeof(double) * track_size);
+        logT = (double *) malloc(sizeof(double) * track_size);
+        if (seqrc != NULL)
+        {
+            logS_rc = (double *) malloc(sizeof(double) * track_size);
+            logT_rc = (double *) malloc(sizeof(double) * track_size);
+        }
+    }
+
+    int hit = 0;
     int i;
-    for (i = 0; i <= maxpos; i++)
+    for (block = from; block < to && !hit; block = block_end)
     {
-        if (!word_is_valid(seq, i, l))
-            continue;
-        double W;
-        if (bg.order == 0)
-            W = matrix.logP(&seq->data[i]) - bg.logPBernoulli(&seq->data[i], l);
-        else
-            W = matrix.logP(&seq->data[i]) - bg.logP(&seq->data[i], l);
+        block_end = MIN(block + BG_TRACK_BLOCK, to);
+        if (track)
+        {
+            int n = block_end - block + l - 1;
+            markov_track(&bg, seq->data + block, n, logS, logT);
+            if (seqrc != NULL)
+                markov_track(&bg, seqrc->data + maxpos - block_end + 1, n, logS_rc, logT_rc);
+        }
+        for (i = block; i < block_end && !hit; i++)
+        {
+            if (!word_is_valid(seq, i, l))
+                continue;
+            double W;
+            if (local != NULL)
+            {
+                markov_window_move(local, seq->data, seq->size, i, l);
+                W = matrix.logP(&seq->data[i]) - markov_window_logP(local, &seq->data[i], l);
+            }
+            else if (bg.order == 0)
+                W = matrix.logP(&seq->data[i]) - markov_bernoulli_logP(&bg, &seq->data[i], l);
+            else if (track)
+                W = matrix.logP(&seq->data[i]) - markov_track_logP(&bg, logS, logT, i - block, l);
+            else
+                W = matrix.logP(&seq->data[i]) - markov_logP(&bg, &seq->data[i], l);
 
-	
-        // position
-        if (origin == -1) // start
-            a = i + 1;
-        else if (origin == 0) // center
-            a = i - seq->size / 2;
-        else // end
-            a = i - seq->size;
+            // position
+            if (args->origin == -1) // start
+                a = i + 1;
+            else if (args->origin == 0) // center
+                a = i - seq->size / 2;
+            else // end
+                a = i - seq->size;
 
-        a = a - offset;
-        b = a + l - 1;
+            a = a - args->offset;
+            b = a + l - 1;
 
-        (*scanned_pos) += 1;
+            (*scanned_pos) += 1;
 
-        double Pval = score2pvalue(pvalues, W);
-        if ((pvalues == NULL && W >= threshold) || (pvalues != NULL && Pval <= threshold))
-        {
-            if (values != NULL)
+            double Pval = score2pvalue(pvalues, W);
+            if ((pvalues == NULL && W >= threshold) || (pvalues != NULL && Pval <= threshold))
             {
-                values_add(values, W);
+                if (values != NULL)
+                {
+                    values_add(values, W);
+                }
+                else if (stats != NULL)
+                {
+                    add_stats(stats, 'D', a, b, W, Pval);
+                }
+                else if (hist != NULL)
+                {
+                    pos_hist_add(hist, a, b, 'D');
+                }
+                else if (args->crer != NULL)
+                {
+                    crer_add(args->crer, a, b, Pval, W);
+                }
+                else
+                {
+                    set_buffer(buffer, seq->data, i, l);
+
+                    // Store best hit if option -best_hit_per_seq has been activated
+                    if (args->best_hit)
+                        update_best(best, 'D', a, b, buffer, W, Pval);
+                    else
+                        print_hit(fout, seq->name, args->matrix_name, 'D', a, b, buffer, W, Pval, pvalues);
+                }
+
+                if (args->first_hit)
+                {
+                    hit = 1;
+                    break;
+                }
             }
+
+            if (seqrc == NULL)
+                continue;
+
+            double Wrc;
+            if (local != NULL)
+                Wrc = matrix.logP(&seqrc->data[maxpos - i]) - markov_window_logP(local, &seqrc->data[maxpos - i], l);
+            else if (bg.order == 0)
+                Wrc = matrix.logP(&seqrc->data[maxpos - i]) - markov_bernoulli_logP(&bg, &seqrc->data[maxpos - i], l);
+            else if (track)
+                Wrc = matrix.logP(&seqrc->data[maxpos - i]) - markov_track_logP(&bg, logS_rc, logT_rc, block_end - 1 - i, l);
             else
+                Wrc = matrix.logP(&seqrc->data[maxpos - i]) - markov_logP(&bg, &seqrc->data[maxpos - i], l);
+
+            double Pval_rc = score2pvalue(pvalues, Wrc);
+            if ((pvalues == NULL && Wrc >= threshold) || (pvalues != NULL && Pval_rc <= threshold))
             {
-                //const char *seqstr = "?";
-                set_buffer(buffer, seq->data, i, l);
-
-		// Store best hit if option -best_hit_per_seq has been activated
-		if (best_hit)
-		{
-		  if (W > bestW) {
-		    bestW = W;
-		    bestA = a;
-		    bestB = b;
-		    bestS = 'D';
-		    strcpy(bestBuffer, buffer);
-		    if (pvalues != NULL)
-		      bestPval = Pval;
-
-		    // snprintf(bestWline, "%s\t%s\t%s\t%c\t%d\t%d\t%s\t%G", seq->name, "site", matrix_name, 'D', a, b, buffer, W);
-		    // if (pvalues != NULL)
-		    //   snprintf(bestWline, "\t%G", Pval);
-		    // snprintf(bestWline, "\n");
-		  }
-
-		// print current hit
-		} else
-		{
-                  fprintf(fout, "%s\t%s\t%s\t%c\t%d\t%d\t%s\t%G", seq->name, "site", matrix_name, 'D', a, b, buffer, W);
-                  if (pvalues != NULL)
-                    fprintf(fout, "\t%G", Pval);
-                  fprintf(fout, "\n");
-		}
+                if (values != NULL)
+                {
+                    values_add(values, Wrc);
+                }
+                else if (stats != NULL)
+                {
+                    add_stats(stats, 'R', a, b, Wrc, Pval_rc);
+                }
+                else if (hist != NULL)
+                {
+                    pos_hist_add(hist, a, b, 'R');
+                }
+                else if (args->crer != NULL)
+                {
+                    crer_add(args->crer, a, b, Pval_rc, Wrc);
+                }
+                else
+                {
+                    set_buffer(buffer, seqrc->data, seq->size - i - l, l);
+
+                    if (args->best_hit)
+                        update_best(best, 'R', a, b, buffer, Wrc, Pval_rc);
+                    else
+                        print_hit(fout, seq->name, args->matrix_name, 'R', a, b, buffer, Wrc, Pval_rc, pvalues);
+                }
+
+                if (args->first_hit)
+                    hit = 1;
             }
+        }
+    }
+    if (local != NULL)
+        free_markov_window(local);
+    free(logS);
+    free(logT);
+    free(logS_rc);
+    free(logT_rc);
+    return hit;
+}
+
+/*
+  Chunked scan of long sequences: the start positions are cut in chunks
+  scanned by a pool of threads. Each chunk prints its hits in memory and
+  the calling thread writes them back in sequence order, so the output
+  is the same as the one of the sequential scan. Threads may only run
+  window chunks ahead of the output to bound the memory.
+*/
+typedef struct
+{
+    char *text;         // hits printed by the chunk
+    size_t size;
+    values_t *values;
+    pos_hist_t *hist;
+    int scanned_pos;
+    int hit;            // 1 if the chunk stopped on a first hit
+    int done;
+    hit_t best;
+    stats_t stats;
+} chunk_t;
+
+typedef struct
+{
+    scan_args_t *args;
+    values_t *values;
+    stats_t *stats;
+    pos_hist_t *hist;
+    chunk_t *chunks;
+    int nchunks;
+    int chunk;          // start positions per chunk
+    int npos;           // start positions in the sequence
+    int next;           // next chunk to scan
+    int written;        // chunks already written
+    int window;
+    int stop;           // first chunk with a hit (-first_hit_per_seq)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} chunk_queue_t;
 
-            if (first_hit)
-                break;
+static
+void init_hit(hit_t *hit)
+{
+    hit->W = -1000000;
+    hit->Pval = 1;
+    hit->a = 0;
+    hit->b = 0;
+    hit->strand = '.';
+    strcpy(hit->site, ".");
+}
+
+static
+void *chunk_worker(void *arg)
+{
+    chunk_queue_t *q = (chunk_queue_t *) arg;
+    while (1)
+    {
+        pthread_mutex_lock(&q->lock);
+        while (q->next < q->nchunks && q->next <= q->stop && q->next >= q->written + q->window)
+            pthread_cond_wait(&q->cond, &q->lock);
+        int c = q->next;
+        if (c >= q->nchunks || c > q->stop)
+        {
+            pthread_mutex_unlock(&q->lock);
+            return NULL;
         }
+        q->next++;
+        pthread_mutex_unlock(&q->lock);
 
-        if (!rc)
-            continue;
+        chunk_t *k = &q->chunks[c];
+        FILE *out = open_memstream(&k->text, &k->size);
+        ASSERT(out != NULL, "can not allocate chunk output");
+        if (q->values != NULL)
+            k->values = new_values(q->values->min, q->values->max, q->values->e);
+        if (q->hist != NULL)
+            k->hist = new_pos_hist(q->hist->bin);
+        int from = c * q->chunk;
+        int to = MIN(from + q->chunk, q->npos);
+        k->hit = scan_range(q->args, out, k->values, q->stats == NULL ? NULL : &k->stats, k->hist, from, to, &k->scanned_pos, &k->best);
+        fclose(out);
 
-        double Wrc;
-        if (bg.order == 0)
-            Wrc = matrix.logP(&seqrc->data[maxpos - i]) - bg.logPBernoulli(&seqrc->data[maxpos - i], l);
-        else
-            Wrc = matrix.logP(&seqrc->data[maxpos - i]) - bg.logP(&seqrc->data[maxpos - i], l);
+        pthread_mutex_lock(&q->lock);
+        k->done = 1;
+        if (k->hit && c < q->stop)
+            q->stop = c;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->lock);
+    }
+}
+
+// returns 1 if the scan stopped on a first hit
+static
+int scan_chunks(scan_args_t *args, FILE *fout, values_t *values, stats_t *stats, pos_hist_t *hist, int *scanned_pos, hit_t *best,
+                int nthreads, int chunk)
+{
+    chunk_queue_t q;
+    int npos = args->seq->size - args->matrix->J + 1;
+    int c;
+
+    q.args = args;
+    q.values = values;
+    q.stats = stats;
+    q.hist = hist;
+    q.chunk = chunk;
+    q.npos = npos;
+    q.nchunks = (npos + chunk - 1) / chunk;
+    q.chunks = (chunk_t *) malloc(sizeof(chunk_t) * q.nchunks);
+    ASSERT(q.chunks != NULL, "can not allocate chunks");
+    for (c = 0; c < q.nchunks; c++)
+    {
+        q.chunks[c].text = NULL;
+        q.chunks[c].values = NULL;
+        q.chunks[c].hist = NULL;
+        q.chunks[c].scanned_pos = 0;
+        q.chunks[c].hit = 0;
+        q.chunks[c].done = 0;
+        init_hit(&q.chunks[c].best);
+        init_stats(&q.chunks[c].stats);
+    }
+    q.next = 0;
+    q.written = 0;
+    q.window = 2 * nthreads;
+    q.stop = q.nchunks;
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.cond, NULL);
+
+    nthreads = MIN(nthreads, q.nchunks);
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * nthreads);
+    for (c = 0; c < nthreads; c++)
+    {
+        if (pthread_create(&threads[c], NULL, chunk_worker, &q) != 0)
+            ERROR("can not create thread");
+    }
+
+    // write the chunks in order, up to the first one with a hit
+    for (c = 0; ; c++)
+    {
+        pthread_mutex_lock(&q.lock);
+        while (c < q.nchunks && c <= q.stop && !q.chunks[c].done)
+            pthread_cond_wait(&q.cond, &q.lock);
+        int last = c >= q.nchunks || c > q.stop;
+        pthread_mutex_unlock(&q.lock);
+        if (last)
+            break;
+
+        chunk_t *k = &q.chunks[c];
+        fwrite(k->text, 1, k->size, fout);
+        free(k->text);
+        k->text = NULL;
+        if (values != NULL)
+        {
+            values_merge(values, k->values);
+            free_values(k->values);
+            k->values = NULL;
+        }
+        if (hist != NULL)
+        {
+            pos_hist_merge(hist, k->hist);
+            free_pos_hist(k->hist);
+            k->hist = NULL;
+        }
+        (*scanned_pos) += k->scanned_pos;
+        if (k->best.strand != '.')
+            update_best(best, k->best.strand, k->best.a, k->best.b, k->best.site, k->best.W, k->best.Pval);
+        if (stats != NULL)
+            merge_stats(stats, &k->stats);
+
+        pthread_mutex_lock(&q.lock);
+        q.written = c + 1;
+        pthread_cond_broadcast(&q.cond);
+        pthread_mutex_unlock(&q.lock);
+    }
+
+    for (c = 0; c < nthreads; c++)
+        pthread_join(threads[c], NULL);
+    free(threads);
+
+    // chunks scanned after the first hit
+    for (c = 0; c < q.nchunks; c++)
+    {
+        free(q.chunks[c].text);
+        if (q.chunks[c].values != NULL)
+            free_values(q.chunks[c].values);
+        if (q.chunks[c].hist != NULL)
+            free_pos_hist(q.chunks[c].hist);
+    }
+    free(q.chunks);
+    pthread_mutex_destroy(&q.lock);
+    pthread_cond_destroy(&q.cond);
+    return q.stop < q.nchunks;
+}
+
+/*
+  Streamed scan: the sequence is given by pieces, each one scanned when
+  it is received. The last l - 1 residues of a piece are kept to scan
+  the words that overlap the next one, and the positions are shifted by
+  the position of the piece in the sequence.
+*/
+struct scan_stream
+{
+    scan_args_t args;
+    FILE *fout;
+    values_t *values;
+    int seq_stats;
+    pos_hist_t *hist;
+    int *scanned_pos;
+    int scanned_before;
+    hit_t best;         // -best_hit_per_seq
+    stats_t stats;      // -return seq_stats
+    seq_t *tail;        // end of the previous piece, then the words overlapping the next one
+    int rc;
+    int offset;
+    int hit;            // 1 once the first hit was found (-first_hit_per_seq)
+    int nthreads;
+    int chunk;
+};
+
+scan_stream_t *scan_stream_begin(FILE *fout, char *seq_name, Array &matrix, markov_t &bg, values_t *values,
+                                 double threshold, int rc, pvalues_t *pvalues, int origin, int offset, char *matrix_name,
+                                 int *scanned_pos, int first_hit, int best_hit, int seq_stats, pos_hist_t *hist,
+                                 crer_t *crer, markov_window_t *window_bg, int nthreads, int chunk)
+{
+    int l = matrix.J;
+    ASSERT(l < 256, "invalid matrix size");
+    scan_stream_t *stream = new scan_stream_t;
+    scan_args_t &args = stream->args;
+
+    args.seq = NULL;
+    args.seqrc = NULL;
+    args.matrix = &matrix;
+    args.bg = &bg;
+    args.threshold = threshold;
+    args.pvalues = pvalues;
+    args.origin = origin;
+    args.offset = offset;
+    args.matrix_name = matrix_name;
+    args.first_hit = first_hit;
+    args.best_hit = best_hit;
+    args.crer = crer;
+    args.window_bg = window_bg;
+
+    stream->fout = fout;
+    stream->values = values;
+    stream->seq_stats = seq_stats;
+    stream->hist = hist;
+    stream->scanned_pos = scanned_pos;
+    stream->scanned_before = *scanned_pos;
+    init_hit(&stream->best);
+    init_stats(&stream->stats);
+    stream->tail = new_seq(l);
+    strcpy(stream->tail->name, seq_name);
+    stream->rc = rc;
+    stream->offset = offset;
+    stream->hit = 0;
+    stream->nthreads = nthreads;
+    stream->chunk = chunk;
+
+    // the regions need the hits in sequence order
+    if (crer != NULL)
+        crer_begin(crer, fout, stream->tail->name);
+    return stream;
+}
+void scan_stream_add(scan_stream_t *stream, seq_t *piece, long position)
+{
+    scan_args_t &args = stream->args;
+    seq_t *tail = stream->tail;
+    int l = args.matrix->J;
+    ASSERT(position == 0 || (args.origin == -1 && args.window_bg == NULL),
+           "sequence pieces can only be scanned from the start without local background");
+    if (stream->hit)
+        return;
+
+    // the words overlapping the previous piece are scanned with this one
+    seq_t *seq = piece;
+    if (tail->size > 0)
+    {
+        if (tail->size + piece->size > tail->msize)
+        {
+            tail->msize = tail->size + piece->size;
+            tail->data = (char *) realloc(tail->data, sizeof(char) * tail->msize);
+        }
+        memcpy(tail->data + tail->size, piece->data, piece->size);
+        tail->size += piece->size;
+        seq = tail;
+    }
+    long start = position + piece->size - seq->size;
+
+    args.seq = seq;
+    args.offset = stream->offset - (int) start;
+    if (stream->rc)
+        args.seqrc = new_seq_rc(seq);
+
+    int npos = seq->size - l + 1;
+    stats_t *stats = stream->seq_stats ? &stream->stats : NULL;
+    if (npos <= 0)
+        ;
+    else if (stream->nthreads > 1 && npos > stream->chunk && args.crer == NULL)
+        stream->hit = scan_chunks(&args, stream->fout, stream->values, stats, stream->hist, stream->scanned_pos, &stream->best,
+                                  stream->nthreads, stream->chunk);
+    else
+        stream->hit = scan_range(&args, stream->fout, stream->values, stats, stream->hist, 0, npos, stream->scanned_pos, &stream->best);
+
+    if (stream->rc)
+        free_seq(args.seqrc);
+    args.seqrc = NULL;
+
+    // keep the last l - 1 residues
+    int keep = MIN(l - 1, seq->size);
+    memmove(tail->data, seq->data + seq->size - keep, keep);
+    tail->size = keep;
+}
+
+void scan_stream_end(scan_stream_t *stream)
+{
+    scan_args_t &args = stream->args;
+    char *seq_name = stream->tail->name;
+    if (args.crer != NULL)
+        crer_end(args.crer);
+    else if (stream->seq_stats)
+        print_stats(stream->fout, seq_name, args.matrix_name, *stream->scanned_pos - stream->scanned_before, &stream->stats, args.pvalues);
+    else if (args.best_hit)
+        print_hit(stream->fout, seq_name, args.matrix_name, stream->best.strand, stream->best.a, stream->best.b,
+                  stream->best.site, stream->best.W, stream->best.Pval, args.pvalues);
+    free_seq(stream->tail);
+    delete stream;
+}
+
+int scan_seq(FILE *fout,         // output file
+	     seq_t *seq,         // sequence to scan
+	     int s,
+	     Array &matrix,      // position-specific scoring matrix
+	     markov_t &bg,         // background model
+	     values_t *values,
+	     double threshold,   // shreshold on either weight score or P-value
+	     int rc,             // if 1, also scan reverse complementary sequence
+	     pvalues_t *pvalues,
+	     int origin,         // reference for the position 0
+	     int offset,         // offset added to each position
+	     char *matrix_name,  // name of the position-specific scoring matrix, printed in 3rd column
+	     int *scanned_pos,
+	     int first_hit,      // if 1, only print the first hit per sequence
+	     int best_hit,       // if 1, only print the best hit per sequence
+	     int seq_stats,      // if 1, only print the summary of the hits of the sequence
+	     pos_hist_t *hist,   // if not NULL, only count the sites per position bin
+	     crer_t *crer,       // if not NULL, only print the enriched regions (CRER)
+	     markov_window_t *window_bg, // if not NULL, local background model (parameters only)
+	     int nthreads,       // number of threads for sequences longer than chunk
+	     int chunk           // number of positions scanned per thread at once
+	     )
+{
+    scan_stream_t *stream = scan_stream_begin(fout, seq->name, matrix, bg, values, threshold, rc, pvalues, origin, offset, matrix_name,
+                                              scanned_pos, first_hit, best_hit, seq_stats, hist, crer, window_bg, nthreads, chunk);
+    scan_stream_add(stream, seq, 0);
+    scan_stream_end(stream);
+    return 1;
+}
 
-        double Pval_rc = score2pvalue(pvalues, Wrc);
-        if ((pvalues == NULL && Wrc >= threshold) || (pvalues != NULL && Pval_rc <= threshold))
+/*
+  -perm: add the scores of the words starting at [from, to) with all the
+  matrices, the background probability of a word (from the rolling tracks
+  for order > 0) being shared by all of them
+*/
+static
+void scan_range_perm(seq_t *seq, seq_t *seqrc, Array **matrices, int nmatrices, markov_t &bg, values_t **values,
+                     double threshold, int from, int to, int *scanned_pos)
+{
+    int l = matrices[0]->J;
+    int maxpos = seq->size - l;
+
+    int track = bg.order > 0 && l > bg.order;
+    int block;
+    int block_end;
+    int track_size = MIN(BG_TRACK_BLOCK, to - from) + l;
+    double *logS = NULL;
+    double *logT = NULL;
+    double *logS_rc = NULL;
+    double *logT_rc = NULL;
+    if (track)
+    {
+        logS = (double *) malloc(sizeof(double) * track_size);
+        logT = (double *) malloc(sizeof(double) * track_size);
+        if (seqrc != NULL)
         {
-            if (values != NULL)
+            logS_rc = (double *) malloc(sizeof(double) * track_size);
+            logT_rc = (double *) malloc(sizeof(double) * track_size);
+        }
+    }
+
+    int i, k;
+    for (block = from; block < to; block = block_end)
+    {
+        block_end = MIN(block + BG_TRACK_BLOCK, to);
+        if (track)
+        {
+            int n = block_end - block + l - 1;
+            markov_track(&bg, seq->data + block, n, logS, logT);
+            if (seqrc != NULL)
+                markov_track(&bg, seqrc->data + maxpos - block_end + 1, n, logS_rc, logT_rc);
+        }
+        for (i = block; i < block_end; i++)
+        {
+            if (!word_is_valid(seq, i, l))
+                continue;
+
+            char *word = &seq->data[i];
+            double B;
+            if (bg.order == 0)
+                B = markov_bernoulli_logP(&bg, word, l);
+            else if (track)
+                B = markov_track_logP(&bg, logS, logT, i - block, l);
+            else
+                B = markov_logP(&bg, word, l);
+
+            (*scanned_pos) += 1;
+
+            for (k = 0; k < nmatrices; k++)
             {
-                values_add(values, Wrc);
+                double W = matrices[k]->logP(word) - B;
+                if (W >= threshold)
+                    values_add(values[k], W);
             }
+
+            if (seqrc == NULL)
+                continue;
+
+            word = &seqrc->data[maxpos - i];
+            if (bg.order == 0)
+                B = markov_bernoulli_logP(&bg, word, l);
+            else if (track)
+                B = markov_track_logP(&bg, logS_rc, logT_rc, block_end - 1 - i, l);
             else
+                B = markov_logP(&bg, word, l);
+
+            for (k = 0; k < nmatrices; k++)
             {
-                //const char *seqrcstr = "?";
-                set_buffer(buffer, seqrc->data, seq->size - i - l, l);
-
-		if (best_hit)
-		{
-		  if (Wrc > bestW) {
-		    bestW = Wrc;
-		    bestA = a;
-		    bestB = b;
-		    bestS = 'R';
-		    strcpy(bestBuffer, buffer);
-		    if (pvalues != NULL)
-		      bestPval = Pval_rc;
-		    
-		    // snprintf(bestWline, "%s\t%s\t%s\t%c\t%d\t%d\t%s\t%G", seq->name, "site", matrix_name, 'R', a, b, buffer, Wrc);
-		    // if (pvalues != NULL)
-		    //   snprintf(bestWline, "\t%G", Pval_rc);
-		    // snprintf(bestWline, "\n");
-		  }
-		    
-		} else
-		{
-
-                  fprintf(fout, "%s\t%s\t%s\t%c\t%d\t%d\t%s\t%G", seq->name, "site", matrix_name, 'R', a, b, buffer, Wrc);
-                  if (pvalues != NULL)
-                      fprintf(fout, "\t%G", Pval_rc);
-                  fprintf(fout, "\n");
-		}
+                double Wrc = matrices[k]->logP(word) - B;
+                if (Wrc >= threshold)
+                    values_add(values[k], Wrc);
             }
-            
-            if (first_hit)
-                break;
         }
     }
-    
+    free(logS);
+    free(logT);
+    free(logS_rc);
+    free(logT_rc);
+}
+
+/*
+  Chunked -perm scan: the threads take the chunks in any order and count
+  the scores in their own tables, added to the distributions at the end
+  (the counts do not depend on the order of the chunks).
+*/
+typedef struct
+{
+    seq_t *seq;
+    seq_t *seqrc;
+    Array **matrices;
+    int nmatrices;
+    markov_t *bg;
+    values_t **values;
+    double threshold;
+    int *scanned_pos;
+    int chunk;
+    int npos;
+    int next;           // next chunk to scan
+    pthread_mutex_t lock;
+} perm_queue_t;
+
+static
+void *perm_worker(void *arg)
+{
+    perm_queue_t *q = (perm_queue_t *) arg;
+    values_t **values = new values_t*[q->nmatrices];
+    int k;
+    for (k = 0; k < q->nmatrices; k++)
+        values[k] = new_values(q->values[k]->min, q->values[k]->max, q->values[k]->e);
+    int scanned_pos = 0;
+
+    while (1)
+    {
+        pthread_mutex_lock(&q->lock);
+        int from = q->next;
+        q->next += q->chunk;
+        pthread_mutex_unlock(&q->lock);
+        if (from >= q->npos)
+            break;
+        int to = MIN(from + q->chunk, q->npos);
+        scan_range_perm(q->seq, q->seqrc, q->matrices, q->nmatrices, *q->bg, values, q->threshold, from, to, &scanned_pos);
+    }
+
+    pthread_mutex_lock(&q->lock);
+    for (k = 0; k < q->nmatrices; k++)
+    {
+        values_merge(q->values[k], values[k]);
+        free_values(values[k]);
+    }
+    (*q->scanned_pos) += scanned_pos;
+    pthread_mutex_unlock(&q->lock);
+    delete []values;
+    return NULL;
+}
+
+int scan_seq_perm(seq_t *seq,          // sequence to scan
+                  Array **matrices,    // matrices of the same width
+                  int nmatrices,
+                  markov_t &bg,          // background model
+                  values_t **values,   // score distribution of each matrix
+                  double threshold,    // only count scores >= threshold
+                  int rc,              // if 1, also scan reverse complementary sequence
+                  int *scanned_pos,
+                  int nthreads,        // number of threads for sequences longer than chunk
+                  int chunk            // number of positions scanned per thread at once
+                  )
+{
+    int npos = seq->size - matrices[0]->J + 1;
+    if (npos <= 0)
+        return 1;
+
+    seq_t *seqrc = NULL;
     if (rc)
-        free_seq(seqrc);
+        seqrc = new_seq_rc(seq);
 
-    if (best_hit)
+    if (nthreads > 1 && npos > chunk)
     {
-      fprintf(fout, "%s\t%s\t%s\t%c\t%d\t%d\t%s\t%G", seq->name, "site", matrix_name, bestS, bestA, bestB, bestBuffer, bestW);
-      if (pvalues != NULL)
-	fprintf(fout, "\t%G", bestPval);
-      fprintf(fout, "\n");
+        perm_queue_t q;
+        q.seq = seq;
+        q.seqrc = seqrc;
+        q.matrices = matrices;
+        q.nmatrices = nmatrices;
+        q.bg = &bg;
+        q.values = values;
+        q.threshold = threshold;
+        q.scanned_pos = scanned_pos;
+        q.chunk = chunk;
+        q.npos = npos;
+        q.next = 0;
+        pthread_mutex_init(&q.lock, NULL);
+
+        nthreads = MIN(nthreads, (npos + chunk - 1) / chunk);
+        pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * nthreads);
+        int c;
+        for (c = 0; c < nthreads; c++)
+        {
+            if (pthread_create(&threads[c], NULL, perm_worker, &q) != 0)
+                ERROR("can not create thread");
+        }
+        for (c = 0; c < nthreads; c++)
+            pthread_join(threads[c], NULL);
+        free(threads);
+        pthread_mutex_destroy(&q.lock);
     }
-    
+    else
+        scan_range_perm(seq, seqrc, matrices, nmatrices, bg, values, threshold, 0, npos, scanned_pos);
+
+    if (rc)
+        free_seq(seqrc);
+
     return 1;
 }
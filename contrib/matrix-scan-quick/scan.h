@@ -23,6 +23,7 @@ using namespace std;
 #include "seq.h"
 #include "dist.h"
 #include "pval.h"
+#include "crer.h"
 
 typedef struct
 {
@@ -31,7 +32,32 @@ typedef struct
 } options_t;
 
 // scan seq with matrix
-int scan_seq(FILE *fout, seq_t *seq, int s, Array &matrix, Markov &bg, values_t *values,
-	     double threshold, int rc, pvalues_t *pvalues, int origin, int offset, char *matrix_name, int *scanned_pos, int first_hit, int best_hit);
+// with seq_stats, print one summary line for the sequence instead of the sites
+// with hist, count the sites per position bin (relative to origin) instead of printing them
+// with crer, print the enriched regions of the sequence instead of the sites (hits are streamed, never stored)
+// with window_bg, score against a local background trained around each word instead of bg
+// sequences longer than chunk positions are cut in chunks scanned by nthreads threads (not with crer)
+int scan_seq(FILE *fout, seq_t *seq, int s, Array &matrix, markov_t &bg, values_t *values,
+	     double threshold, int rc, pvalues_t *pvalues, int origin, int offset, char *matrix_name, int *scanned_pos, int first_hit, int best_hit,
+	     int seq_stats, pos_hist_t *hist, crer_t *crer, markov_window_t *window_bg, int nthreads, int chunk);
+
+// same scan for a sequence received in pieces (a long record scanned while it is read):
+// each piece is scanned when added, position is the position of its first residue in the sequence.
+// Pieces after the first one need origin start (-1) and no window_bg.
+typedef struct scan_stream scan_stream_t;
+
+scan_stream_t *scan_stream_begin(FILE *fout, char *seq_name, Array &matrix, markov_t &bg, values_t *values,
+                                 double threshold, int rc, pvalues_t *pvalues, int origin, int offset, char *matrix_name,
+                                 int *scanned_pos, int first_hit, int best_hit, int seq_stats, pos_hist_t *hist,
+                                 crer_t *crer, markov_window_t *window_bg, int nthreads, int chunk);
+
+void scan_stream_add(scan_stream_t *stream, seq_t *piece, long position);
+
+// print the per-sequence results (best hit, stats, regions) and free the stream
+void scan_stream_end(scan_stream_t *stream);
+
+// add the scores of seq with each matrix to the corresponding values (single pass, used by -perm), in chunks with nthreads > 1
+int scan_seq_perm(seq_t *seq, Array **matrices, int nmatrices, markov_t &bg, values_t **values,
+                  double threshold, int rc, int *scanned_pos, int nthreads, int chunk);
 
 #endif
@@ -20,10 +20,7 @@ void free_seq(seq_t *seq)
 seq_t *new_seq_rc(seq_t *seq)
 {
     seq_t *rc = new_seq(seq->size);
-    int i;
-    for (i = 0; i < seq->size; i++)
-    {
-        rc->data[seq->size - i - 1] = 3 - seq->data[i];
-    }
+    dna_revcomp(seq->data, seq->size, rc->data);
+    rc->size = seq->size;
     return rc;
 }
@@ -10,6 +10,7 @@
 #define __SEQ__
 
 #include "utils.h"
+#include "dna.h"
 
 #ifdef __cplusplus 
 extern "C" {
@@ -33,41 +34,19 @@ void free_seq(seq_t *seq);
 // create a new reverse complement of seq
 seq_t *new_seq_rc(seq_t *seq);
 
+// append the code of c (see dna.h), nothing if c is not a residue
 static inline
 void seq_append_c(seq_t *seq, char c)
 {
+    char code = dna_code(c);
+    if (code == DNA_SKIP)
+        return;
     if (seq->size >= seq->msize)
     {
-        seq->msize += 8;
+        seq->msize = 2 * seq->msize + 8;
         seq->data = (char *) realloc(seq->data, sizeof(char) * seq->msize);
     }
-    switch (c)
-    {
-        case 'a':
-        case 'A':
-            seq->data[seq->size++] = 0;
-            break;
-
-        case 'c':
-        case 'C':
-            seq->data[seq->size++] = 1;
-            break;
-
-        case 'g':
-        case 'G':
-            seq->data[seq->size++] = 2;
-            break;
-
-        case 't':
-        case 'T':
-            seq->data[seq->size++] = 3;
-            break;
-
-        case 'n':
-        case 'N':
-            seq->data[seq->size++] = -1;
-            break;
-    }
+    seq->data[seq->size++] = code;
 }
 
 #ifdef __cplusplus
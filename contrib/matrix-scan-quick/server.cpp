@@ -0,0 +1,361 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <vector>
+
+#include "server.h"
+#include "cfasta.h"
+#include "zio.h"
+
+/*
+  resident data, loaded by the server before accepting requests and
+  shared (copy on write) with the children that run the scans
+*/
+typedef struct
+{
+    char *filename;
+    markov_t *bg;
+    matrix_db_t *matrices;  // all the matrices of the file (-m)
+    int matrix_format;
+    vector<seq_t *> seqs;
+} resident_t;
+
+static vector<resident_t *> RESIDENTS;
+
+// absolute file name, so that client and server agree on the names
+static
+char *absolute_path(const char *filename)
+{
+    if (filename[0] == '/')
+        return strdup(filename);
+    char cwd[4096];
+    ASSERT(getcwd(cwd, sizeof(cwd)) != NULL, "can not get current directory");
+    char *path = (char *) malloc(strlen(cwd) + strlen(filename) + 2);
+    sprintf(path, "%s/%s", cwd, filename);
+    return path;
+}
+
+static
+resident_t *find_resident(char *filename)
+{
+    for (int i = 0; i < (int) RESIDENTS.size(); i++)
+    {
+        if (strcmp(RESIDENTS[i]->filename, filename) == 0)
+            return RESIDENTS[i];
+    }
+    return NULL;
+}
+
+static
+resident_t *new_resident(char *filename)
+{
+    resident_t *r = new resident_t;
+    r->filename = absolute_path(filename);
+    r->bg = NULL;
+    r->matrices = NULL;
+    r->matrix_format = -1;
+    RESIDENTS.push_back(r);
+    return r;
+}
+
+markov_t *resident_bg(char *filename)
+{
+    resident_t *r = find_resident(filename);
+    return r == NULL ? NULL : r->bg;
+}
+
+matrix_db_t *resident_matrices(char *filename, int format)
+{
+    resident_t *r = find_resident(filename);
+    return r == NULL || r->matrix_format != format ? NULL : r->matrices;
+}
+
+seq_t **resident_seqs(char *filename, int *nseqs)
+{
+    resident_t *r = find_resident(filename);
+    if (r == NULL || r->seqs.empty())
+        return NULL;
+    *nseqs = (int) r->seqs.size();
+    return &r->seqs[0];
+}
+
+/*
+  socket I/O
+*/
+static
+int write_all(int fd, const void *buffer, size_t size)
+{
+    const char *p = (const char *) buffer;
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+static
+int read_all(int fd, void *buffer, size_t size)
+{
+    char *p = (char *) buffer;
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+// send the descriptors 0, 1 and 2 with a single byte
+static
+int send_stdio(int fd)
+{
+    int fds[3] = {0, 1, 2};
+    char byte = 0;
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov;
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    return sendmsg(fd, &msg, 0) == 1;
+}
+
+static
+int recv_stdio(int fd, int *fds)
+{
+    char byte;
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov;
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, 0) != 1)
+        return 0;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        return 0;
+    memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    return 1;
+}
+
+static
+int open_socket(char *socket_path, struct sockaddr_un *addr)
+{
+    ASSERT(strlen(socket_path) < sizeof(addr->sun_path), "socket name too long");
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        ERROR("can not create socket (%s)", strerror(errno));
+    return fd;
+}
+
+/*
+  child: receive the client stdio and command line, scan, send the status
+  errors exit without status, the client then returns 1
+*/
+static
+void serve_request(int conn)
+{
+    int fds[3];
+    uint32_t size;
+    if (!recv_stdio(conn, fds) || !read_all(conn, &size, sizeof(size)))
+        exit(1);
+    char *args = (char *) malloc(size + 1);
+    if (!read_all(conn, args, size))
+        exit(1);
+    args[size] = '\0';
+
+    // NUL-separated arguments
+    vector<char *> argv;
+    for (char *p = args; p < args + size; p += strlen(p) + 1)
+        argv.push_back(p);
+    argv.push_back(NULL);
+
+    for (int i = 0; i < 3; i++)
+    {
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+    int status = scan_main((int) argv.size() - 1, &argv[0]);
+    fflush(stdout);
+    fflush(stderr);
+    char c = (char) status;
+    write_all(conn, &c, 1);
+    exit(status);
+}
+
+int server_main(int argc, char *argv[])
+{
+    char *socket_path = NULL;
+    vector<char *> matfiles;
+    int matrix_format = MATRIX_TAB;
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-server") == 0)
+        {
+            ASSERT(argc > i + 1, "-server requires a socket name");
+            socket_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            ASSERT(argc > i + 1, "-v requires a nummber (0, 1 or 2)");
+            VERBOSITY = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-i") == 0)
+        {
+            ASSERT(argc > i + 1, "-i requires a filename");
+            FILE *fp = zopen(argv[++i]);
+            if (fp == NULL)
+                ERROR("unable to open '%s'", argv[i]);
+            resident_t *r = new_resident(argv[i]);
+            fasta_reader_t *reader = new_fasta_reader(fp);
+            seq_t *seq;
+            while ((seq = fasta_reader_next(reader)) != NULL)
+                r->seqs.push_back(seq);
+            free_fasta_reader(reader);
+            zclose(fp);
+            VERBOSE1("; loaded %d sequences from %s\n", (int) r->seqs.size(), r->filename);
+        }
+        else if (strcmp(argv[i], "-m") == 0)
+        {
+            ASSERT(argc > i + 1, "-m requires a filename");
+            matfiles.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-matrix_format") == 0)
+        {
+            ASSERT(argc > i + 1, "-matrix_format requires a value");
+            matrix_format = parse_matrix_format(argv[++i]);
+            if (matrix_format < 0)
+                ERROR("invalid value for option -matrix_format");
+        }
+        else if (strcmp(argv[i], "-bgfile") == 0)
+        {
+            ASSERT(argc > i + 1, "-bgfile requires a filename");
+            resident_t *r = new_resident(argv[++i]);
+            r->bg = read_markov(argv[i], MARKOV_INCLUSIVE, 0.0);
+            if (r->bg == NULL)
+                ERROR("can not load bg model '%s'", argv[i]);
+            VERBOSE1("; loaded bg model %s\n", r->filename);
+        }
+        else
+        {
+            WARNING("invalid option %s", argv[i]);
+        }
+    }
+
+    // matrix files, all in the -matrix_format format
+    for (i = 0; i < (int) matfiles.size(); i++)
+    {
+        resident_t *r = new_resident(matfiles[i]);
+        r->matrices = read_matrix_db(matfiles[i], matrix_format);
+        if (r->matrices == NULL)
+            ERROR("can not load matrices '%s'", matfiles[i]);
+        r->matrix_format = matrix_format;
+        VERBOSE1("; loaded %d matrices from %s\n", r->matrices->n, r->filename);
+    }
+
+    struct sockaddr_un addr;
+    int fd = open_socket(socket_path, &addr);
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 64) < 0)
+        ERROR("can not listen on '%s' (%s)", socket_path, strerror(errno));
+    VERBOSE1("; listening on %s\n", socket_path);
+
+    // children are not waited for
+    signal(SIGCHLD, SIG_IGN);
+    while (1)
+    {
+        int conn = accept(fd, NULL, NULL);
+        if (conn < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            ERROR("accept failed (%s)", strerror(errno));
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fd);
+            signal(SIGCHLD, SIG_DFL);
+            serve_request(conn);
+        }
+        if (pid < 0)
+            WARNING("can not fork (%s)", strerror(errno));
+        close(conn);
+    }
+    return 0;
+}
+
+int client_main(char *socket_path, int argc, char *argv[])
+{
+    // file arguments are sent with absolute names
+    string args = "";
+    int i;
+    for (i = 0; i < argc; i++)
+    {
+        if ((i > 0 && (strcmp(argv[i - 1], "-i") == 0 || strcmp(argv[i - 1], "-m") == 0
+                       || strcmp(argv[i - 1], "-bgfile") == 0 || strcmp(argv[i - 1], "-distrib") == 0
+                       || strcmp(argv[i - 1], "-o") == 0 || strcmp(argv[i - 1], "-regions") == 0
+                       || strcmp(argv[i - 1], "-genome") == 0))
+            || (i > 1 && strcmp(argv[i - 2], "-set") == 0))
+        {
+            char *path = absolute_path(argv[i]);
+            args += path;
+            free(path);
+        }
+        else
+        {
+            args += argv[i];
+        }
+        args += '\0';
+    }
+
+    struct sockaddr_un addr;
+    int fd = open_socket(socket_path, &addr);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        ERROR("can not connect to '%s' (%s)", socket_path, strerror(errno));
+    uint32_t size = args.size();
+    if (!send_stdio(fd) || !write_all(fd, &size, sizeof(size)) || !write_all(fd, args.data(), size))
+        ERROR("can not send request to '%s'", socket_path);
+
+    char status;
+    if (!read_all(fd, &status, 1))
+        return 1;
+    close(fd);
+    return status;
+}
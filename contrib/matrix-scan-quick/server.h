@@ -0,0 +1,39 @@
+/***************************************************************************
+ *                                                                         *
+ *  server.h
+ *  scan server with resident sequences, matrices and backgrounds
+ *
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __SERVER__
+#define __SERVER__
+
+#include "utils.h"
+#include "markov.h"
+#include "matrix.h"
+#include "seq.h"
+
+/*
+  The server loads sequence, matrix and background files once and listens
+  on a Unix socket. A client sends its command line (with absolute file
+  names) and its standard input, output and error; the server forks a
+  child that runs the scan on the resident data and writes the results
+  directly to the client output, then sends back the exit status.
+*/
+
+// run the server: matrix-scan-quick -server socket [-i file]... [-m file]... [-matrix_format format] [-bgfile file]...
+int server_main(int argc, char *argv[]);
+
+// scan with the usual command line options (main.cpp)
+int scan_main(int argc, char *argv[]);
+
+// run a scan through the server listening on socket_path (argv without -socket)
+int client_main(char *socket_path, int argc, char *argv[]);
+
+// resident data (NULL if the file was not loaded by the server)
+markov_t *resident_bg(char *filename);
+matrix_db_t *resident_matrices(char *filename, int format);
+seq_t **resident_seqs(char *filename, int *nseqs);
+
+#endif
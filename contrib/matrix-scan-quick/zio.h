@@ -0,0 +1,58 @@
+/***************************************************************************
+ *                                                                         *
+ *  zio.h
+ *  transparent gzip / BGZF input
+ *
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __ZIO__
+#define __ZIO__
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  zopen returns a FILE opened for reading whatever the compression, so
+  that the FASTA readers (getc, fread, ...) do not change:
+
+  - plain files are opened with fopen
+  - gzip files are inflated by a thread, ahead of the parser, into a
+    socket read through the returned FILE
+  - BGZF files (bgzip, samtools) are inflated by blocks in parallel by
+    ZIO_THREADS threads (the number of processors by default)
+
+  Compressed streams can not be rewound: zclose and zopen again.
+*/
+
+// number of threads used for BGZF files (0: number of processors)
+extern int ZIO_THREADS;
+
+// open filename (stdin if NULL or "-"), NULL if the file can not be opened
+FILE *zopen(const char *filename);
+
+// close a FILE returned by zopen
+void zclose(FILE *fp);
+
+/*
+  random access to the uncompressed data of a BGZF file, using its .gzi
+  index (bgzip -i, samtools faidx) or, without index, the block headers
+*/
+typedef struct bgzf_reader bgzf_reader_t;
+
+// NULL if filename is not a BGZF file
+bgzf_reader_t *bgzf_open(const char *filename);
+
+void bgzf_close(bgzf_reader_t *reader);
+
+// read size uncompressed bytes at offset into buffer, returns the number of bytes read
+long bgzf_read_at(bgzf_reader_t *reader, long offset, char *buffer, long size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
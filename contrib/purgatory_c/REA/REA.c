@@ -56,6 +56,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>  
 #include <unistd.h>  
 
@@ -67,28 +68,100 @@
 #include <loadgraph.h>
 #include <dijkstra.h>
 #include <chronometer.h>
+#include <batch.h>
+#include <csrgraph.h>
 
 
-/*============================================================================
-  GLOBAL VARIABLES
-  ============================================================================*/
+/*============================================================================*/
+static void NewPathSlab (Search *search) {
+  /* Moves to the next slab of paths, allocating it if it does not exist */
 
-/* A buffer for heap elements is dinamically allocated by the main function  */
-/* with size the number of arcs in the graph (which is the worst case bound) */
-/* New heaps are initialized using this buffer by the function CreateHeap    */
-Path **heapsBuffer;
-Path **firstFreeHeap;
+  if (search->currentSlab != NULL && search->currentSlab->next != NULL)
+    search->currentSlab = search->currentSlab->next;
+  else {
+    PathSlab *slab = malloc (sizeof(*slab));
+    if (slab == NULL) {
+      perror("Not enough memory for paths.\n");
+      exit(1);
+    }
+    slab->next = NULL;
+    if (search->currentSlab == NULL)
+      search->firstSlab = slab;
+    else
+      search->currentSlab->next = slab;
+    search->currentSlab = slab;
+    search->numberSlabs++;
+  }
+  search->usedInSlab = 0;
+}
 
-/* For experimental purposes we avoid to use the malloc system for new paths */
-/* New paths are taken from this buffer by the function CreatePath           */
-#define MAX_PATHS 10000000
-Path pathsBuffer[MAX_PATHS];
-int  numberUsedPaths = 0;
-Path *firstFreePath = pathsBuffer;
+
+/*============================================================================*/
+void CreateSearch (Search *search, Graph *graph) {
+  /* Allocates the memory of a search: the best path and the heap of each
+     node, a first slab of paths, and a buffer for heap elements with
+     size the number of arcs in the graph (which is the worst case bound) */
+
+  search->graph              = graph;
+  search->initialNode        = NULL;
+  search->firstSlab          = NULL;
+  search->currentSlab        = NULL;
+  search->numberPaths        = 0;
+  search->numberHeapElements = 0;
+  search->numberSlabs        = 0;
+  search->bestPath    = malloc (graph->numberNodes*sizeof(search->bestPath[0]));
+  search->heap        = malloc (graph->numberNodes*sizeof(search->heap[0]));
+  search->heapsBuffer = malloc (graph->numberArcs*sizeof(search->heapsBuffer[0]));
+  if (search->bestPath == NULL || search->heap == NULL ||
+      search->heapsBuffer == NULL) {
+    perror("Not enough memory for paths and heaps.\n");
+    exit(1);
+  }
+  NewPathSlab (search);
+}
 
 
 /*============================================================================*/
-__inline__ Path *CreatePath (Node *node, Path *backPath, COST_TYPE cost) {
+void ResetSearch (Search *search, Node *initialNode) {
+  /* Forgets all the paths computed so far and prepares the search for
+     paths departing from initialNode: each node gets a best path with
+     infinite cost, to be set by Dijkstra, and an empty set of candidates.
+     The slabs of paths and the heaps buffer are reused from the start. */
+
+  Graph *graph = search->graph;
+  Node  *node;
+  int   nodeName;
+
+  search->initialNode   = initialNode;
+  search->currentSlab   = search->firstSlab;
+  search->usedInSlab    = 0;
+  search->firstFreeHeap = search->heapsBuffer;
+  for (node = graph->node, nodeName = 1; nodeName <= graph->numberNodes;
+       node++, nodeName++) {
+    BEST_PATH(search, node)           = CreatePath (search, node, NULL, INFINITY_COST);
+    BEST_PATH(search, node)->nextPath = NULL;
+    HEAP(search, node)->elt           = NULL;
+  }
+}
+
+
+/*============================================================================*/
+void FreeSearch (Search *search) {
+
+  PathSlab *slab, *next;
+
+  for (slab = search->firstSlab; slab != NULL; slab = next) {
+    next = slab->next;
+    free (slab);
+  }
+  free (search->bestPath);
+  free (search->heap);
+  free (search->heapsBuffer);
+}
+
+
+/*============================================================================*/
+Path *CreatePath (Search *search, Node *node, Path *backPath, COST_TYPE cost) {
 
   Path   *newPath;
   
@@ -96,11 +169,10 @@ __inline__ Path *CreatePath (Node *node, Path *backPath, COST_TYPE cost) {
   assert (node != NULL);
 #endif
   
-  if (++numberUsedPaths > MAX_PATHS) {
-    fprintf (stderr, "Redefine MAX_PATHS");
-    exit(1);
-  }
-  newPath = firstFreePath++;
+  if (search->usedInSlab == PATHS_PER_SLAB)
+    NewPathSlab (search);
+  newPath = search->currentSlab->path + search->usedInSlab++;
+  search->numberPaths++;
   
   newPath->backPath = backPath;
   newPath->cost     = cost;
@@ -129,10 +201,20 @@ void PrintPath (Path *path) {
 
 
 
+/*============================================================================*/
+void PrintAllocations (Search *search) {
+  /* Prints the allocation counters of a search, after the time counters */
+
+  printf ("Allocations: %ld paths in %d slabs, %ld heap elements\n",
+          search->numberPaths, search->numberSlabs, search->numberHeapElements);
+}
+
+
+
 #define COST(_i_) (H->elt[_i_]->cost)
 
 /*============================================================================*/
-__inline__ void CreateHeap (Heap *H, int dimension) {
+static __inline__ void CreateHeap (Search *search, Heap *H, int dimension) {
   /* Allocates memory for the heap elements from the heaps buffer 
      and initializes the number of element inside the heap to 0 */
 #ifdef DEBUG
@@ -140,13 +222,14 @@ __inline__ void CreateHeap (Heap *H, int dimension) {
   H->dimension = dimension;
 #endif
   H->size = 0;
-  H->elt = firstFreeHeap;
-  firstFreeHeap += dimension;
+  H->elt = search->firstFreeHeap;
+  search->firstFreeHeap += dimension;
+  search->numberHeapElements += dimension;
 }
 
 
 /*============================================================================*/
-__inline__ void PreInsertInHeap(Heap *H, Path *elt) {
+static __inline__ void PreInsertInHeap(Heap *H, Path *elt) {
   /* Inserts a new element in the heap in time O(1)
      without preserving the heap property */
 #ifdef DEBUG
@@ -158,7 +241,7 @@ __inline__ void PreInsertInHeap(Heap *H, Path *elt) {
 
 
 /*============================================================================*/
-__inline__ void BuildHeap(Heap *H) {
+static __inline__ void BuildHeap(Heap *H) {
   /* Obtains the heap property in time linear with the heap size */
   
   register int i;
@@ -177,7 +260,7 @@ __inline__ void BuildHeap(Heap *H) {
 
 
 /*============================================================================*/
-__inline__ Path * DeleteBestInHeap (Heap *H) {
+static __inline__ Path * DeleteBestInHeap (Heap *H) {
   /* Returns the element with minimum cost in the heap and deletes
      it from the heap, restoring the heap property in worst case time
      logarithmic with the heap size */
@@ -201,7 +284,7 @@ __inline__ Path * DeleteBestInHeap (Heap *H) {
 }
 
 /*============================================================================*/
-__inline__ Path * BestInHeap (Heap *H) {
+static __inline__ Path * BestInHeap (Heap *H) {
      /* Returns the element with minimum cost in the heap without deleting it */
 
   if (H->size == 0) return (NULL);
@@ -209,7 +292,7 @@ __inline__ Path * BestInHeap (Heap *H) {
 }
 
 /*============================================================================*/
-__inline__ void UpdateBestInHeap (Heap *H, Path *elt) {
+static __inline__ void UpdateBestInHeap (Heap *H, Path *elt) {
      /* Deletes the element with minimum cost in the heap and inserts a new one
 	preserving the heap property, in worst case time logarithmic with the
 	heap size */
@@ -227,7 +310,7 @@ __inline__ void UpdateBestInHeap (Heap *H, Path *elt) {
 
 
 /*============================================================================*/
-__inline__ void InitializeCandidateSet (Node *node) {
+static __inline__ void InitializeCandidateSet (Search *search, Node *node) {
   /* The set of candidates is  initialized with the best path from
      each  predecessor node, except  the  one from which  the best
      path at the current node  comes. If the current node is the 
@@ -236,32 +319,35 @@ __inline__ void InitializeCandidateSet (Node *node) {
 
   PtrArc *ptrArc;
   int    numberArcs;
+  Heap   *heap = HEAP(search, node);
   Path   *path,
          *newCand;
   
-  CreateHeap (&node->heap, node->numberArcsIn);
+  CreateHeap (search, heap, node->numberArcsIn);
   
   for (ptrArc = node->firstArcIn, numberArcs = node->numberArcsIn;
        numberArcs != 0; ptrArc++, numberArcs--)
-    if ( (path = (*ptrArc)->source->bestPath) != node->bestPath->backPath) {
+    if ( (path = BEST_PATH(search, (*ptrArc)->source)) !=
+         BEST_PATH(search, node)->backPath) {
       /* It is important to compare pointers and not costs or node names,
          because  several candidates could came from the same node (if
          the graph has parallel arcs) and/or with the same cost. */
-      newCand = CreatePath (node, path, path->cost + (*ptrArc)->cost);
-      PreInsertInHeap (&node->heap, newCand);
+      newCand = CreatePath (search, node, path, path->cost + (*ptrArc)->cost);
+      PreInsertInHeap (heap, newCand);
     }
-  BuildHeap(&node->heap);
+  BuildHeap(heap);
 }
 
    
 /*============================================================================*/
-Path* NextPath (Path *path) {
+Path* NextPath (Search *search, Path *path) {
   /* Central routine of the Recursive Enumeration Algorithm: computes the
      next path from the initial node to the same node in which the argument
      path ends, assuming that it has not been computed before.
   */
      
   Node      *node         = NULL;
+  Heap      *heap         = NULL;
   Path      *backPath     = NULL,
             *nextBackPath = NULL,
             *bestCand     = NULL,
@@ -275,32 +361,33 @@ Path* NextPath (Path *path) {
 #endif
   
   node = path->lastNode;
+  heap = HEAP(search, node);
   
 #ifdef DEBUG
   printf ("\nComputing next path at node %i\n", node->name);
 #endif
   
-  if (node->heap.elt == NULL) 
+  if (heap->elt == NULL) 
     /* This is done here instead of in Dijkstra function, so that it is */
     /* only done for nodes in which alternative paths are required.     */
-    InitializeCandidateSet (node);
+    InitializeCandidateSet (search, node);
   
   if ((backPath = path->backPath) != NULL) {
     nextBackPath = backPath->nextPath;
     if (nextBackPath == NULL)
-      nextBackPath = NextPath (backPath);
+      nextBackPath = NextPath (search, backPath);
     if (nextBackPath != NULL) {
       arcCost = path->cost - backPath->cost;
-      newCand = CreatePath (node, nextBackPath, nextBackPath->cost + arcCost);
+      newCand = CreatePath (search, node, nextBackPath, nextBackPath->cost + arcCost);
     }
   }
   
   if (newCand == NULL)
-    bestCand = DeleteBestInHeap (&node->heap);
+    bestCand = DeleteBestInHeap (heap);
   else {
-    bestCand = BestInHeap (&node->heap);
+    bestCand = BestInHeap (heap);
     if (bestCand != NULL && bestCand->cost < newCand->cost)
-      UpdateBestInHeap (&node->heap, newCand);
+      UpdateBestInHeap (heap, newCand);
     else
       bestCand = newCand;
   }
@@ -335,9 +422,14 @@ void Copyright () {
 void Help (char *program) {
   printf ("======================================================================\n");
   printf ("\nUse: %s GRAPH_FILE NUMBER_OF_PATHS [-paths] [-tdijkstra]\n", program);
+  printf ("     %s GRAPH_FILE -queries QUERY_FILE [-threads N] [-paths]\n", program);
   printf ("     Optional arguments:\n");
   printf ("       -paths Print the sequence of nodes for each path\n");
   printf ("       -tdijkstra Cumulate also the time of Dijkstra's algorithm\n");
+  printf ("       -queries Answer the queries \"q SOURCE DESTINATION NUMBER_OF_PATHS\"\n");
+  printf ("                of QUERY_FILE instead of the s and t lines of GRAPH_FILE\n");
+  printf ("       -threads Number of threads for the queries (default: number\n");
+  printf ("                of processors)\n");
   printf ("See the README file for more details.\n");
   printf ("======================================================================\n");
   exit (1);
@@ -347,6 +439,7 @@ void Help (char *program) {
 int main (int argc, char **argv) {
  
   Graph  graph;
+  Search search;
   Path   *path;
   int    i, numberPaths = 1;
   time_t date;
@@ -354,6 +447,8 @@ int main (int argc, char **argv) {
   char   hostName[200] = "";
   int    showPaths = 0;
   int    measureDijkstra = 0;
+  char   *queryFile = NULL;
+  int    numberThreads = 0;
   float  *cumulatedSeconds;
 #ifdef DEBUG
   Node   *node;
@@ -365,12 +460,25 @@ int main (int argc, char **argv) {
 
   /************** Reads the command line parameters *************************/
   if (argc < 3) Help (argv[0]);
-  numberPaths = atoi (argv[2]);
-  for (i=3; i < argc; i++) {
+  if (strcmp(argv[2], "-queries") == 0) {
+    if (argc < 4) Help (argv[0]);
+    queryFile = argv[3];
+    i = 4;
+  } else {
+    numberPaths = atoi (argv[2]);
+    i = 3;
+  }
+  for (; i < argc; i++) {
     if (strcmp(argv[i], "-paths") == 0) showPaths = 1;
     else if (strcmp(argv[i], "-tdijkstra") == 0)  measureDijkstra = 1;
+    else if (strcmp(argv[i], "-threads") == 0 && i+1 < argc)
+      numberThreads = atoi (argv[++i]);
     else Help(argv[0]);
   }
+  if (numberThreads <= 0) {
+    numberThreads = sysconf (_SC_NPROCESSORS_ONLN);
+    if (numberThreads <= 0) numberThreads = 1;
+  }
 
   /****************** Prints experimental trace information *****************/
   gethostname (hostName, 200);
@@ -388,15 +496,30 @@ int main (int argc, char **argv) {
   /******************* Reads the graph from file ****************************/
   
   LoadGraph(&graph, argv[1]);
-  
-  /********** Allocates memory for heaps ************************************/
-  /* Memory is allocated for the worst case: one element per arc */
-  heapsBuffer = (Path **) malloc(graph.numberArcs*sizeof(*heapsBuffer));
-  if (heapsBuffer == NULL) {
-    perror("Not enough memory for heaps.\n");
-    exit(1);
+
+  /******************* Answers a batch of queries ***************************/
+  if (queryFile != NULL) {
+    search.numberPaths = search.numberHeapElements = search.numberSlabs = 0;
+    ClockReset ();
+    RunBatch (&graph, queryFile, numberThreads, showPaths, &search);
+    printf ("\nTotalExecutionTime: %.2f\n", ClockTotal ());
+    PrintAllocations (&search);
+    return (0);
+  }
+
+  if (graph.initialNode == NULL) {
+    fprintf (stderr, "\nIncorrect initial node in file %s%s\n", argv[1],
+             csrIsBinary (argv[1]) ? " (binary graphs need -queries)" : "");
+    exit (1);
   }
-  firstFreeHeap = heapsBuffer;
+  if (graph.finalNode == NULL) {
+    fprintf (stderr, "\nIncorrect final node in file %s\n", argv[1]);
+    exit (1);
+  }
+  
+  /********** Allocates memory for paths and heaps **************************/
+  CreateSearch (&search, &graph);
+  ResetSearch (&search, graph.initialNode);
   
   /********** Allocates memory for time counters *****************************/
   cumulatedSeconds = malloc (sizeof(cumulatedSeconds[0])*numberPaths);
@@ -409,7 +532,7 @@ int main (int argc, char **argv) {
   if (measureDijkstra == 1)
     ClockReset ();
 
-  Dijkstra (&graph);
+  Dijkstra (&search);
 
   if (measureDijkstra == 1)
     cumulatedSeconds[0] =  ClockTotal();
@@ -422,18 +545,18 @@ int main (int argc, char **argv) {
   for (node = graph.node, numberNodes = graph.numberNodes; numberNodes != 0; 
        node++, numberNodes--) { 
     printf ("\nBest Path for FinalNode=%i: ", node->name);
-    PrintPath (node->bestPath);
+    PrintPath (BEST_PATH(&search, node));
   }
 #endif
   
   /******************** Computes the K shortest paths ***********************/
   i = 2;
-  path = graph.finalNode->bestPath;
+  path = BEST_PATH(&search, graph.finalNode);
   while (i <= numberPaths && path != NULL) {
     printf("\nN=%i:\t", i-1);
     if (showPaths == 1) PrintPath (path);
     printf (" \t(CumulatedSeconds: %.2f)",0.5);
-    path = NextPath (path);
+    path = NextPath (&search, path);
     cumulatedSeconds[i-1] = ClockTotal();
     i++;
   }
@@ -445,7 +568,7 @@ int main (int argc, char **argv) {
   
   /************ Prints the computed paths and time counters ******************/
   /*i = 1;
-  path = graph.finalNode->bestPath;
+  path = BEST_PATH(&search, graph.finalNode);
   while (i <= numberPaths && path != NULL && path->cost < INFINITY_COST) {
     printf ("\nN=%i:\t", i);
     if (showPaths == 1) PrintPath (path);
@@ -455,5 +578,6 @@ int main (int argc, char **argv) {
     }*/
 
   printf ("\nTotalExecutionTime: %.2f\n", (float) cumulatedSeconds[i-2]);
+  PrintAllocations (&search);
   return (0);
 }
@@ -93,22 +93,61 @@ typedef struct Node {
   Arc    *firstArcOut;  /* Pointer to an element in graph.arc           */
   int    numberArcsIn;  /* Number of arcs that reach the node           */
   PtrArc *firstArcIn;   /* Pointer to an element in graph.arcIn         */
-  Path   *bestPath;     /* First path in the list of computed paths     */
-                        /* from the initial node to this node           */
-  Heap   heap;          /* Set of candidate paths (binary heap)         */
 } Node;
 
 typedef struct Graph {
   int    numberNodes;  /* Number of nodes in the graph                        */
   int    numberArcs;   /* Number of arcs in the graph                         */
-  Node   *initialNode; /* The node from which all paths depart                */
+  Node   *initialNode; /* The node from which all paths depart (s line)       */
   Node   *finalNode;   /* The node to which the K shortest paths are required */
+                       /* (t line); both are NULL if absent from the file     */
   Node   *node;        /* Nodes, with node named i in position i-1            */
   Arc    *arc;         /* Arcs sorted by source node                          */
   PtrArc *arcIn;       /* Pointers to arcs, sorted by destination node        */
 }  Graph;
 
-extern Path *CreatePath (Node *node, Path *backPath, COST_TYPE cost);
+/* Paths are allocated by slabs, which are kept from one query to the next */
+#define PATHS_PER_SLAB 65536
+
+typedef struct PathSlab {
+  struct PathSlab *next;
+  Path            path[PATHS_PER_SLAB];
+} PathSlab;
+
+/* The paths computed from one initial node. The graph itself is only read,
+   so that several searches (one per thread) can share it. Since the lists
+   of computed paths do not depend on the final node, a search can answer
+   any number of queries from the same initial node. 
+*/
+typedef struct Search {
+  Graph    *graph;
+  Node     *initialNode;   /* The node from which all paths depart            */
+  Path     **bestPath;     /* For the node named i, in position i-1: first    */
+                           /* path in the list of computed paths from         */
+                           /* initialNode                                     */
+  Heap     *heap;          /* For the node named i, in position i-1: set of   */
+                           /* candidate paths (binary heap)                   */
+  PathSlab *firstSlab;     /* New paths are taken from these slabs            */
+  PathSlab *currentSlab;
+  int      usedInSlab;     /* Number of paths taken from currentSlab          */
+  Path     **heapsBuffer;  /* Heap elements, one per arc in the worst case    */
+  Path     **firstFreeHeap;
+  /* Allocation counters, cumulated over all the queries of the search        */
+  long     numberPaths;    /* Paths created                                   */
+  long     numberHeapElements; /* Heap elements reserved                      */
+  int      numberSlabs;    /* Slabs allocated with malloc                     */
+} Search;
+
+#define BEST_PATH(_search_, _node_) ((_search_)->bestPath[(_node_)->name - 1])
+#define HEAP(_search_, _node_)      ((_search_)->heap + ((_node_)->name - 1))
+
+extern Path *CreatePath (Search *search, Node *node, Path *backPath,
+                         COST_TYPE cost);
+extern void CreateSearch (Search *search, Graph *graph);
+extern void ResetSearch (Search *search, Node *initialNode);
+extern void FreeSearch (Search *search);
+extern Path *NextPath (Search *search, Path *path);
+extern void PrintAllocations (Search *search);
 
 #define _REA_H_INCLUDED
 #endif
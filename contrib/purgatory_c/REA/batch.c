@@ -0,0 +1,265 @@
+/*========================================================================
+
+  File: batch.c
+
+  ========================================================================
+
+  This module answers a batch of K shortest paths queries on the same
+  graph. See the file batch.h for more information.
+
+  ========================================================================
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+  ========================================================================= */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+#include <REA.h>
+#include <dijkstra.h>
+#include <batch.h>
+
+#define MAX_LINE_LENGTH 100
+
+
+typedef struct {
+  char *text;     /* Output of a query, printed once all are answered */
+  int  length;
+  int  capacity;
+} Output;
+
+typedef struct {
+  Node   *source;
+  Node   *dest;
+  int    numberPaths;
+  Output output;
+} Query;
+
+typedef struct {
+  Graph           *graph;
+  Query           *query;
+  int             *order;       /* Queries sorted by source                */
+  int             numberQueries;
+  int             nextQuery;    /* Position in order of the next group     */
+  int             showPaths;
+  Search          *total;       /* Sum of the allocation counters          */
+  pthread_mutex_t lock;
+} Batch;
+
+
+/*============================================================================*/
+static void Append (Output *output, const char *format, ...) {
+  /* Appends formatted text to the output of a query */
+
+  va_list args;
+  int     length;
+
+  for (;;) {
+    va_start (args, format);
+    length = vsnprintf (output->text + output->length,
+                        output->capacity - output->length, format, args);
+    va_end (args);
+    if (output->length + length < output->capacity)
+      break;
+    output->capacity = 2*(output->length + length) + 256;
+    output->text = realloc (output->text, output->capacity);
+    if (output->text == NULL) {
+      perror("Not enough memory for the output of queries.\n");
+      exit(1);
+    }
+  }
+  output->length += length;
+}
+
+
+/*============================================================================*/
+static void AppendPath (Output *output, Path *path) {
+  /* Same as PrintPath, on the output of a query */
+  Path *backPath;
+
+  if (path->cost < INFINITY_COST) {
+    for (backPath = path; backPath != NULL; backPath = backPath->backPath)
+      Append (output, "%i-", backPath->lastNode->name);
+    Append (output, " \t(Cost: %f)", path->cost);
+  }
+}
+
+
+/*============================================================================*/
+static void AnswerQuery (Search *search, Query *query, int showPaths) {
+  /* Enumerates the K shortest paths to the destination of the query,
+     reusing the paths already computed by the search */
+
+  Path *path;
+  int  i;
+
+  Append (&query->output, "\nQuery: %i %i %i", query->source->name,
+          query->dest->name, query->numberPaths);
+  path = BEST_PATH(search, query->dest);
+  for (i = 1; i <= query->numberPaths && path != NULL; i++) {
+    Append (&query->output, "\nN=%i:\t", i);
+    if (showPaths == 1) AppendPath (&query->output, path);
+    if (i < query->numberPaths)
+      path = (path->nextPath != NULL) ? path->nextPath
+                                      : NextPath (search, path);
+  }
+}
+
+
+/*============================================================================*/
+static void *BatchWorker (void *arg) {
+  /* Takes the queries group by group (one group per source) */
+
+  Batch  *batch = arg;
+  Search search;
+  Query  *query;
+  int    first, last;
+
+  CreateSearch (&search, batch->graph);
+  for (;;) {
+    pthread_mutex_lock (&batch->lock);
+    first = batch->nextQuery;
+    for (last = first; last < batch->numberQueries &&
+           batch->query[batch->order[last]].source ==
+           batch->query[batch->order[first]].source; last++)
+      ;
+    batch->nextQuery = last;
+    pthread_mutex_unlock (&batch->lock);
+    if (first == last)
+      break;
+
+    ResetSearch (&search, batch->query[batch->order[first]].source);
+    Dijkstra (&search);
+    for (; first < last; first++) {
+      query = batch->query + batch->order[first];
+      AnswerQuery (&search, query, batch->showPaths);
+    }
+  }
+  pthread_mutex_lock (&batch->lock);
+  batch->total->numberPaths        += search.numberPaths;
+  batch->total->numberHeapElements += search.numberHeapElements;
+  batch->total->numberSlabs        += search.numberSlabs;
+  pthread_mutex_unlock (&batch->lock);
+  FreeSearch (&search);
+  return NULL;
+}
+
+
+/*============================================================================*/
+static Query *sortedQueries;
+
+static int CompareQueries (const void *a, const void *b) {
+  /* By source, then in the order of the file */
+  int i = *(const int *) a, j = *(const int *) b;
+  int si = sortedQueries[i].source->name, sj = sortedQueries[j].source->name;
+
+  if (si != sj) return (si < sj) ? -1 : 1;
+  return i - j;
+}
+
+
+/*============================================================================*/
+static int LoadQueries (Graph *graph, char *fileName, Query **queries) {
+  /* Reads the queries, returns their number */
+
+  FILE  *file;
+  char  line[MAX_LINE_LENGTH];
+  int   sourceName, destName, numberPaths;
+  int   numberQueries = 0, capacity = 64;
+  Query *query;
+
+  if ((file = fopen (fileName, "r")) == NULL) {
+    perror ("Query file does not exist");
+    exit (1);
+  }
+  query = malloc (capacity*sizeof(query[0]));
+  while (query != NULL && fgets (line, MAX_LINE_LENGTH, file) != NULL) {
+    if (line[0] != 'q')
+      continue;
+    if (sscanf(line, "q%d %d %d\n", &sourceName, &destName, &numberPaths) != 3
+        || numberPaths <= 0) {
+      fprintf (stderr, "\nError in file %s in line:\n%s\n", fileName, line);
+      exit (1);
+    }
+    if (sourceName <= 0 || sourceName > graph->numberNodes ||
+        destName <= 0 || destName > graph->numberNodes) {
+      fprintf (stderr, "\nIncorrect node in file %s in line:\n%s\n",
+               fileName, line);
+      exit (1);
+    }
+    if (numberQueries == capacity) {
+      capacity *= 2;
+      query = realloc (query, capacity*sizeof(query[0]));
+      if (query == NULL)
+        break;
+    }
+    query[numberQueries].source      = graph->node + (sourceName - 1);
+    query[numberQueries].dest        = graph->node + (destName - 1);
+    query[numberQueries].numberPaths = numberPaths;
+    query[numberQueries].output.text     = NULL;
+    query[numberQueries].output.length   = 0;
+    query[numberQueries].output.capacity = 0;
+    numberQueries++;
+  }
+  if (query == NULL) {
+    perror("Not enough memory for queries.\n");
+    exit(1);
+  }
+  fclose (file);
+  *queries = query;
+  return numberQueries;
+}
+
+
+/*============================================================================*/
+void RunBatch (Graph *graph, char *fileName, int numberThreads,
+               int showPaths, Search *total) {
+
+  Batch     batch;
+  pthread_t *thread;
+  int       i;
+
+  batch.graph         = graph;
+  batch.numberQueries = LoadQueries (graph, fileName, &batch.query);
+  batch.nextQuery     = 0;
+  batch.showPaths     = showPaths;
+  batch.total         = total;
+  pthread_mutex_init (&batch.lock, NULL);
+
+  batch.order = malloc ((batch.numberQueries + 1)*sizeof(batch.order[0]));
+  thread = malloc (numberThreads*sizeof(thread[0]));
+  if (batch.order == NULL || thread == NULL) {
+    perror("Not enough memory for queries.\n");
+    exit(1);
+  }
+  for (i = 0; i < batch.numberQueries; i++)
+    batch.order[i] = i;
+  sortedQueries = batch.query;
+  qsort (batch.order, batch.numberQueries, sizeof(batch.order[0]),
+         CompareQueries);
+
+  for (i = 0; i < numberThreads; i++)
+    if (pthread_create (thread + i, NULL, BatchWorker, &batch) != 0) {
+      perror("Cannot create thread.\n");
+      exit(1);
+    }
+  for (i = 0; i < numberThreads; i++)
+    pthread_join (thread[i], NULL);
+
+  for (i = 0; i < batch.numberQueries; i++) {
+    fwrite (batch.query[i].output.text, 1, batch.query[i].output.length,
+            stdout);
+    free (batch.query[i].output.text);
+  }
+
+  pthread_mutex_destroy (&batch.lock);
+  free (batch.order);
+  free (batch.query);
+  free (thread);
+}
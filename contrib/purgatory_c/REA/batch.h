@@ -0,0 +1,37 @@
+/*========================================================================
+
+  File: batch.h
+
+  ========================================================================
+
+  This module answers a batch of K shortest paths queries on the same
+  graph, which is loaded only once. The queries are read from a file
+  with one line per query:
+
+    q SOURCE DESTINATION NUMBER_OF_PATHS
+
+  (other lines are ignored). Queries that share the same source are
+  answered by the same search, so that the shortest path tree and the
+  paths computed for one query are reused by the next ones. Searches
+  from different sources run in parallel, one per thread, each with its
+  own paths and heaps; the results are printed in the order of the
+  queries.
+
+  ========================================================================
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+  ========================================================================= */
+
+
+#ifndef _BATCH_H_INCLUDED
+
+/* The allocation counters of all the searches are added to those of total */
+extern void RunBatch (Graph *graph, char *fileName, int numberThreads,
+                      int showPaths, Search *total);
+
+#define _BATCH_H_INCLUDED
+#endif
@@ -78,7 +78,7 @@ typedef struct  {
 
 
 /*============================================================================*/
-__inline__ void CreateDijkstraHeap (DijkstraHeap * heap, int dimension) {
+static __inline__ void CreateDijkstraHeap (DijkstraHeap * heap, int dimension) {
 
   int i;
 #ifdef DEBUG   
@@ -104,7 +104,7 @@ __inline__ void CreateDijkstraHeap (DijkstraHeap * heap, int dimension) {
 
 
 /*============================================================================*/
-__inline__ void FreeDijkstraHeap (DijkstraHeap * heap) {
+static __inline__ void FreeDijkstraHeap (DijkstraHeap * heap) {
   
   free(heap->info);
   free(heap->elt);
@@ -112,7 +112,7 @@ __inline__ void FreeDijkstraHeap (DijkstraHeap * heap) {
 
 
 /*============================================================================*/
-__inline__ void InsertInDijkstraHeap (DijkstraHeap * heap, COST_TYPE cost, int name) {
+static __inline__ void InsertInDijkstraHeap (DijkstraHeap * heap, COST_TYPE cost, int name) {
   
   int position, parent;
   DijkstraHeapElement *elt;
@@ -140,7 +140,7 @@ __inline__ void InsertInDijkstraHeap (DijkstraHeap * heap, COST_TYPE cost, int n
 
 
 /*============================================================================*/
-__inline__ COST_TYPE DeleteBestInDijkstraHeap (DijkstraHeap * heap, int * name) {
+static __inline__ COST_TYPE DeleteBestInDijkstraHeap (DijkstraHeap * heap, int * name) {
   
   COST_TYPE bestCost;
   DijkstraHeapElement *item;
@@ -175,14 +175,14 @@ __inline__ COST_TYPE DeleteBestInDijkstraHeap (DijkstraHeap * heap, int * name)
 
 
 /*============================================================================*/
-__inline__ int BelongsToDijkstraHeap(DijkstraHeap *heap, int name) {
+static __inline__ int BelongsToDijkstraHeap(DijkstraHeap *heap, int name) {
   
   return (heap->info[name].position != NOT_IN_HEAP);
 }
 
 
 /*============================================================================*/
-__inline__ void DecreaseCostInDijkstraHeap(DijkstraHeap *heap, COST_TYPE cost, int name) {
+static __inline__ void DecreaseCostInDijkstraHeap(DijkstraHeap *heap, COST_TYPE cost, int name) {
   
   int parent, position;
 
@@ -207,12 +207,13 @@ __inline__ void DecreaseCostInDijkstraHeap(DijkstraHeap *heap, COST_TYPE cost, i
 }
 
 /*============================================================================*/
-void Dijkstra (Graph *graph) {
+void Dijkstra (Search *search) {
   /* Computes the tree with the best path from the initial node to
      every node in the graph. Works for graphs with positive weigths.
-     node->bestPath was initialized by LoadGraph for every node.
+     The best path of every node was initialized by ResetSearch.
   */
   
+  Graph        *graph = search->graph;
   COST_TYPE    bestCost;   
   int          indexNode, numberArcs;
   Node         *node;
@@ -222,11 +223,11 @@ void Dijkstra (Graph *graph) {
   CreateDijkstraHeap (&heap, graph->numberNodes);
   
 #ifdef DEBUG
-  assert (graph->initialNode != NULL);
+  assert (search->initialNode != NULL);
 #endif
   
-  graph->initialNode->bestPath->cost = 0;
-  indexNode = graph->initialNode->name - 1;
+  BEST_PATH(search, search->initialNode)->cost = 0;
+  indexNode = search->initialNode->name - 1;
   InsertInDijkstraHeap (&heap, 0, indexNode);
   
   while ( heap.size > 0 ) {
@@ -234,15 +235,15 @@ void Dijkstra (Graph *graph) {
     node = graph->node + indexNode;
     for (arc = node->firstArcOut, numberArcs = node->numberArcsOut;
          numberArcs != 0; arc++, numberArcs--) {
-      Node *dest = arc->dest;
-      if (bestCost + arc->cost < dest->bestPath->cost) {
-	indexNode = dest->name - 1;
+      Path *destPath = BEST_PATH(search, arc->dest);
+      if (bestCost + arc->cost < destPath->cost) {
+	indexNode = arc->dest->name - 1;
 	if (BelongsToDijkstraHeap (&heap, indexNode)) 
 	  DecreaseCostInDijkstraHeap (&heap, bestCost + arc->cost, indexNode); 
 	else 
 	  InsertInDijkstraHeap (&heap, bestCost + arc->cost, indexNode);
-	dest->bestPath->cost     = bestCost + arc->cost;
-	dest->bestPath->backPath = node->bestPath;
+	destPath->cost     = bestCost + arc->cost;
+	destPath->backPath = BEST_PATH(search, node);
       }
     }
   }
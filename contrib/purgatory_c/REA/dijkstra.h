@@ -44,7 +44,7 @@
 
 #ifndef _DIJKSTRA_H_INCLUDED
 
-extern void Dijkstra (Graph *graph);
+extern void Dijkstra (Search *search);
 
 #define _DIJKSTRA_H_INCLUDED
 #endif
@@ -44,10 +44,72 @@
 #include <stdlib.h>
 
 #include <REA.h>
+#include <csrgraph.h>
 
 #define MAX_LINE_LENGTH 100
 
 
+/*============================================================================*/
+static void LoadBinaryGraph(Graph *graph, char *fileName) {
+  /* Reads a graph in the binary CSR format of csrgraph.h. The arcs are */
+  /* already sorted by source node, only the input arcs are sorted here */
+  CSRFile *file;
+  Node *node, *dest;
+  Arc  *arc;
+  int nodeName, numberArcs;
+
+  file = csrOpen (fileName);
+  graph->numberNodes = file->n;
+  graph->numberArcs  = file->m;
+  if (graph->numberNodes <= 0) {
+    fprintf (stderr, "\nIncorrect number of nodes in file %s\n", fileName);
+    exit (1);
+  }
+  if (graph->numberArcs <= 0) {
+    fprintf (stderr, "\nIncorrect number of arcs in file %s\n", fileName);
+    exit (1);
+  }
+  graph->node  = malloc (sizeof (graph->node[0])*graph->numberNodes);
+  graph->arc   = malloc (sizeof (graph->arc[0])*graph->numberArcs);
+  graph->arcIn = malloc (sizeof ((graph->arcIn)[0])*graph->numberArcs);
+  if (graph->node == NULL || graph->arc == NULL || graph->arcIn == NULL) {
+    perror("Not enough memory to load graph\n");
+    exit(1);
+  }
+  /* Binary graphs have no s and t lines */
+  graph->initialNode = graph->finalNode = NULL;
+
+  for (node = graph->node, nodeName = 1; nodeName <= graph->numberNodes;
+       node++, nodeName++) {
+    node->name          = nodeName;
+    node->firstArcOut   = graph->arc + file->rowPtr[nodeName - 1];
+    node->numberArcsOut = file->rowPtr[nodeName] - file->rowPtr[nodeName - 1];
+    node->numberArcsIn  = 0;
+  }
+  for (arc = graph->arc, numberArcs = 0; numberArcs < graph->numberArcs;
+       arc++, numberArcs++)
+    graph->node[file->colIdx[numberArcs]].numberArcsIn++;
+
+  numberArcs = 0;
+  for (node = graph->node, nodeName = 1; nodeName <= graph->numberNodes;
+       node++, nodeName++) {
+    node->firstArcIn = graph->arcIn + numberArcs;
+    numberArcs += node->numberArcsIn;
+    node->numberArcsIn = 0;
+  }
+  for (node = graph->node, nodeName = 1; nodeName <= graph->numberNodes;
+       node++, nodeName++)
+    for (arc = node->firstArcOut; arc < node->firstArcOut + node->numberArcsOut;
+         arc++) {
+      dest = graph->node + file->colIdx[arc - graph->arc];
+      arc->source = node;
+      arc->dest   = dest;
+      arc->cost   = csrWeight (file, arc - graph->arc);
+      dest->firstArcIn[dest->numberArcsIn++] = arc;
+    }
+  csrClose (file);
+}
+
 /*============================================================================*/
 void LoadGraph(Graph *graph, char *fileName) {
   /* Reads a (multi)graph from file in time O(number of arcs) */
@@ -62,6 +124,10 @@ void LoadGraph(Graph *graph, char *fileName) {
   PtrArc *ptrArc;
 #endif
 
+  if (csrIsBinary (fileName)) {
+    LoadBinaryGraph (graph, fileName);
+    return;
+  }
   if ((file = fopen (fileName, "r")) == NULL) {
     perror ("Graph file does not exist");
     exit (1);
@@ -95,11 +161,15 @@ void LoadGraph(Graph *graph, char *fileName) {
     fprintf (stderr, "\nIncorrect number of arcs in file %s\n", fileName);
     exit (1);
   }
-  if (initialNodeName <= 0 || initialNodeName > graph->numberNodes) {
+  /* The initial and final nodes may be omitted (-1) when the queries are */
+  /* given apart from the graph (see batch.h)                             */
+  if (initialNodeName == 0 || initialNodeName < -1 ||
+      initialNodeName > graph->numberNodes) {
     fprintf (stderr, "\nIncorrect initial node in file %s\n", fileName);
     exit (1);
   }
-  if (finalNodeName <= 0 || finalNodeName > graph->numberNodes) {
+  if (finalNodeName == 0 || finalNodeName < -1 ||
+      finalNodeName > graph->numberNodes) {
     fprintf (stderr, "\nIncorrect final node in file %s\n", fileName);
     exit (1);
   }
@@ -129,20 +199,19 @@ void LoadGraph(Graph *graph, char *fileName) {
   }
   
   /* Sets the pointers to the initial and final nodes */
-  graph->finalNode   = graph->node + (finalNodeName - 1);
-  graph->initialNode = graph->node + (initialNodeName - 1);
+  graph->finalNode   = (finalNodeName == -1) ? NULL :
+                       graph->node + (finalNodeName - 1);
+  graph->initialNode = (initialNodeName == -1) ? NULL :
+                       graph->node + (initialNodeName - 1);
   
   
-  /* Initializes for each node the counters of input and output arcs, */
-  /* the heap of candidate paths, the best path and the node name     */
+  /* Initializes for each node the counters of input and output arcs */
+  /* and the node name                                                */
   for (node = graph->node, nodeName = 1; nodeName <= graph->numberNodes;
        node++, nodeName++) {
     node->numberArcsIn       = 0;
     node->numberArcsOut      = 0;
     node->name               = nodeName;
-    node->bestPath           = CreatePath (node, NULL, INFINITY_COST);
-    node->bestPath->nextPath = NULL;
-    node->heap.elt           = NULL;
   }
 
   /* Scans the file looking for arcs and counts incoming and outgoing arcs */
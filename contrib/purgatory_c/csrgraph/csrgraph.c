@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csrgraph.h"
+
+#define ALIGN8(x)	(((x) + 7) & ~(size_t) 7)
+
+static void fail(const char *fname, const char *msg) {
+	fprintf(stderr, "Error: %s: %s\n", fname, msg);
+	exit(1);
+}
+
+int csrIsBinary(const char *fname) {
+	char magic[8];
+	FILE *f = fopen(fname, "rb");
+	int ok;
+
+	if (f == NULL)
+		return 0;
+	ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, CSRG_MAGIC, 8) == 0;
+	fclose(f);
+	return ok;
+}
+
+CSRFile *csrOpen(const char *fname) {
+	CSRFile *g;
+	CSRHeader *h;
+	struct stat st;
+	size_t off, need;
+	const char *base;
+	uint64_t i;
+	int fd;
+
+	if ((fd = open(fname, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+		fail(fname, strerror(errno));
+	if ((size_t) st.st_size < sizeof(CSRHeader))
+		fail(fname, "not a binary graph");
+	g = malloc(sizeof(CSRFile));
+	if (g == NULL)
+		fail(fname, "not enough memory");
+	g->mapSize = st.st_size;
+	g->map = mmap(NULL, g->mapSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (g->map == MAP_FAILED)
+		fail(fname, strerror(errno));
+
+	h = g->map;
+	base = g->map;
+	if (memcmp(h->magic, CSRG_MAGIC, 8) != 0)
+		fail(fname, "not a binary graph");
+	if (h->version != CSRG_VERSION)
+		fail(fname, "unsupported version (or byte order)");
+	if (h->n >= (uint64_t) 1 << 31 || h->m >= (uint64_t) 1 << 31)
+		fail(fname, "graph too large");
+	g->n = (int) h->n;
+	g->m = (int) h->m;
+	g->directed = (h->flags & CSRG_DIRECTED) != 0;
+
+	/* locate the sections, checking that they fit in the file */
+	off = sizeof(CSRHeader);
+	need = off + (h->n + 1) * 8 + ALIGN8(h->m * 4);
+	if (h->flags & CSRG_WEIGHTED)
+		need += ALIGN8(h->m * 4);
+	if (h->flags & CSRG_NAMED)
+		need += (h->n + 1) * 8 + h->namesSize;
+	if (need > g->mapSize)
+		fail(fname, "truncated file");
+	g->rowPtr = (const uint64_t *) (base + off);
+	off += (h->n + 1) * 8;
+	g->colIdx = (const uint32_t *) (base + off);
+	off += ALIGN8(h->m * 4);
+	g->weight = NULL;
+	if (h->flags & CSRG_WEIGHTED) {
+		g->weight = (const float *) (base + off);
+		off += ALIGN8(h->m * 4);
+	}
+	g->nameOff = NULL;
+	g->names = NULL;
+	if (h->flags & CSRG_NAMED) {
+		g->nameOff = (const uint64_t *) (base + off);
+		off += (h->n + 1) * 8;
+		g->names = base + off;
+		if (h->namesSize == 0 || g->names[h->namesSize - 1] != '\0')
+			fail(fname, "corrupted name table");
+	}
+
+	/* the loaders index arrays with these, check them once here */
+	if (g->rowPtr[0] != 0 || g->rowPtr[h->n] != h->m)
+		fail(fname, "corrupted row pointers");
+	for (i = 0; i < h->n; ++i)
+		if (g->rowPtr[i] > g->rowPtr[i + 1])
+			fail(fname, "corrupted row pointers");
+	for (i = 0; i < h->m; ++i)
+		if (g->colIdx[i] >= h->n)
+			fail(fname, "arc target out of range");
+	if (g->nameOff != NULL)
+		for (i = 0; i < h->n; ++i)
+			if (g->nameOff[i] >= h->namesSize)
+				fail(fname, "corrupted name table");
+	return g;
+}
+
+void csrClose(CSRFile *g) {
+	munmap(g->map, g->mapSize);
+	free(g);
+}
+
+float csrWeight(const CSRFile *g, long e) {
+	return g->weight == NULL ? 1 : g->weight[e];
+}
+
+const char *csrName(const CSRFile *g, int i) {
+	return g->nameOff == NULL ? NULL : g->names + g->nameOff[i];
+}
+
+int csrWrite(const char *fname, int n, int directed, const long *rowPtr,
+	const int *colIdx, const float *weight, char **names) {
+	CSRHeader h;
+	FILE *f;
+	uint64_t u;
+	uint32_t v;
+	long e, m = rowPtr[n];
+	int i, err = 0;
+
+	if ((f = fopen(fname, "wb")) == NULL)
+		return -1;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CSRG_MAGIC, 8);
+	h.version = CSRG_VERSION;
+	h.flags = (directed ? CSRG_DIRECTED : 0) | (weight ? CSRG_WEIGHTED : 0)
+		| (names ? CSRG_NAMED : 0);
+	h.n = n;
+	h.m = m;
+	if (names != NULL)
+		for (i = 0; i < n; ++i)
+			h.namesSize += strlen(names[i]) + 1;
+	err |= fwrite(&h, sizeof(h), 1, f) != 1;
+	for (i = 0; i <= n; ++i) {
+		u = rowPtr[i];
+		err |= fwrite(&u, 8, 1, f) != 1;
+	}
+	for (e = 0; e < m; ++e) {
+		v = colIdx[e];
+		err |= fwrite(&v, 4, 1, f) != 1;
+	}
+	/* sections are padded to 8 bytes */
+	if (m % 2)
+		err |= fwrite("\0\0\0\0", 1, 4, f) != 4;
+	if (weight != NULL) {
+		err |= fwrite(weight, 4, m, f) != (size_t) m;
+		if (m % 2)
+			err |= fwrite("\0\0\0\0", 1, 4, f) != 4;
+	}
+	if (names != NULL) {
+		for (i = 0, u = 0; i <= n; ++i) {
+			err |= fwrite(&u, 8, 1, f) != 1;
+			if (i < n)
+				u += strlen(names[i]) + 1;
+		}
+		for (i = 0; i < n; ++i)
+			err |= fwrite(names[i], 1, strlen(names[i]) + 1, f) != strlen(names[i]) + 1;
+	}
+	if (fclose(f) != 0)
+		err = 1;
+	return err ? -1 : 0;
+}
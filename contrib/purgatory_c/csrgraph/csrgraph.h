@@ -0,0 +1,75 @@
+#ifndef CSRGRAPH_H
+#define CSRGRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+	Binary graph file shared by the graph tools (kwalks, REA,
+	floydwarshall), in compressed sparse row (CSR) layout.  All the
+	integers are little-endian and every section starts on an 8-byte
+	boundary, so that the file can be mapped in memory and used as is:
+
+	header          64 bytes (CSRHeader)
+	rowPtr[n+1]     uint64, arcs leaving node i: rowPtr[i] .. rowPtr[i+1]-1
+	colIdx[m]       uint32, arc targets
+	weight[m]       float, only if CSRG_WEIGHTED (all weights 1 otherwise)
+	nameOff[n+1]    uint64, only if CSRG_NAMED: name of node i at
+	names[]         names + nameOff[i], NUL-terminated
+
+	Nodes are numbered from 0.  Undirected graphs hold each edge in both
+	directions, CSRG_DIRECTED only tells how the graph was given.
+*/
+
+#define CSRG_MAGIC	"CSRGRAPH"
+#define CSRG_VERSION	1
+
+#define CSRG_DIRECTED	1
+#define CSRG_WEIGHTED	2
+#define CSRG_NAMED	4
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t n;		/* number of nodes */
+	uint64_t m;		/* number of arcs */
+	uint64_t namesSize;	/* bytes in names[] */
+	uint64_t reserved[3];
+} CSRHeader;
+
+/* A graph file mapped in memory */
+typedef struct {
+	int n;
+	int m;
+	int directed;
+	const uint64_t *rowPtr;
+	const uint32_t *colIdx;
+	const float *weight;	/* NULL if unweighted */
+	const uint64_t *nameOff;	/* NULL if unnamed */
+	const char *names;
+	void *map;
+	size_t mapSize;
+} CSRFile;
+
+/* 1 if fname starts with the magic of a binary graph */
+int csrIsBinary(const char *fname);
+
+/* Maps a binary graph, exits with a message if it is not valid */
+CSRFile *csrOpen(const char *fname);
+void csrClose(CSRFile *f);
+
+/* Weight of arc e, 1 in unweighted graphs */
+float csrWeight(const CSRFile *f, long e);
+
+/* Name of node i, NULL in unnamed graphs */
+const char *csrName(const CSRFile *f, int i);
+
+/*
+	Writes a graph given in CSR form (weight and names may be NULL).
+	Returns 0, or -1 with errno set.
+*/
+int csrWrite(const char *fname, int n, int directed, const long *rowPtr,
+	const int *colIdx, const float *weight, char **names);
+
+#endif
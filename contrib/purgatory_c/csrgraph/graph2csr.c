@@ -0,0 +1,430 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <search.h>
+
+#include "csrgraph.h"
+
+/*
+	Converts the text graph formats of the graph tools into the binary
+	CSR format (csrgraph.h), or describes a binary graph.
+
+	kwalks  first line "n", then lines "from to:weight to:weight ..."
+	        (sparse) or the n x n matrix (dense), nodes numbered from 1
+	rea     lines "n N", "m M", "a SOURCE DEST WEIGHT", nodes numbered
+	        from 1 (s and t lines are ignored)
+	matrix  floydwarshall matrix: n, directed flag, n x n weights
+	        (0: no arc, the diagonal is ignored)
+	edges   floydwarshall edge list: n, directed flag, "source target
+	        [weight]" with nodes numbered from 0
+	names   one arc per line "source target [weight]" with node names,
+	        numbered in order of appearance (use -undirected for edges)
+*/
+
+typedef struct {
+	int n;
+	int directed;
+	long m, cap;
+	int *src, *dst;
+	float *w;
+	int weighted;
+	char **names;
+} Arcs;
+
+void usage() {
+	printf("Usage: graph2csr -from kwalks|rea|matrix|edges|names [-undirected]\n");
+	printf("                 [-names FILE] -o OUTPUT INPUT\n");
+	printf("       graph2csr -info [-names] GRAPH\n");
+	printf("Converts a text graph into the binary CSR graph format read by\n");
+	printf("lkwalk, REA and floydwarshall. -names gives a file with one node\n");
+	printf("name per line. -info describes a binary graph (and lists the\n");
+	printf("node names with -names).\n");
+}
+
+static void *xmalloc(size_t size) {
+	void *p = malloc(size);
+	if (p == NULL && size > 0) {
+		fprintf(stderr, "Error: not enough memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static char *xstrdup(const char *s) {
+	return strcpy(xmalloc(strlen(s) + 1), s);
+}
+
+static void addArc(Arcs *a, long s, long d, double x) {
+	if (s < 0 || s >= a->n || d < 0 || d >= a->n) {
+		fprintf(stderr, "Error: node out of range in arc %ld %ld\n", s, d);
+		exit(1);
+	}
+	if (a->m == a->cap) {
+		a->cap = a->cap ? 2 * a->cap : 1024;
+		a->src = realloc(a->src, a->cap * sizeof(int));
+		a->dst = realloc(a->dst, a->cap * sizeof(int));
+		a->w = realloc(a->w, a->cap * sizeof(float));
+		if (a->src == NULL || a->dst == NULL || a->w == NULL) {
+			fprintf(stderr, "Error: not enough memory\n");
+			exit(1);
+		}
+	}
+	a->src[a->m] = (int) s;
+	a->dst[a->m] = (int) d;
+	a->w[a->m++] = (float) x;
+	if (x != 1)
+		a->weighted = 1;
+}
+
+/* Reads the next blank-separated word of the file, returns 0 at end of file */
+static int readWord(FILE *fin, char *buf, int size) {
+	int c, len = 0;
+
+	while ((c = getc(fin)) != EOF && isspace(c))
+		;
+	while (c != EOF && !isspace(c)) {
+		if (len < size - 1)
+			buf[len++] = c;
+		c = getc(fin);
+	}
+	buf[len] = '\0';
+	return len > 0;
+}
+
+static double readNumber(FILE *fin, const char *what) {
+	char buf[64];
+
+	if (!readWord(fin, buf, sizeof(buf))) {
+		fprintf(stderr, "Error: %s expected\n", what);
+		exit(1);
+	}
+	return strtod(buf, NULL);
+}
+
+/* lines can be long in the sparse kwalks format */
+static char *readLine(FILE *fin, char **line, size_t *size) {
+	size_t len = 0;
+
+	if (*line == NULL) {
+		*size = 4096;
+		*line = xmalloc(*size);
+	}
+	while (fgets(*line + len, *size - len, fin) != NULL) {
+		len += strlen(*line + len);
+		if (len > 0 && (*line)[len - 1] == '\n')
+			return *line;
+		*size *= 2;
+		*line = realloc(*line, *size);
+		if (*line == NULL) {
+			fprintf(stderr, "Error: not enough memory\n");
+			exit(1);
+		}
+	}
+	return len > 0 ? *line : NULL;
+}
+
+static void readKwalks(FILE *fin, Arcs *a) {
+	char *line = NULL, *tok, *colon, word[64];
+	size_t size;
+	long from, i, j;
+	float x;
+	int sparse;
+
+	if (readLine(fin, &line, &size) == NULL) {
+		fprintf(stderr, "Error: empty graph file\n");
+		exit(1);
+	}
+	/* several numbers on the first line: dense format */
+	strtok(line, " \t\n");
+	sparse = strtok(NULL, " \t\n") == NULL;
+	a->directed = 1;
+	if (sparse) {
+		a->n = atoi(line);
+		while (readLine(fin, &line, &size) != NULL) {
+			if ((tok = strtok(line, " \t\n")) == NULL)
+				continue;
+			from = atol(tok) - 1;
+			while ((tok = strtok(NULL, " \t\n")) != NULL) {
+				if ((colon = strchr(tok, ':')) == NULL) {
+					fprintf(stderr, "Error: to:weight expected in row %ld\n", from + 1);
+					exit(1);
+				}
+				addArc(a, from, atol(tok) - 1, (float) atof(colon + 1));
+			}
+		}
+	} else {
+		/* the first line is the first row, count its entries */
+		rewind(fin);
+		readLine(fin, &line, &size);
+		for (a->n = 0, tok = strtok(line, " \t\n"); tok != NULL; tok = strtok(NULL, " \t\n"))
+			a->n++;
+		rewind(fin);
+		/* lkwalk reads these entries as floats */
+		for (i = 0; i < a->n; ++i)
+			for (j = 0; j < a->n; ++j) {
+				if (!readWord(fin, word, sizeof(word))) {
+					fprintf(stderr, "Error: matrix entry expected\n");
+					exit(1);
+				}
+				if ((x = strtof(word, NULL)) != 0)
+					addArc(a, i, j, x);
+			}
+	}
+	free(line);
+}
+
+static void readRea(FILE *fin, Arcs *a) {
+	char line[1024];
+	long s, d;
+	float x;
+
+	a->n = -1;
+	a->directed = 1;
+	while (fgets(line, sizeof(line), fin) != NULL) {
+		if (line[0] == 'n')
+			sscanf(line, "n%d", &a->n);
+		else if (line[0] == 'a') {
+			if (a->n < 0 || sscanf(line, "a%ld %ld %f", &s, &d, &x) != 3) {
+				fprintf(stderr, "Error in line:\n%s\n", line);
+				exit(1);
+			}
+			addArc(a, s - 1, d - 1, x);
+		}
+	}
+	/* REA keeps zero costs, so the weights are always stored */
+	a->weighted = 1;
+}
+
+static void readMatrix(FILE *fin, Arcs *a) {
+	long i, j;
+	double x;
+
+	a->n = (int) readNumber(fin, "number of nodes");
+	a->directed = (int) readNumber(fin, "directed flag");
+	for (i = 0; i < a->n; ++i)
+		for (j = 0; j < a->n; ++j) {
+			x = readNumber(fin, "matrix entry");
+			if (x != 0 && i != j)
+				addArc(a, i, j, x);
+		}
+}
+
+static void readEdges(FILE *fin, Arcs *a) {
+	char line[1024];
+	double s, d, x;
+	int nf;
+
+	a->n = (int) readNumber(fin, "number of nodes");
+	a->directed = (int) readNumber(fin, "directed flag");
+	while (fgets(line, sizeof(line), fin) != NULL) {
+		nf = sscanf(line, "%lf %lf %lf", &s, &d, &x);
+		if (nf < 2)
+			continue;
+		if (nf == 2)
+			x = 1;
+		if (x == 0 || s == d)
+			continue;
+		addArc(a, (long) s, (long) d, x);
+		if (!a->directed)
+			addArc(a, (long) d, (long) s, x);
+	}
+}
+
+/* Number of a node name, assigned in order of appearance */
+static long nodeNumber(Arcs *a, const char *name, int *cap) {
+	ENTRY e, *found;
+
+	e.key = (char *) name;
+	if ((found = hsearch(e, FIND)) != NULL)
+		return (long) found->data;
+	if (a->n == *cap) {
+		*cap *= 2;
+		a->names = realloc(a->names, *cap * sizeof(char *));
+		if (a->names == NULL) {
+			fprintf(stderr, "Error: not enough memory\n");
+			exit(1);
+		}
+	}
+	e.key = a->names[a->n] = xstrdup(name);
+	e.data = (void *) (long) a->n;
+	if (hsearch(e, ENTER) == NULL) {
+		fprintf(stderr, "Error: too many nodes\n");
+		exit(1);
+	}
+	return a->n++;
+}
+
+static void readNames(FILE *fin, Arcs *a, int undirected) {
+	char line[4096], s[1024], d[1024];
+	long is, id;
+	double x;
+	int nf, cap = 1024;
+
+	a->n = 0;
+	a->directed = !undirected;
+	a->names = xmalloc(cap * sizeof(char *));
+	if (hcreate(1 << 22) == 0) {
+		fprintf(stderr, "Error: not enough memory\n");
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fin) != NULL) {
+		if (line[0] == '#' || line[0] == ';')
+			continue;
+		nf = sscanf(line, "%1023s %1023s %lf", s, d, &x);
+		if (nf < 2)
+			continue;
+		if (nf == 2)
+			x = 1;
+		is = nodeNumber(a, s, &cap);
+		id = nodeNumber(a, d, &cap);
+		addArc(a, is, id, x);
+		if (undirected && is != id)
+			addArc(a, id, is, x);
+	}
+	hdestroy();
+}
+
+static void readNameFile(const char *fname, Arcs *a) {
+	FILE *fin;
+	char line[4096];
+	int i = 0;
+
+	if ((fin = fopen(fname, "r")) == NULL) {
+		fprintf(stderr, "Error: cannot open %s\n", fname);
+		exit(1);
+	}
+	a->names = xmalloc(a->n * sizeof(char *));
+	while (i < a->n && fgets(line, sizeof(line), fin) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+		a->names[i++] = xstrdup(line);
+	}
+	fclose(fin);
+	if (i < a->n) {
+		fprintf(stderr, "Error: %s has %d names for %d nodes\n", fname, i, a->n);
+		exit(1);
+	}
+}
+
+static void writeGraph(Arcs *a, const char *output) {
+	long *rowPtr = xmalloc((a->n + 1) * sizeof(long));
+	int *colIdx = xmalloc(a->m * sizeof(int));
+	float *w = xmalloc(a->m * sizeof(float));
+	long k, pos;
+	int i;
+
+	/* stable counting sort of the arcs by source */
+	memset(rowPtr, 0, (a->n + 1) * sizeof(long));
+	for (k = 0; k < a->m; ++k)
+		rowPtr[a->src[k] + 1]++;
+	for (i = 0; i < a->n; ++i)
+		rowPtr[i + 1] += rowPtr[i];
+	for (k = 0; k < a->m; ++k) {
+		pos = rowPtr[a->src[k]]++;
+		colIdx[pos] = a->dst[k];
+		w[pos] = a->w[k];
+	}
+	for (i = a->n; i > 0; --i)
+		rowPtr[i] = rowPtr[i - 1];
+	rowPtr[0] = 0;
+
+	if (csrWrite(output, a->n, a->directed, rowPtr, colIdx,
+			a->weighted ? w : NULL, a->names) != 0) {
+		fprintf(stderr, "Error: cannot write %s\n", output);
+		exit(1);
+	}
+	free(rowPtr);
+	free(colIdx);
+	free(w);
+}
+
+static void info(const char *fname, int listNames) {
+	CSRFile *g;
+	int i;
+
+	if (!csrIsBinary(fname)) {
+		fprintf(stderr, "Error: %s is not a binary graph\n", fname);
+		exit(1);
+	}
+	g = csrOpen(fname);
+	printf("nodes\t%d\n", g->n);
+	printf("arcs\t%d\n", g->m);
+	printf("directed\t%s\n", g->directed ? "yes" : "no");
+	printf("weighted\t%s\n", g->weight ? "yes" : "no");
+	printf("named\t%s\n", g->nameOff ? "yes" : "no");
+	if (listNames && g->nameOff != NULL)
+		for (i = 0; i < g->n; ++i)
+			printf("%d\t%s\n", i, csrName(g, i));
+	csrClose(g);
+}
+
+int main(int argc, char *argv[]) {
+	Arcs a;
+	FILE *fin;
+	char *from = NULL, *output = NULL, *input = NULL, *nameFile = NULL;
+	int undirected = 0, doInfo = 0, listNames = 0;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-from") == 0 && i + 1 < argc)
+			from = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else if (strcmp(argv[i], "-names") == 0 && (doInfo || i + 1 < argc)) {
+			if (doInfo)
+				listNames = 1;
+			else
+				nameFile = argv[++i];
+		} else if (strcmp(argv[i], "-undirected") == 0)
+			undirected = 1;
+		else if (strcmp(argv[i], "-info") == 0)
+			doInfo = 1;
+		else if (strcmp(argv[i], "-h") == 0) {
+			usage();
+			exit(0);
+		} else
+			input = argv[i];
+	}
+	if (input == NULL || (!doInfo && (from == NULL || output == NULL))) {
+		usage();
+		exit(1);
+	}
+	if (doInfo) {
+		info(input, listNames);
+		return 0;
+	}
+
+	if ((fin = fopen(input, "r")) == NULL) {
+		fprintf(stderr, "Error: cannot open %s\n", input);
+		exit(1);
+	}
+	memset(&a, 0, sizeof(a));
+	if (strcmp(from, "kwalks") == 0)
+		readKwalks(fin, &a);
+	else if (strcmp(from, "rea") == 0)
+		readRea(fin, &a);
+	else if (strcmp(from, "matrix") == 0)
+		readMatrix(fin, &a);
+	else if (strcmp(from, "edges") == 0)
+		readEdges(fin, &a);
+	else if (strcmp(from, "names") == 0)
+		readNames(fin, &a, undirected);
+	else {
+		fprintf(stderr, "Error: unknown input format %s\n", from);
+		exit(1);
+	}
+	fclose(fin);
+	if (a.n < 0) {
+		fprintf(stderr, "Error: number of nodes missing in %s\n", input);
+		exit(1);
+	}
+	if (nameFile != NULL) {
+		if (a.names != NULL) {
+			fprintf(stderr, "Error: -names cannot be used with -from names\n");
+			exit(1);
+		}
+		readNameFile(nameFile, &a);
+	}
+	writeGraph(&a, output);
+	return 0;
+}
@@ -1,142 +1,97 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-int n; /* The n number of nodes */
-int directed; /*Specifies whether the network is directed or not. In case it is not directed the shortest path from node A to node B is the same as the shortest path from B to A*/
-int size = 15000;
-float dist[15000][15000]; /* dist[i][j] is the length of the edge between i and j if
-			it exists, or 0 if it does not */
-int rev[15000][15000];
-
-void printDist() {
-	int i, j;
-	for (i = 0; i < n; ++i)
-	for (i = 0; i < n; ++i) {
-		for (j = 0; j < n; ++j)
-			printf("%.2f\t", dist[i][j]);
-		printf("\n");
-	}
-	printf("\n");
-}
-void printRev() {
-	int i, j;
-	printf("    ");
-	for (i = 0; i < n; ++i)
-		printf("%4c", 'A' + i);
-	printf("\n");
-	for (i = 0; i < n; ++i) {
-		printf("%4c", 'A' + i);
-		for (j = 0; j < n; ++j)
-		
-			printf("%4d", rev[i][j]);
-		printf("\n");
-	}
-	printf("\n");
-}
-
- /*ReconstructPath ( from vertex i to j )        # finds the path from i to j
-    If (shortest path from i to j represents the edge between them) Then
-        Return a path composed of i and j
-    Else
-        Let k be the intermediate vertex of the path from i to j
-        Return the path: [ ReconstructPath(i,k) ] concatenated with [ ReconstructPath(k,j) without first vertex k ]
-   End If*/
-   
-   
-void reconstructPath(int a, int b) {
-    if (rev[a][b] > 0) {
-      reconstructPath(a, rev[a][b]);
-      printf("%d,", rev[a][b]);
-      reconstructPath(rev[a][b], b);
-    }
-}
+#include "graph.h"
+#include "paths.h"
+#include "csrgraph.h"
 
 /*
-	floyd_warshall()
+	All shortest paths between the nodes of a network.
 
-	after calling this function dist[i][j] will the the minimum distance
-	between i and j if it exists (i.e. if there's a path between i and j)
-	or 0, otherwise
+	The graph is loaded in compressed sparse row form, from an adjacency
+	matrix (historical format), from an edge list or from a binary CSR
+	graph file.  Sparse graphs with
+	non-negative weights are solved by running Dijkstra from every
+	source, dense ones (or graphs with negative weights) by Floyd-Warshall.
+	Both are spread over several threads.
 */
-void floyd_warshall() {
-	int i, j, k;
-	
-	//setup variable
-    for(i=0; i<n; i++){
-        for(j=0; j<n; j++){
-            rev[i][j]=-1;
-        }//End for
-    }//End for
- 
-	
-	
-	
-	for (k = 0; k < n; ++k) {
-// 			printDist();
 
-		for (i = 0; i < n; ++i) {
-			for (j = 0; j < n; ++j) {
-				/* If i and j are different nodes and if 
-					the paths between i and k and between
-					k and j exist, do */
-				if ((dist[i][k] * dist[k][j] != 0) && (i != j)) {
-					/* See if you can't get a shorter path
-						between i and j by interspacing
-						k somewhere along the current
-						path */
-					if ((dist[i][k] + dist[k][j] < dist[i][j]) || (dist[i][j] == 0))  {
-						dist[i][j] = dist[i][k] + dist[k][j];
-						rev[i][j] = k;
-					}
-				}
-			}
-		}
-	}
+void usage() {
+	printf("Usage: floydwarshall [-edges] [-a auto|dijkstra|fw] [-t threads] input\n");
+	printf("The input file must be as follows\n");
+	printf("1st line : number of nodes in the network\n");
+	printf("2d  line : 1 if the graph is directed, 0 if it is not directed\n");
+	printf("3d->n+2 lines : The adjacency matrix with weights. 0 if no edge between two nodes\n");
+	printf("With -edges, the following lines are edges \"source target [weight]\"\n");
+	printf("(nodes numbered from 0, weight 1 by default).\n");
+	printf("Binary graphs made by graph2csr (see ../csrgraph) are recognized.\n");
+	printf("-a selects the algorithm (default auto: Dijkstra for sparse graphs\n");
+	printf("   without negative weights, Floyd-Warshall otherwise)\n");
+	printf("-t number of threads (default: number of processors)\n");
+}
 
+int main(int argc, char *argv[]) {
+	Graph *g;
+	FILE *fin;
+	char *algo = "auto";
+	char *input = NULL;
+	int edges = 0;
+	int nthreads = 0;
+	int i;
 
-	for (i = 0; i < n; ++i) {
-	  j = 0;
-	  if (directed == 0) {
-	    j = i+1;
-	  }
-	  for (; j < n; ++j) {
-	    if (j != i) {
-	      printf("%d %d ", i,j);
-	      if (dist[i][j] > 0) {
-	        printf ("%d,",i);
-	        reconstructPath(i,j);
-	        printf ("%d",j);
-	        printf (" %.2f", dist[i][j]);
-	      } else {
-	        printf ("No route");
-	      }
-	        printf ("\n");
-	    }
-	  }
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-edges") == 0) {
+			edges = 1;
+		} else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+			algo = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			nthreads = atoi(argv[++i]);
+		} else {
+			input = argv[i];
+		}
+	}
+	if (input == NULL) {
+		printf("One argument expected (input file).\n");
+		usage();
+		exit(0);
+	}
+	if (nthreads <= 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? (int) ncpu : 1;
 	}
-	
-}
 
-int main(int argc, char *argv[]) {
-        if( argc < 2 ) {
-          printf("One argument expected (input file).\n");
-          printf("The input file must be as follows\n");
-          printf("1st line : number of nodes in the network\n");
-          printf("2d  line : 1 if the graph is directed, 0 if it is not directed\n");
-          printf("3d->n+2 lines : The adjacency matrix with weights. 0 if no edge between two nodes\n");
-          exit(0);
-        }
-	FILE *fin = fopen(argv[1], "r");
-	fscanf(fin, "%d", &n);
-	fscanf(fin, "%d", &directed);
-	int i, j;
-	for (i = 0; i < n; ++i)
-		for (j = 0; j < n; ++j)
-			fscanf(fin, "%f", &dist[i][j]);
-	fclose(fin);
+	if (csrIsBinary(input)) {
+		g = readBinary(input);
+	} else {
+		if ((fin = fopen(input, "r")) == NULL) {
+			fprintf(stderr, "Error: cannot open %s\n", input);
+			exit(1);
+		}
+		g = edges ? readEdges(fin) : readMatrix(fin);
+		fclose(fin);
+	}
+	setvbuf(stdout, NULL, _IOFBF, 1 << 20);
 
-	floyd_warshall();
+	if (strcmp(algo, "auto") == 0) {
+		/* Dijkstra costs about n m log n, Floyd-Warshall n^3 */
+		algo = (!g->negative && (double) g->m < (double) g->n * g->n / 8)
+			? "dijkstra" : "fw";
+	}
+	if (strcmp(algo, "dijkstra") == 0) {
+		if (g->negative) {
+			fprintf(stderr, "Error: Dijkstra requires non-negative weights\n");
+			exit(1);
+		}
+		dijkstraAll(g, nthreads, stdout);
+	} else if (strcmp(algo, "fw") == 0) {
+		floydWarshall(g, nthreads, stdout);
+	} else {
+		fprintf(stderr, "Error: unknown algorithm %s\n", algo);
+		exit(1);
+	}
 
+	freeGraph(g);
 	return 0;
 }
-
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "graph.h"
+#include "csrgraph.h"
+
+void *xmalloc(size_t size) {
+	void *p = malloc(size);
+	if (p == NULL && size > 0) {
+		fprintf(stderr, "Error: not enough memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+/* Reads the next number of the file, returns 0 at end of file */
+static int readNumber(FILE *fin, double *x) {
+	char buf[64];
+	int c, len = 0;
+
+	while ((c = getc(fin)) != EOF && isspace(c))
+		;
+	while (c != EOF && !isspace(c)) {
+		if (len < (int) sizeof(buf) - 1)
+			buf[len++] = c;
+		c = getc(fin);
+	}
+	if (len == 0)
+		return 0;
+	buf[len] = '\0';
+	*x = strtod(buf, NULL);
+	return 1;
+}
+
+static Graph *newGraph(int n, int directed) {
+	Graph *g = xmalloc(sizeof(Graph));
+	memset(g, 0, sizeof(Graph));
+	g->n = n;
+	g->directed = directed;
+	g->ept = xmalloc((n + 1) * sizeof(int));
+	memset(g->ept, 0, (n + 1) * sizeof(int));
+	return g;
+}
+
+static void readHeader(FILE *fin, int *n, int *directed) {
+	double x;
+
+	if (!readNumber(fin, &x) || x < 0) {
+		fprintf(stderr, "Error: number of nodes expected\n");
+		exit(1);
+	}
+	*n = (int) x;
+	if (!readNumber(fin, &x)) {
+		fprintf(stderr, "Error: directed flag expected\n");
+		exit(1);
+	}
+	*directed = (int) x;
+}
+
+/*
+	Adjacency matrix format (the historical input of floydwarshall):
+	number of nodes, directed flag, then the n x n matrix of weights,
+	0 if there is no arc.  The matrix is never held densely: the non-zero
+	off-diagonal entries are appended row by row.
+*/
+Graph *readMatrix(FILE *fin) {
+	Graph *g;
+	int n, directed, i, j, cap;
+	double x;
+
+	readHeader(fin, &n, &directed);
+	g = newGraph(n, directed);
+	cap = 16 * n + 16;
+	g->adj = xmalloc(cap * sizeof(int));
+	g->w = xmalloc(cap * sizeof(float));
+	for (i = 0; i < n; ++i) {
+		g->ept[i] = g->m;
+		for (j = 0; j < n; ++j) {
+			if (!readNumber(fin, &x)) {
+				fprintf(stderr, "Error: adjacency matrix too short\n");
+				exit(1);
+			}
+			if (x == 0 || i == j)
+				continue;
+			if (g->m == cap) {
+				cap *= 2;
+				g->adj = realloc(g->adj, cap * sizeof(int));
+				g->w = realloc(g->w, cap * sizeof(float));
+				if (g->adj == NULL || g->w == NULL) {
+					fprintf(stderr, "Error: not enough memory\n");
+					exit(1);
+				}
+			}
+			g->adj[g->m] = j;
+			g->w[g->m] = (float) x;
+			if (x < 0)
+				g->negative = 1;
+			g->m++;
+		}
+	}
+	g->ept[n] = g->m;
+	return g;
+}
+
+/*
+	Edge list format: number of nodes, directed flag, then one arc per
+	line "source target [weight]", with nodes numbered from 0 and a
+	default weight of 1.  In undirected graphs each edge is added both
+	ways.
+*/
+Graph *readEdges(FILE *fin) {
+	Graph *g;
+	int n, directed, i, k, cap, ne, nf;
+	int *src, *dst;
+	float *wt;
+	double a, b, x;
+	char line[1024];
+
+	readHeader(fin, &n, &directed);
+	g = newGraph(n, directed);
+	cap = 1024;
+	ne = 0;
+	src = xmalloc(cap * sizeof(int));
+	dst = xmalloc(cap * sizeof(int));
+	wt = xmalloc(cap * sizeof(float));
+	while (fgets(line, sizeof(line), fin) != NULL) {
+		nf = sscanf(line, "%lf %lf %lf", &a, &b, &x);
+		if (nf < 2)
+			continue;
+		if (a < 0 || a >= n || b < 0 || b >= n) {
+			fprintf(stderr, "Error: node out of range in edge %g %g\n", a, b);
+			exit(1);
+		}
+		if (nf == 2)
+			x = 1;
+		if (x == 0 || a == b)
+			continue;
+		if (ne + 2 > cap) {
+			cap *= 2;
+			src = realloc(src, cap * sizeof(int));
+			dst = realloc(dst, cap * sizeof(int));
+			wt = realloc(wt, cap * sizeof(float));
+			if (src == NULL || dst == NULL || wt == NULL) {
+				fprintf(stderr, "Error: not enough memory\n");
+				exit(1);
+			}
+		}
+		src[ne] = (int) a;
+		dst[ne] = (int) b;
+		wt[ne++] = (float) x;
+		if (!directed) {
+			src[ne] = (int) b;
+			dst[ne] = (int) a;
+			wt[ne++] = (float) x;
+		}
+		if (x < 0)
+			g->negative = 1;
+	}
+
+	/* counting sort of the arcs by source */
+	g->m = ne;
+	g->adj = xmalloc(ne * sizeof(int));
+	g->w = xmalloc(ne * sizeof(float));
+	for (k = 0; k < ne; ++k)
+		g->ept[src[k] + 1]++;
+	for (i = 0; i < n; ++i)
+		g->ept[i + 1] += g->ept[i];
+	for (k = 0; k < ne; ++k) {
+		int pos = g->ept[src[k]]++;
+		g->adj[pos] = dst[k];
+		g->w[pos] = wt[k];
+	}
+	for (i = n; i > 0; --i)
+		g->ept[i] = g->ept[i - 1];
+	g->ept[0] = 0;
+	free(src);
+	free(dst);
+	free(wt);
+	return g;
+}
+
+/*
+	Binary CSR format (see csrgraph.h), mapped in memory and copied as
+	is.  The converter already dropped the zero weights and the diagonal
+	of adjacency matrices.
+*/
+Graph *readBinary(const char *fname) {
+	CSRFile *f = csrOpen(fname);
+	Graph *g = newGraph(f->n, f->directed);
+	int i, k;
+
+	g->m = f->m;
+	g->adj = xmalloc(g->m * sizeof(int));
+	g->w = xmalloc(g->m * sizeof(float));
+	for (i = 0; i <= g->n; ++i)
+		g->ept[i] = (int) f->rowPtr[i];
+	memcpy(g->adj, f->colIdx, g->m * sizeof(int));
+	for (k = 0; k < g->m; ++k) {
+		g->w[k] = csrWeight(f, k);
+		if (g->w[k] < 0)
+			g->negative = 1;
+	}
+	csrClose(f);
+	return g;
+}
+
+void freeGraph(Graph *g) {
+	free(g->ept);
+	free(g->adj);
+	free(g->w);
+	free(g);
+}
@@ -0,0 +1,27 @@
+#ifndef FW_GRAPH_H
+#define FW_GRAPH_H
+
+#include <stdio.h>
+
+/*
+	Weighted graph in compressed sparse row (CSR) layout: the arcs
+	leaving node i are adj[ept[i]] .. adj[ept[i+1]-1], with weights w[].
+	As in the adjacency matrix format, a weight of 0 means "no arc".
+*/
+typedef struct {
+	int n;		/* number of nodes */
+	int directed;	/* 0: each arc of an edge list is added both ways */
+	int m;		/* number of arcs */
+	int *ept;	/* n+1 row pointers */
+	int *adj;	/* m arc targets */
+	float *w;	/* m arc weights */
+	int negative;	/* some arc has a negative weight */
+} Graph;
+
+void *xmalloc(size_t size);
+Graph *readMatrix(FILE *fin);
+Graph *readEdges(FILE *fin);
+Graph *readBinary(const char *fname);
+void freeGraph(Graph *g);
+
+#endif
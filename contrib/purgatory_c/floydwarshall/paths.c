@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "paths.h"
+
+/* Growable output buffer, one per source in flight */
+typedef struct {
+	char *data;
+	size_t len, cap;
+} Buffer;
+
+static void bufferReserve(Buffer *b, size_t more) {
+	if (b->len + more <= b->cap)
+		return;
+	while (b->len + more > b->cap)
+		b->cap = (b->cap > 0) ? 2 * b->cap : 4096;
+	b->data = realloc(b->data, b->cap);
+	if (b->data == NULL) {
+		fprintf(stderr, "Error: not enough memory\n");
+		exit(1);
+	}
+}
+
+static void bufferInt(Buffer *b, int x, char sep) {
+	bufferReserve(b, 16);
+	b->len += sprintf(b->data + b->len, "%d%c", x, sep);
+}
+
+static void bufferString(Buffer *b, const char *s) {
+	size_t len = strlen(s);
+	bufferReserve(b, len);
+	memcpy(b->data + b->len, s, len);
+	b->len += len;
+}
+
+static void bufferDist(Buffer *b, float d) {
+	bufferReserve(b, 48);
+	b->len += sprintf(b->data + b->len, " %.2f\n", d);
+}
+
+/*============================================================================
+	Repeated Dijkstra
+============================================================================*/
+
+/* Binary min-heap of nodes keyed by dist[], with positions for decrease-key */
+typedef struct {
+	int *node;
+	int *pos;	/* position of a node in the heap, -1 if absent */
+	int size;
+	float *key;
+} Heap;
+
+static void heapUp(Heap *h, int p) {
+	int v = h->node[p];
+	while (p > 0) {
+		int q = (p - 1) / 2;
+		if (h->key[h->node[q]] <= h->key[v])
+			break;
+		h->node[p] = h->node[q];
+		h->pos[h->node[p]] = p;
+		p = q;
+	}
+	h->node[p] = v;
+	h->pos[v] = p;
+}
+
+static void heapDown(Heap *h, int p) {
+	int v = h->node[p];
+	for (;;) {
+		int q = 2 * p + 1;
+		if (q >= h->size)
+			break;
+		if (q + 1 < h->size && h->key[h->node[q + 1]] < h->key[h->node[q]])
+			q++;
+		if (h->key[v] <= h->key[h->node[q]])
+			break;
+		h->node[p] = h->node[q];
+		h->pos[h->node[p]] = p;
+		p = q;
+	}
+	h->node[p] = v;
+	h->pos[v] = p;
+}
+
+static int heapPop(Heap *h) {
+	int v = h->node[0];
+	h->pos[v] = -1;
+	if (--h->size > 0) {
+		h->node[0] = h->node[h->size];
+		heapDown(h, 0);
+	}
+	return v;
+}
+
+static void heapPush(Heap *h, int v) {
+	if (h->pos[v] < 0) {
+		h->node[h->size] = v;
+		heapUp(h, h->size++);
+	} else {
+		heapUp(h, h->pos[v]);
+	}
+}
+
+/* Per-thread workspace */
+typedef struct {
+	float *dist;
+	int *pred;
+	char *seen;
+	int *path;
+	Heap heap;
+} Workspace;
+
+static void dijkstra(Graph *g, int s, Workspace *ws) {
+	Heap *h = &ws->heap;
+	int i, k, v;
+
+	for (i = 0; i < g->n; ++i) {
+		ws->pred[i] = -1;
+		ws->seen[i] = 0;
+	}
+	ws->dist[s] = 0;
+	ws->seen[s] = 1;
+	h->size = 0;
+	heapPush(h, s);
+	while (h->size > 0) {
+		v = heapPop(h);
+		for (k = g->ept[v]; k < g->ept[v + 1]; ++k) {
+			int u = g->adj[k];
+			float d = ws->dist[v] + g->w[k];
+			if (!ws->seen[u] || d < ws->dist[u]) {
+				ws->seen[u] = 1;
+				ws->dist[u] = d;
+				ws->pred[u] = v;
+				heapPush(h, u);
+			}
+		}
+	}
+}
+
+static void printTree(Graph *g, int s, Workspace *ws, Buffer *b) {
+	int j, v, len;
+
+	for (j = g->directed ? 0 : s + 1; j < g->n; ++j) {
+		if (j == s)
+			continue;
+		bufferInt(b, s, ' ');
+		bufferInt(b, j, ' ');
+		if (ws->seen[j] && ws->dist[j] > 0) {
+			len = 0;
+			for (v = j; v != s; v = ws->pred[v])
+				ws->path[len++] = v;
+			bufferInt(b, s, ',');
+			while (--len > 0)
+				bufferInt(b, ws->path[len], ',');
+			bufferReserve(b, 16);
+			b->len += sprintf(b->data + b->len, "%d", j);
+			bufferDist(b, ws->dist[j]);
+		} else {
+			bufferString(b, "No route\n");
+		}
+	}
+}
+
+/*
+	Sources are handed out in order to the threads; at most "window"
+	sources are computed ahead of the one being printed, so that the
+	output comes in source order with bounded memory.
+*/
+typedef struct {
+	Graph *g;
+	int window;
+	int next;	/* next source to compute */
+	int printed;	/* next source to print */
+	Buffer *buf;
+	char *done;
+	pthread_mutex_t lock;
+	pthread_cond_t space;
+	pthread_cond_t ready;
+} Sources;
+
+static void *dijkstraWorker(void *arg) {
+	Sources *src = arg;
+	Graph *g = src->g;
+	Workspace ws;
+	int s, slot;
+
+	ws.dist = xmalloc(g->n * sizeof(float));
+	ws.pred = xmalloc(g->n * sizeof(int));
+	ws.seen = xmalloc(g->n);
+	ws.path = xmalloc(g->n * sizeof(int));
+	ws.heap.node = xmalloc(g->n * sizeof(int));
+	ws.heap.pos = xmalloc(g->n * sizeof(int));
+	ws.heap.key = ws.dist;
+	for (s = 0; s < g->n; ++s)
+		ws.heap.pos[s] = -1;
+
+	for (;;) {
+		pthread_mutex_lock(&src->lock);
+		while (src->next < g->n && src->next >= src->printed + src->window)
+			pthread_cond_wait(&src->space, &src->lock);
+		s = src->next++;
+		pthread_mutex_unlock(&src->lock);
+		if (s >= g->n)
+			break;
+
+		slot = s % src->window;
+		src->buf[slot].len = 0;
+		dijkstra(g, s, &ws);
+		printTree(g, s, &ws, &src->buf[slot]);
+
+		pthread_mutex_lock(&src->lock);
+		src->done[slot] = 1;
+		pthread_cond_broadcast(&src->ready);
+		pthread_mutex_unlock(&src->lock);
+	}
+	free(ws.dist);
+	free(ws.pred);
+	free(ws.seen);
+	free(ws.path);
+	free(ws.heap.node);
+	free(ws.heap.pos);
+	return NULL;
+}
+
+void dijkstraAll(Graph *g, int nthreads, FILE *out) {
+	Sources src;
+	pthread_t *threads;
+	int s, slot, t;
+
+	memset(&src, 0, sizeof(src));
+	src.g = g;
+	src.window = 4 * nthreads;
+	src.buf = xmalloc(src.window * sizeof(Buffer));
+	memset(src.buf, 0, src.window * sizeof(Buffer));
+	src.done = xmalloc(src.window);
+	memset(src.done, 0, src.window);
+	pthread_mutex_init(&src.lock, NULL);
+	pthread_cond_init(&src.space, NULL);
+	pthread_cond_init(&src.ready, NULL);
+
+	threads = xmalloc(nthreads * sizeof(pthread_t));
+	for (t = 0; t < nthreads; ++t)
+		pthread_create(&threads[t], NULL, dijkstraWorker, &src);
+	for (s = 0; s < g->n; ++s) {
+		slot = s % src.window;
+		pthread_mutex_lock(&src.lock);
+		while (!src.done[slot])
+			pthread_cond_wait(&src.ready, &src.lock);
+		pthread_mutex_unlock(&src.lock);
+		fwrite(src.buf[slot].data, 1, src.buf[slot].len, out);
+		pthread_mutex_lock(&src.lock);
+		src.done[slot] = 0;
+		src.printed++;
+		pthread_cond_broadcast(&src.space);
+		pthread_mutex_unlock(&src.lock);
+	}
+	for (t = 0; t < nthreads; ++t)
+		pthread_join(threads[t], NULL);
+
+	for (slot = 0; slot < src.window; ++slot)
+		free(src.buf[slot].data);
+	free(src.buf);
+	free(src.done);
+	free(threads);
+	pthread_mutex_destroy(&src.lock);
+	pthread_cond_destroy(&src.space);
+	pthread_cond_destroy(&src.ready);
+}
+
+/*============================================================================
+	Floyd-Warshall
+============================================================================*/
+
+/*
+	Blocked Floyd-Warshall.  The matrix is cut into BLOCK x BLOCK tiles
+	(its side is padded to a multiple of BLOCK); for each block of
+	intermediate nodes k, the diagonal tile is relaxed first, then the
+	tiles of its row and column, then all the others, which only read
+	the row and column tiles and can be relaxed independently.
+	A missing path is +inf, so the inner loop is a branch-free min-plus
+	over a row and vectorizes.  rev[i][j] is the last intermediate node
+	that shortened the path from i to j, or -1.
+*/
+#define BLOCK 64
+
+typedef struct {
+	int n;
+	size_t stride;	/* padded side of the matrix */
+	int nblocks;
+	float *dist;
+	int *rev;
+	int nthreads;
+	int arrived;	/* barrier */
+	int phase;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} Dense;
+
+typedef struct {
+	Dense *d;
+	int id;
+} Tiles;
+
+static void barrier(Dense *d) {
+	int phase;
+
+	pthread_mutex_lock(&d->lock);
+	phase = d->phase;
+	if (++d->arrived == d->nthreads) {
+		d->arrived = 0;
+		d->phase++;
+		pthread_cond_broadcast(&d->cond);
+	} else {
+		while (phase == d->phase)
+			pthread_cond_wait(&d->cond, &d->lock);
+	}
+	pthread_mutex_unlock(&d->lock);
+}
+
+/* GCC vector extensions; BLOCK and the row stride are multiples of 4 */
+typedef float v4sf __attribute__ ((vector_size (16)));
+typedef int v4si __attribute__ ((vector_size (16)));
+
+/*
+	Min-plus update of one row of a tile through node k, four columns at
+	a time.  In the diagonal tile di is dk when i == k, but dik is then 0
+	and nothing changes.
+*/
+static void relaxRow(float *di, int *ri, const float *dk, float dik, int k) {
+	v4sf vik = { dik, dik, dik, dik };
+	v4si vk = { k, k, k, k };
+	int j;
+
+	for (j = 0; j < BLOCK; j += 4) {
+		v4sf through = vik + *(const v4sf *) (dk + j);
+		v4sf cur = *(v4sf *) (di + j);
+		v4si shorter = through < cur;
+		v4si r = *(v4si *) (ri + j);
+		*(v4sf *) (di + j) = (v4sf) (((v4si) through & shorter) | ((v4si) cur & ~shorter));
+		*(v4si *) (ri + j) = (vk & shorter) | (r & ~shorter);
+	}
+}
+
+/* Relax tile (bi, bj) through the intermediate nodes of block bk */
+static void relaxTile(Dense *d, int bi, int bj, int bk) {
+	size_t n = d->stride;
+	int i0 = bi * BLOCK, j0 = bj * BLOCK, k0 = bk * BLOCK;
+	int i, k;
+
+	for (k = k0; k < k0 + BLOCK; ++k) {
+		const float *dk = d->dist + k * n + j0;
+		for (i = i0; i < i0 + BLOCK; ++i) {
+			float dik = d->dist[i * n + k];
+			if (dik != INFINITY)
+				relaxRow(d->dist + i * n + j0, d->rev + i * n + j0,
+					dk, dik, k);
+		}
+	}
+}
+
+static void *floydWarshallTiles(void *arg) {
+	Tiles *t = arg;
+	Dense *d = t->d;
+	int nb = d->nblocks;
+	int bk, b, c;
+
+	for (bk = 0; bk < nb; ++bk) {
+		if (t->id == 0)
+			relaxTile(d, bk, bk, bk);
+		barrier(d);
+		/* row and column of the diagonal tile */
+		for (b = t->id; b < 2 * nb; b += d->nthreads) {
+			if (b % nb == bk)
+				continue;
+			if (b < nb)
+				relaxTile(d, bk, b, bk);
+			else
+				relaxTile(d, b - nb, bk, bk);
+		}
+		barrier(d);
+		/* remaining tiles */
+		for (c = t->id; c < nb * nb; c += d->nthreads) {
+			if (c / nb == bk || c % nb == bk)
+				continue;
+			relaxTile(d, c / nb, c % nb, bk);
+		}
+		barrier(d);
+	}
+	return NULL;
+}
+
+static void reconstructPath(Dense *d, int a, int b, Buffer *out) {
+	int k = d->rev[a * d->stride + b];
+	if (k >= 0) {
+		reconstructPath(d, a, k, out);
+		bufferInt(out, k, ',');
+		reconstructPath(d, k, b, out);
+	}
+}
+
+void floydWarshall(Graph *g, int nthreads, FILE *out) {
+	Dense d;
+	Tiles *tiles;
+	pthread_t *threads;
+	Buffer row;
+	size_t n, cells, c;
+	int i, j, k, t;
+
+	memset(&d, 0, sizeof(d));
+	d.n = g->n;
+	d.nblocks = (g->n + BLOCK - 1) / BLOCK;
+	d.stride = n = (size_t) d.nblocks * BLOCK;
+	cells = n * n;
+	d.dist = xmalloc(cells * sizeof(float));
+	d.rev = xmalloc(cells * sizeof(int));
+	for (c = 0; c < cells; ++c) {
+		d.dist[c] = INFINITY;
+		d.rev[c] = -1;
+	}
+	for (i = 0; i < (int) n; ++i)
+		d.dist[i * n + i] = 0;
+	for (i = 0; i < g->n; ++i) {
+		for (k = g->ept[i]; k < g->ept[i + 1]; ++k) {
+			float *dij = &d.dist[i * n + g->adj[k]];
+			if (g->w[k] < *dij)
+				*dij = g->w[k];
+		}
+	}
+
+	if (nthreads > d.nblocks * d.nblocks)
+		nthreads = (d.nblocks > 0) ? d.nblocks * d.nblocks : 1;
+	d.nthreads = nthreads;
+	pthread_mutex_init(&d.lock, NULL);
+	pthread_cond_init(&d.cond, NULL);
+	tiles = xmalloc(nthreads * sizeof(Tiles));
+	threads = xmalloc(nthreads * sizeof(pthread_t));
+	for (t = 0; t < nthreads; ++t) {
+		tiles[t].d = &d;
+		tiles[t].id = t;
+		pthread_create(&threads[t], NULL, floydWarshallTiles, &tiles[t]);
+	}
+	for (t = 0; t < nthreads; ++t)
+		pthread_join(threads[t], NULL);
+	for (i = 0; i < g->n; ++i) {
+		if (d.dist[i * n + i] < 0) {
+			fprintf(stderr, "Error: the graph has a negative cycle through node %d\n", i);
+			exit(1);
+		}
+	}
+
+	memset(&row, 0, sizeof(row));
+	for (i = 0; i < g->n; ++i) {
+		row.len = 0;
+		for (j = g->directed ? 0 : i + 1; j < g->n; ++j) {
+			float dij = d.dist[i * n + j];
+			if (j == i)
+				continue;
+			bufferInt(&row, i, ' ');
+			bufferInt(&row, j, ' ');
+			if (dij != INFINITY) {
+				bufferInt(&row, i, ',');
+				reconstructPath(&d, i, j, &row);
+				bufferReserve(&row, 16);
+				row.len += sprintf(row.data + row.len, "%d", j);
+				bufferDist(&row, dij);
+			} else {
+				bufferString(&row, "No route\n");
+			}
+		}
+		fwrite(row.data, 1, row.len, out);
+	}
+
+	free(row.data);
+	free(d.dist);
+	free(d.rev);
+	free(tiles);
+	free(threads);
+	pthread_mutex_destroy(&d.lock);
+	pthread_cond_destroy(&d.cond);
+}
@@ -0,0 +1,20 @@
+#ifndef FW_PATHS_H
+#define FW_PATHS_H
+
+#include <stdio.h>
+
+#include "graph.h"
+
+/*
+	All-pairs shortest paths.  Both engines print, for each pair of
+	nodes (i < j in undirected graphs), a line "i j i,k1,...,j dist"
+	or "i j No route".
+*/
+
+/* Dijkstra from every source, sources spread over nthreads threads */
+void dijkstraAll(Graph *g, int nthreads, FILE *out);
+
+/* Blocked Floyd-Warshall on the dense matrix, tiles spread over nthreads threads */
+void floydWarshall(Graph *g, int nthreads, FILE *out);
+
+#endif
@@ -16,8 +16,331 @@
 /*               For details, see the file gpl-3.0.txt in this bundle    */
 /*************************************************************************/
 
+#include <pthread.h>
+
 #include "tools.h"
 
+/*Relevant groups handled by a run of the walkers*/
+typedef struct WalkJob{
+    CSRGraph* g;            /* Shared topology and transition probabilities */
+    int**     kgroups;
+    double**  kgprobas;     /* Normalized initial distributions */
+    double*   mass;         /* Initial mass of each group */
+    double*   pwlen;        /* Absorption probability of each group */
+    int       nbGroups;
+    int       nbTeams;
+    int       wlen;
+    int       upto;
+    int       undirected;
+    int       verbose;
+    int       step;         /* Distance between the kept lattice layers */
+    int       single;       /* Keep the lattice layers as floats */
+}WalkJob;
+
+/*Team of threads sharing the lattices of one group at a time. The groups
+  are dealt round-robin to the teams, the nodes are split among the members*/
+typedef struct WalkTeam{
+    WalkJob*          job;
+    CSRGraph*         g;    /* Walker view : absorbing states, ept, cur, diff */
+    Lattice*          latF;
+    Lattice*          latB;
+    double*           acc;  /* Per-edge passage mass (exact length mode) */
+    double*           accF; /* Per-node cumulated masses (up to mode) */
+    double*           accB;
+    int               id;
+    int               size;
+    pthread_barrier_t barrier;
+}WalkTeam;
+
+/*Member of a team, with its own node passage times*/
+typedef struct Walker{
+    WalkTeam* team;
+    int       rank;
+    double*   N;
+    double    expWlen;
+    pthread_t thread;
+}Walker;
+
+/*Make the layers c*step..(c+1)*step of a lattice available in its view.
+  The layers which are not kept are recomputed from the first layer of the
+  segment (forward lattice) or from the last one (backward lattice)*/
+static void loadSegment(Walker* w,Lattice* L,int c,int forward){
+    
+    WalkTeam* team = w->team;
+    CSRGraph* g    = team->g;
+    int       lo   = (int)((long)w->rank*g->m/team->size);
+    int       hi   = (int)((long)(w->rank+1)*g->m/team->size);
+    int       first = c*L->step;
+    int       last  = (first+L->step < L->wlen) ? first+L->step : L->wlen;
+    int       t,u;
+    
+    /*The team may still be reading the previous segment*/
+    pthread_barrier_wait(&team->barrier);
+    for(u=0;u<=last-first;u++){
+        t = forward ? first+u : last-u;
+        if(latticeKept(L,t))
+            L->view[t-first] = latticeLoad(L,t,L->buf[t-first],lo,hi);
+        else{
+            L->view[t-first] = L->buf[t-first];
+            if(forward)
+                latticeStepForward_sparse(L->view[t-first-1],L->view[t-first],g,lo,hi);
+            else
+                latticeStepBackward_sparse(L->view[t-first+1],L->view[t-first],g,lo,hi);
+        }
+        pthread_barrier_wait(&team->barrier);
+    }
+}
+
+/*Compute the expected passage times for the walks starting in group i*/
+static void walkGroup(Walker* w,int i){
+    
+    WalkTeam* team = w->team;
+    WalkJob*  job  = team->job;
+    CSRGraph* g    = team->g;
+    Lattice*  latF = team->latF;
+    Lattice*  latB = team->latB;
+    double*   acc  = team->acc;
+    double    mass_i = job->mass[i];
+    int       wlen = job->wlen;
+    int       step = job->step;
+    int*      kgroup = job->kgroups[i];
+    int       lo   = (int)((long)w->rank*g->m/team->size);
+    int       hi   = (int)((long)(w->rank+1)*g->m/team->size);
+    int       verbose = (w->rank == 0 && job->nbTeams == 1) ? job->verbose : 0;
+    int       segF = -1,segB = -1;
+    int       c,j,k,l,t,e,p;
+    double    p_wlen,cumul,tmp,update;
+    double    *prev,*next,*Ft,*Fp,*Bt;
+    
+    if(verbose > 0){
+        if(kgroup[0] == 1)
+            printf("Computing E[N(i,j) | Start in node %i]\n",kgroup[1]+1);
+        else    
+            printf("Computing E[N(i,j) | Start in group %i]\n",i+1);            
+    }    
+    
+    /*Set the absorbing states w.r.t group i*/
+    if(w->rank == 0)
+        setAbsStates_sparse(g,job->kgroups,job->nbGroups,i);
+    
+    /*Build the forward lattice from time 0, one layer at a time. The layers
+      which are not kept are computed in the two first segment buffers*/
+    prev = latticeLayer(latF,0,latF->buf[0]);
+    for(j=lo;j<hi;j++)
+        prev[j] = 0;
+    for(j=1;j<=kgroup[0];j++){
+        if(kgroup[j] >= lo && kgroup[j] < hi)
+            prev[kgroup[j]] = job->kgprobas[i][j];
+    }
+    latticeStore(latF,0,prev,lo,hi);
+    pthread_barrier_wait(&team->barrier);
+    if(verbose >= 2)
+        printf("Forward lattice  : 0");
+    for(k=1;k<=wlen;k++){
+        if(verbose >= 2 && k%10 == 0){
+            printf("...%i",k);
+            fflush(stdout);
+        }
+        next = latticeLayer(latF,k,latF->buf[k%2]);
+        latticeStepForward_sparse(prev,next,g,lo,hi);
+        latticeStore(latF,k,next,lo,hi);
+        pthread_barrier_wait(&team->barrier);
+        prev = next;
+    }
+    
+    /*Build the backward lattice from time wlen, accumulating the absorption
+      mass of the starting group*/
+    prev = latticeLayer(latB,wlen,latB->buf[wlen%2]);
+    for(j=lo;j<hi;j++)
+        prev[j] = g->absorbing[j] ? 1 : 0;
+    latticeStore(latB,wlen,prev,lo,hi);
+    pthread_barrier_wait(&team->barrier);
+    if(verbose >= 2)
+        printf("\nBackward lattice : ");
+    for(k=wlen,cumul=0;k>=1;k--){
+        if(verbose >= 2 && k%10 == 0){
+            printf("%i...",k);
+            fflush(stdout);
+        }               
+        next = latticeLayer(latB,k-1,latB->buf[(k-1)%2]);
+        latticeStepBackward_sparse(prev,next,g,lo,hi);
+        latticeStore(latB,k-1,next,lo,hi);
+        pthread_barrier_wait(&team->barrier);
+        for(j=1;j<=kgroup[0];j++)
+            cumul += job->kgprobas[i][j]*next[kgroup[j]];
+        prev = next;
+    }
+    if(verbose >= 2)
+        printf("0\n");
+    
+    /*LINEAR UPTO MODE*/
+    if(job->upto){
+        
+        /*Cumulated absorption mass */
+        p_wlen = cumul;
+        
+        /*Sweep the lattices layer by layer, accumulating the backward
+          and forward masses of each node from wlen-1 down to l*/
+        for(k=lo;k<hi;k++){
+            team->accB[k] = 0;
+            team->accF[k] = 0;
+        }
+        for(l=wlen-1;l>=0;l--){
+            /*Layers l and l-1 are in the same segment*/
+            c = (l > 0) ? (l-1)/step : 0;
+            if(c != segF){
+                loadSegment(w,latF,c,1);
+                segF = c;
+            }
+            if(c != segB){
+                loadSegment(w,latB,c,0);
+                segB = c;
+            }
+            Ft = latF->view[l-c*step];
+            Bt = latB->view[l-c*step];
+            Fp = (l > 0) ? latF->view[l-1-c*step] : NULL;
+            for(k=lo;k<hi;k++){
+                if(!g->absorbing[k]){
+                    team->accB[k] += Bt[k];
+                    team->accF[k] += Ft[k];
+                    if(l > 0){
+                        
+                       /************************/
+                       /*Transient to Transient*/
+                       /************************/
+                        
+                        for(p=g->colPtr[k];p<g->colPtr[k+1];p++){
+                            j = g->rowIdx[p];
+                            if(!g->absorbing[j]){
+                                e = g->colEdge[p];
+                                update = (mass_i*(g->colVal[p])*Fp[j]*team->accB[k])/p_wlen;
+                                g->cur[e]  += update;
+                                g->ept[e]  += update;
+                                w->expWlen += update;
+                                w->N[j]    += update;
+                            }
+                        }
+                    }
+                    else{
+                        
+                       /**************************/
+                       /*Absorbing from Transient*/
+                       /**************************/
+                        
+                        for(p=g->absPtr[k];p<g->absPtr[k+1];p++){
+                            e = g->absEdge[p];
+                            update = (mass_i*team->accF[k]*(g->val[e]))/p_wlen;
+                            g->cur[e]  += update;
+                            g->ept[e]  += update;
+                            w->expWlen += update;
+                            w->N[k]    += update;
+                        }                            
+                    }
+                }
+            }
+        }
+    }
+    /*EXACT LENGTH MODE*/
+    else{
+        /*Compute P[wlen] from the layer 0 of the backward lattice*/
+        for(p_wlen=0,l=1;l<=kgroup[0];l++){
+            p_wlen += job->kgprobas[i][l]*prev[kgroup[l]];
+        }
+        
+        if(verbose > 1)
+            printf("P[Absorption | Start in group %i] = %e\n",i+1,p_wlen);
+        
+        /*If there is a strictly positive proba, compute E[E(l,c)|wlen]*/
+        if(p_wlen > 0){
+            /*Accumulate, for each edge between transient nodes, the
+              passage mass over the lattice layers*/
+            for(e=g->rowPtr[lo];e<g->rowPtr[hi];e++)
+                acc[e] = 0;
+            for(t=0;t<wlen-1;t++){
+                /*Layers t and t+1 are in the same segment*/
+                c = t/step;
+                if(c != segF){
+                    loadSegment(w,latF,c,1);
+                    segF = c;
+                }
+                if(c != segB){
+                    loadSegment(w,latB,c,0);
+                    segB = c;
+                }
+                Ft = latF->view[t-c*step];
+                Bt = latB->view[t+1-c*step];
+                for(l=lo;l<hi;l++){
+                    if(!g->absorbing[l]){
+                        for(e=g->rowPtr[l];e<g->rowPtr[l+1];e++){
+                            if(!g->absorbing[g->colIdx[e]])
+                                acc[e] += Ft[l]*(g->val[e])*Bt[g->colIdx[e]];
+                        }
+                    }
+                }
+            }
+            c = (wlen-1)/step;
+            if(c != segF)
+                loadSegment(w,latF,c,1);
+            Ft = latF->view[wlen-1-c*step];
+            /*Iterate on "from" nodes*/
+            for(l=lo;l<hi;l++){
+                /*If l is not absorbing, compute E[N(l)|wlen]**/
+                if(!g->absorbing[l]){
+                    /*Iterate on the "to" nodes*/
+                    for(e=g->rowPtr[l];e<g->rowPtr[l+1];e++){
+                        if(!g->absorbing[g->colIdx[e]]){
+                            
+                            /*****************************/
+                            /*Transient destination nodes*/
+                            /*****************************/
+                            
+                            tmp = acc[e];
+                        }
+                        else{
+                            
+                            /*****************************/
+                            /*Absorbing destination nodes*/
+                            /*****************************/
+                            
+                            tmp = Ft[l]*(g->val[e]);
+                        }
+                        
+                        /*Update the expectation matrix*/
+                        update      = mass_i*tmp/p_wlen;
+                        g->cur[e]  += update;
+                        g->ept[e]  += update;
+                        w->N[l]    += update;
+                        w->expWlen += update;
+                    }/*End for(e)*/
+                }/*End if(non-absorbing from node)*/
+            }/*End for(from node)*/
+        }/*End if(P[wlen] > 0)*/
+    }/*End if(upto)*/
+    if(w->rank == 0)
+        job->pwlen[i] = p_wlen;
+    pthread_barrier_wait(&team->barrier);
+    
+    /*If the graph is undirected compute |E_ij - E_ji|*/
+    if(w->rank == 0){
+        if(job->undirected) diffEPT_sparse(g);
+        if(verbose > 0)
+            printf("-------------------------------------------------------\n");        
+    }
+    pthread_barrier_wait(&team->barrier);
+}
+
+/*Thread body : process the groups dealt to the team of the walker*/
+static void* walkerThread(void* arg){
+    
+    Walker* w = (Walker*)arg;
+    int     i;
+    
+    for(i=w->team->id;i<w->team->job->nbGroups;i+=w->team->job->nbTeams)
+        walkGroup(w,i);
+    
+    return NULL;
+}
+
 /*Function computing the limited k-walks*/
 int lkwalk (int argc, char* argv[]);
 
@@ -48,30 +371,30 @@ int lkwalk (int argc, char* argv[]){
     int       upto     = 0;
     int       genDot   = 0;
     int       verbose  = 2;
+    int       nbThreads = 1;
+    int       ckpt     = 0;
+    int       single   = 0;
     
   /*Working variables */
-    int         i,j,k,t,l;
+    int         i,j,k,t,l,e;
     int         undirected;
     int         start_cpu,stop_cpu;
     int         nnz,nnr;
 	int			inflatIter;
-    double      p_wlen;
-    double      tmp,accF,accB;
-    double      update;
-    double      mass_i   = 0;
+    double      tmp;
     double      mass_abs = 0;
     double      expWlen  = 0;
     double*     N;
-    double**    latF;
-    double**    latB;
     SparseDim*  rows;
     SparseDim*  cols;
-    SparseElem* selem;
-    Elem*       elem;
+    CSRGraph*   g;
+    WalkJob     job;
+    WalkTeam*   teams;
+    Walker*     walkers;
     DegStat     degStat;
 
   /*Scan the command line*/
-    while ((opt = getopt(argc,argv,"g:l:k:o:up:i:dv:h")) != EOF){
+    while ((opt = getopt(argc,argv,"g:l:k:o:up:i:dv:t:cfh")) != EOF){
         
         switch(opt){
             case 'g':
@@ -136,6 +459,15 @@ int lkwalk (int argc, char* argv[]){
                 vflg++;
                 verbose = atoi(optarg);
                 break;
+            case 't':
+                nbThreads = atoi(optarg);
+                break;
+            case 'c':
+                ckpt = 1;
+                break;
+            case 'f':
+                single = 1;
+                break;
             case 'h':
                 printHelpKwalk();
                 return EXIT_FAILURE;
@@ -157,6 +489,12 @@ int lkwalk (int argc, char* argv[]){
         return EXIT_FAILURE;
     }    
     
+    /*Check the number of threads*/
+    if(nbThreads < 1){
+        printf("The number of threads must be positive\n");
+        return EXIT_FAILURE;
+    }
+    
     /*Check if there is at least 2 relevant groups*/
     if(nbGroups < 2){
         printf("There must be at least two relevant nodes (in distinct groups)\n");
@@ -202,8 +540,31 @@ int lkwalk (int argc, char* argv[]){
             printf("WARNING: The initial probabilities does not sum up to 1\n");
     }
     
-    /*Get the number of nodes in the graph*/
-    nbNodes = readNbNodes(graphFname);
+    /*Read the graph, converting it to contiguous CSR/CSC arrays*/
+    if(csrIsBinary(graphFname)){
+        g       = readMat_binary(graphFname,&degStat);
+        nbNodes = g->m;
+        nbEdges = g->nnz;
+    }
+    else{
+        /*Get the number of nodes in the graph*/
+        nbNodes = readNbNodes(graphFname);
+        rows = malloc(sizeof(SparseDim)*nbNodes);
+        cols = malloc(sizeof(SparseDim)*nbNodes);
+        
+        /*Initialize the sparse transition matrix*/
+        init_SparseDims(rows,nbNodes);
+        init_SparseDims(cols,nbNodes);
+        
+        /*Read the adjacency matrix*/
+        nbEdges = readMat_sparse(graphFname,rows,cols,nbNodes,&degStat);    
+        
+        /*Convert it and drop the linked lists*/
+        g = sparseToCSR(rows,cols,nbNodes);
+        free_SparseDims(rows,nbNodes);
+        free(rows);
+        free(cols);
+    }
     
     /*Check if the relevant nodes are out of range*/
     for(i=0;i<nbGroups;i++){
@@ -216,23 +577,12 @@ int lkwalk (int argc, char* argv[]){
     }
 
     /*Allocate data structure*/
-    N    = vec_alloc(nbNodes);
-    latF = mat_alloc(nbNodes,wlen+1);
-    latB = mat_alloc(nbNodes,wlen+1);
-    rows = malloc(sizeof(SparseDim)*nbNodes);
-    cols = malloc(sizeof(SparseDim)*nbNodes);
-    
-    /*Initialize the sparse transition matrix*/
-    init_SparseDims(rows,nbNodes);
-    init_SparseDims(cols,nbNodes);
-    
-    /*Read the adjacency matrix*/
-    nbEdges    = readMat_sparse(graphFname,rows,cols,nbNodes,&degStat);    
+    N = vec_alloc(nbNodes);
 
-    undirected = isSymmetric_sparse(rows,cols,nbNodes);
+    undirected = isSymmetric_sparse(g);
 
     /*Make it stochastic*/
-    stochMat_sparse(rows,nbNodes);
+    stochMat_sparse(g);
     
     /*Print statistics about the graph*/
     if (verbose > 0){
@@ -245,8 +595,53 @@ int lkwalk (int argc, char* argv[]){
         printf("-------------------------------------------------------\n");
     }    
 
-    /*Initialize passage times in nodes*/
-    init_vec(N,nbNodes);
+    /*Set up the teams of walkers : one team per group at most, the
+      remaining threads help the teams on the lattice sweeps*/
+    job.g        = g;
+    job.kgroups  = kgroups;
+    job.kgprobas = kgprobas_stoch;
+    job.mass     = vec_alloc(nbGroups);
+    job.pwlen    = vec_alloc(nbGroups);
+    job.nbGroups = nbGroups;
+    job.nbTeams  = (nbThreads < nbGroups) ? nbThreads : nbGroups;
+    job.wlen     = wlen;
+    job.upto     = upto;
+    job.verbose  = verbose;
+    job.step     = 1;
+    job.single   = single;
+    /*Keep every sqrt(wlen)-th lattice layer*/
+    if(ckpt)
+        while(job.step*job.step < wlen)
+            job.step++;
+    teams   = malloc(job.nbTeams*sizeof(WalkTeam));
+    walkers = malloc(nbThreads*sizeof(Walker));
+    for(t=0;t<job.nbTeams;t++){
+        teams[t].job  = &job;
+        teams[t].g    = newWalkerView(g);
+        teams[t].latF = lattice_alloc(nbNodes,wlen,job.step,single);
+        teams[t].latB = lattice_alloc(nbNodes,wlen,job.step,single);
+        teams[t].acc  = vec_alloc(g->nnz);
+        teams[t].accF = vec_alloc(nbNodes);
+        teams[t].accB = vec_alloc(nbNodes);
+        teams[t].id   = t;
+        teams[t].size = nbThreads/job.nbTeams + (t < nbThreads%job.nbTeams);
+        pthread_barrier_init(&teams[t].barrier,NULL,teams[t].size);
+    }
+    for(t=0,k=0;t<job.nbTeams;t++){
+        for(l=0;l<teams[t].size;l++,k++){
+            walkers[k].team = &teams[t];
+            walkers[k].rank = l;
+            walkers[k].N    = vec_alloc(nbNodes);
+        }
+    }
+
+    if(verbose > 0 && (ckpt || single)){
+        tmp = (double)(wlen/job.step+2)*nbNodes*(single ? sizeof(float) : sizeof(double))
+            + (double)(job.step+1)*nbNodes*sizeof(double);
+        printf("Kept layers     : 1 out of %i (%s precision)\n",job.step,single ? "single" : "double");
+        printf("Lattice memory  : %.1f MB per team\n",2*tmp/(1024*1024));
+        printf("-------------------------------------------------------\n");
+    }
 
     /*Start the CPU chronometer*/
     start_cpu = clock();
@@ -263,153 +658,70 @@ int lkwalk (int argc, char* argv[]){
 		/*Reset and copy data for the inflation iteration*/
 		if(inflatIter > 0){
 			undirected = 0;
-			/*Reset variables*/
-		    mass_abs = 0.0;
-		    expWlen  = 0.0;
-			/*Reset passage times in nodes*/
-			init_vec(N,nbNodes);
 			/*Copy the expectation passage times on the edges on the edge values*/
-			copyForInflation(rows,undirected,nbNodes);
+			copyForInflation(g,undirected);
 			/*Stochastize the matrix*/
-			stochMat_sparse(rows,nbNodes);
+			stochMat_sparse(g);
 		}
-
-	    /*Loop on the relevant nodes*/
-	    for(i=0;i<nbGroups;i++){
-        
-	        if(verbose > 0){
-	            if(kgroups[i][0] == 1)
-	                printf("Computing E[N(i,j) | Start in node %i]\n",kgroups[i][1]+1);
-	            else    
-	                printf("Computing E[N(i,j) | Start in group %i]\n",i+1);            
-	        }    
-                
-	        /*Normalize the initial distribution*/
-			copy_mat(kgprobas,kgprobas_stoch,nbGroups,maxNPG+1); /*We take a copy of kgprobas otherwise it would change through inflation interations*/
-	        mass_i = stochVector(kgprobas_stoch[i]+1,kgprobas_stoch[i][0]);
-        
-	        /*Build the transition matrix w.r.t group i and set the starting states*/
-	        setAbsStates_sparse(rows,cols,nbNodes,kgroups,kgprobas_stoch,nbGroups,i);
-        
-	        /*Build the forward/backward lattices up to length wlen*/
-	        buildLatticeForward_sparse(latF,wlen,kgroups[i],kgprobas_stoch[i],cols,nbNodes,verbose);
-	 		buildLatticeBackward_sparse(latB,wlen,rows,nbNodes,verbose); 
-        
-	        /*LINEAR UPTO MODE*/
-	        if (upto){
 		
-				/*Compute the cumulated absorption mass */
-				p_wlen = cumulatedAbsorptionProba(latB,wlen,kgroups[i],kgprobas_stoch[i]);
-				mass_abs += mass_i*p_wlen;
+		/*Reset the passage times of the walkers*/
+		for(t=0;t<job.nbTeams;t++){
+			init_vec(teams[t].g->ept,g->nnz);
+			init_vec(teams[t].g->diff,g->nnz);
+		}
+		for(k=0;k<nbThreads;k++){
+			init_vec(walkers[k].N,nbNodes);
+			walkers[k].expWlen = 0;
+		}
 		
-	            for(k=0;k<nbNodes;k++){
-	                accB = 0;
-	                accF = 0;
-	                for(l=wlen-1;l>=0;l--){
-	                    if(!rows[k].absorbing){
-	                        accB += latB[k][l];
-	                        accF += latF[k][l];
-	                        if(l > 0){
-                            
-	                           /************************/
-	                           /*Transient to Transient*/
-	                           /************************/
-                            
-	                            selem = cols[k].first;
-	                            while (selem){
-	                                if(!cols[selem->l].absorbing){
-	                                    update = (mass_i*(selem->val)*latF[selem->l][l-1]*accB)/p_wlen;
-	                                    selem->cur   += update;
-	                                    selem->ept   += update;
-	                                    expWlen      += update;
-	                                    N[selem->l]  += update;
-	                                }
-	                                selem = selem->nextL;
-	                            }
-	                        }
-	                        else{
-                            
-	                           /**************************/
-	                           /*Absorbing from Transient*/
-	                           /**************************/
-                            
-	                            elem = rows[k].firstAbs;
-	                            while(elem){
-	                                update = (mass_i*accF*(elem->selem->val))/p_wlen;
-	                                elem->selem->cur  += update;
-	                                elem->selem->ept  += update;
-	                                expWlen           += update;
-	                                N[k]              += update;
-	                                elem = elem->next;
-	                            }                            
-	                        }
-	                    }
-	                }
-	            }
-	        }
-	        /*EXACT LENGTH MODE*/
-	        else{
-	            /*Compute P[wlen]*/
-	            for(p_wlen=0,l=1;l<=kgroups[i][0];l++){
-	                p_wlen += kgprobas_stoch[i][l]*latB[kgroups[i][l]][0];
-	            }
-	            mass_abs += mass_i*p_wlen;
-            
-	            if(verbose > 1)
-	                printf("P[Absorption | Start in group %i] = %e\n",i+1,p_wlen);
-            
-	            /*If there is a strictly positive proba, compute E[E(l,c)|wlen]*/
-	            if(p_wlen > 0){
-	                /*Iterate on "from" nodes*/
-	                for(l=0;l<nbNodes;l++){
-	                    /*If l is not absorbing, compute E[N(l)|wlen]**/
-	                    if(!rows[l].absorbing){
-	                        /*Iterate on the "to" nodes*/
-	                        selem = rows[l].first;
-	                        while(selem){
-	                            if(!rows[selem->c].absorbing){
-                                
-	                                /*****************************/
-	                                /*Transient destination nodes*/
-	                                /*****************************/
-                                
-	                                for(t=0,tmp=0;t<wlen-1;t++){
-	                                    tmp += latF[l][t]*(selem->val)*latB[selem->c][t+1];
-	                                }
-                                
-	                                /*Update the expectation matrix*/
-	                                update      = mass_i*tmp/p_wlen;
-	                                selem->cur += update;
-	                                selem->ept += update;
-	                                N[l]       += update;
-	                                expWlen    += update;
-	                            }
-	                            else{
-                                
-	                                /*****************************/
-	                                /*Absorbing destination nodes*/
-	                                /*****************************/
-                                
-	                                tmp = latF[l][wlen-1]*(selem->val);
-                                
-	                                /*Update the expectation matrix*/
-	                                update      = mass_i*tmp/p_wlen;
-	                                selem->cur += update;
-	                                selem->ept += update,
-	                                N[l]       += update;
-	                                expWlen    += update;
-	                            }
-	                            selem = selem->nextC;
-	                        }/*End while(selem)*/
-	                    }/*End if(non-absorbing from node)*/
-	                }/*End for(from node)*/
-	            }/*End if(P[wlen] > 0)*/
-	        }/*End if(upto)*/
-	        /*If the graph is undirected compute |E_ij - E_ji|*/
-	        if(undirected) diffEPT_sparse(rows,cols,nbNodes);
-	        if(verbose > 0)
-	            printf("-------------------------------------------------------\n");        
-	    }/*End for(relevant nodes)*/
+		/*Normalize the initial distributions*/
+		copy_mat(kgprobas,kgprobas_stoch,nbGroups,maxNPG+1); /*We take a copy of kgprobas otherwise it would change through inflation interations*/
+		for(i=0;i<nbGroups;i++)
+			job.mass[i] = stochVector(kgprobas_stoch[i]+1,kgprobas_stoch[i][0]);
+		job.undirected = undirected;
+		
+		/*Process the relevant groups*/
+		for(k=0;k<nbThreads;k++){
+			if(pthread_create(&walkers[k].thread,NULL,walkerThread,&walkers[k])){
+				fprintf(stderr,"could not create thread\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		for(k=0;k<nbThreads;k++)
+			pthread_join(walkers[k].thread,NULL);
+		
+		/*Groups processed concurrently are reported once all are done*/
+		if(verbose > 0 && job.nbTeams > 1){
+			for(i=0;i<nbGroups;i++){
+				if(kgroups[i][0] == 1)
+					printf("Computing E[N(i,j) | Start in node %i]\n",kgroups[i][1]+1);
+				else    
+					printf("Computing E[N(i,j) | Start in group %i]\n",i+1);            
+				if(verbose > 1 && !upto)
+					printf("P[Absorption | Start in group %i] = %e\n",i+1,job.pwlen[i]);
+				printf("-------------------------------------------------------\n");        
+			}
+		}
+		
+		/*Reduce the passage times of the teams and of the walkers*/
+		mass_abs = 0.0;
+		expWlen  = 0.0;
+		init_vec(N,nbNodes);
+		for(i=0;i<nbGroups;i++)
+			mass_abs += job.mass[i]*job.pwlen[i];
+		for(e=0;e<g->nnz;e++){
+			g->ept[e]  = 0.0;
+			g->diff[e] = 0.0;
+			for(t=0;t<job.nbTeams;t++){
+				g->ept[e]  += teams[t].g->ept[e];
+				g->diff[e] += teams[t].g->diff[e];
+			}
+		}
+		for(k=0;k<nbThreads;k++){
+			for(j=0;j<nbNodes;j++)
+				N[j] += walkers[k].N[j];
+			expWlen += walkers[k].expWlen;
+		}
 	}/*End for(inflation)*/	
 
     /*Stop the CPU chronometer*/
@@ -425,32 +737,32 @@ int lkwalk (int argc, char* argv[]){
     /*Write the EPT to output files*/
     if(oflg){
         writeVec_sparse(N,nbNodes,outNPT);
-        writeMEPT_sparse(outEPT,rows,nbNodes);
+        writeMEPT_sparse(outEPT,g);
     }
     
     /*Normalize the EPT by expWlen*/
     vecNormalize(N,nbNodes,expWlen);
-    matNormalize_sparse(rows,nbNodes,expWlen);
+    matNormalize_sparse(g,expWlen);
     
     /*Write to output files*/
     if(oflg){
         writeVec_sparse(N,nbNodes,outNPT_Norm);
-        writeMEPT_sparse(outEPT_Norm,rows,nbNodes);
+        writeMEPT_sparse(outEPT_Norm,g);
     }            
     
     /*If the graph is undirected write |E_ij - E_ji|*/
     if(undirected && oflg){
-        writeDiff_sparse(outDIF,rows,nbNodes);
+        writeDiff_sparse(outDIF,g);
     }    
     
     /*If required write a graphviz dot file*/
     if(genDot){
-        writeDot(outDOT,rows,nbNodes,undirected);
+        writeDot(outDOT,g,undirected);
     }    
     
     /*Display the relative size of the extracted subgraph*/
     if(verbose > 0){
-        matrixNNZ_sparse(rows,nbNodes,&nnz,&nnr);
+        matrixNNZ_sparse(g,&nnz,&nnr);
         printf("Subgraph size (#edges)          : %i\n",nnz);
         printf("Subgraph size (#nodes)          : %i\n",nnr);
         printf("Subgraph relative size (#edges) : %e\n",(float)nnz/(float)nbEdges);        
@@ -459,6 +771,23 @@ int lkwalk (int argc, char* argv[]){
 	printf("Last update by P. Dupont, UCL/ICTEAM/INGI 2010\n\n");
     }    
     
+    for(t=0;t<job.nbTeams;t++){
+        pthread_barrier_destroy(&teams[t].barrier);
+        free_WalkerView(teams[t].g);
+        free_Lattice(teams[t].latF);
+        free_Lattice(teams[t].latB);
+        free(teams[t].acc);
+        free(teams[t].accF);
+        free(teams[t].accB);
+    }
+    for(k=0;k<nbThreads;k++)
+        free(walkers[k].N);
+    free(teams);
+    free(walkers);
+    free(job.mass);
+    free(job.pwlen);
+    free_CSRGraph(g);
+
     /*Exit successfully :-)*/
     return EXIT_SUCCESS;
 }
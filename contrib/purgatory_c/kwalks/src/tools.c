@@ -252,7 +252,305 @@ void init_SparseDims(SparseDim* sdim,int dim1){
         sdim[i].firstAbs  = NULL;
         sdim[i].lastAbs   = NULL;        
     }    
-}    
+}
+
+/*Deallocate the elements of an array of SparseDim (rows and columns)*/
+void free_SparseDims(SparseDim* rows,int dim1){
+    int i;
+    SparseElem* selem;
+    Elem* elem;
+
+    /*The elements are shared by the rows and the columns, free them once*/
+    for(i=0;i<dim1;i++){
+        while(rows[i].first){
+            selem = rows[i].first;
+            rows[i].first = selem->nextC;
+            free(selem);
+        }
+        while(rows[i].firstAbs){
+            elem = rows[i].firstAbs;
+            rows[i].firstAbs = elem->next;
+            free(elem);
+        }
+        rows[i].last    = NULL;
+        rows[i].lastAbs = NULL;
+    }
+}
+
+/*Allocate a CSR/CSC graph with m nodes and nnz edges*/
+static CSRGraph* CSRGraph_alloc(int m,int nnz){
+    CSRGraph* g = malloc(sizeof(CSRGraph));
+
+    if(g==NULL) {
+        fprintf(stderr,"could not allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    g->m         = m;
+    g->nnz       = nnz;
+    g->rowPtr    = int_vec_alloc(m+1);
+    g->colIdx    = int_vec_alloc(nnz);
+    g->colPtr    = int_vec_alloc(m+1);
+    g->rowIdx    = int_vec_alloc(nnz);
+    g->colEdge   = int_vec_alloc(nnz);
+    g->colVal    = vec_alloc(nnz);
+    g->val       = vec_alloc(nnz);
+    g->ept       = vec_alloc(nnz);
+    g->cur       = vec_alloc(nnz);
+    g->diff      = vec_alloc(nnz);
+    g->rowSum    = vec_alloc(m);
+    g->absorbing = int_vec_alloc(m);
+    g->absPtr    = int_vec_alloc(m+1);
+    g->absEdge   = int_vec_alloc(1);
+    return g;
+}
+
+/*Convert the linked rows and columns into a CSR/CSC graph*/
+CSRGraph* sparseToCSR(SparseDim* rows,SparseDim* cols,int m){
+    int i,e,p;
+    int* edgeRow;
+    SparseElem* selem;
+    CSRGraph* g;
+    int nnz;
+
+    for(nnz=0,i=0;i<m;i++)
+        nnz += rows[i].nbElems;
+    g       = CSRGraph_alloc(m,nnz);
+    edgeRow = int_vec_alloc(g->nnz);
+
+    /*Rows, in the order of the lists. The edge number is kept in selem->l
+      while the columns are built*/
+    for(e=0,i=0;i<m;i++){
+        g->rowPtr[i] = e;
+        g->rowSum[i] = rows[i].sum;
+        for(selem=rows[i].first;selem;selem=selem->nextC,e++){
+            g->colIdx[e] = selem->c;
+            g->val[e]    = selem->val;
+            g->ept[e]    = selem->ept;
+            g->cur[e]    = selem->cur;
+            g->diff[e]   = selem->diff;
+            edgeRow[e]   = i;
+            selem->l     = e;
+        }
+    }
+    g->rowPtr[m] = e;
+
+    /*Columns, in the order of the lists*/
+    for(p=0,i=0;i<m;i++){
+        g->colPtr[i] = p;
+        for(selem=cols[i].first;selem;selem=selem->nextL,p++){
+            g->colEdge[p] = selem->l;
+            g->colVal[p]  = selem->val;
+            g->rowIdx[p]  = edgeRow[selem->l];
+        }
+    }
+    g->colPtr[m] = p;
+
+    /*Restore the row numbers in the lists*/
+    for(i=0;i<m;i++){
+        for(selem=rows[i].first;selem;selem=selem->nextC)
+            selem->l = i;
+    }
+    free(edgeRow);
+    return g;
+}
+
+/*Read a graph in the binary CSR format (see csrgraph.h). The columns are
+  filled in row order*/
+CSRGraph* readMat_binary(char* fname,DegStat* degStat){
+    int i,e,p,deg,sumDeg=0;
+    CSRFile*  f = csrOpen(fname);
+    CSRGraph* g = CSRGraph_alloc(f->n,f->m);
+    
+    /*Rows, with the degree statistics*/
+    degStat->minDeg  = g->m;
+    degStat->maxDeg  = 0;
+    for(i=0;i<g->m;i++){
+        g->rowPtr[i+1] = (int)f->rowPtr[i+1];
+        for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++){
+            g->colIdx[e]  = (int)f->colIdx[e];
+            g->val[e]     = csrWeight(f,e);
+            g->rowSum[i] += g->val[e];
+            g->colPtr[g->colIdx[e]+1]++;
+        }
+        deg = g->rowPtr[i+1]-g->rowPtr[i];
+        if(deg > degStat->maxDeg)
+            degStat->maxDeg = deg;
+        if(deg < degStat->minDeg)
+            degStat->minDeg = deg;
+        sumDeg += deg;
+    }
+    degStat->meanDeg = (float)sumDeg/(float)g->m;
+    csrClose(f);
+    
+    /*Columns, by a counting sort of the edges*/
+    for(i=0;i<g->m;i++)
+        g->colPtr[i+1] += g->colPtr[i];
+    for(i=0;i<g->m;i++){
+        for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++){
+            p = g->colPtr[g->colIdx[e]]++;
+            g->colEdge[p] = e;
+            g->colVal[p]  = g->val[e];
+            g->rowIdx[p]  = i;
+        }
+    }
+    for(i=g->m;i>0;i--)
+        g->colPtr[i] = g->colPtr[i-1];
+    g->colPtr[0] = 0;
+    return g;
+}
+
+/*Deallocate a CSR/CSC graph*/
+void free_CSRGraph(CSRGraph* g){
+    free(g->rowPtr);
+    free(g->colIdx);
+    free(g->colPtr);
+    free(g->rowIdx);
+    free(g->colEdge);
+    free(g->colVal);
+    free(g->val);
+    free(g->ept);
+    free(g->cur);
+    free(g->diff);
+    free(g->rowSum);
+    free(g->absorbing);
+    free(g->absPtr);
+    free(g->absEdge);
+    free(g);
+}
+
+/*Walker view of a CSR/CSC graph*/
+CSRGraph* newWalkerView(CSRGraph* g){
+    
+    CSRGraph* v = malloc(sizeof(CSRGraph));
+    
+    *v = *g;
+    v->ept       = vec_alloc(g->nnz);
+    v->cur       = vec_alloc(g->nnz);
+    v->diff      = vec_alloc(g->nnz);
+    v->absorbing = int_vec_alloc(g->m);
+    v->absPtr    = int_vec_alloc(g->m+1);
+    v->absEdge   = int_vec_alloc(1);
+    
+    return v;
+}
+
+/*Deallocate a walker view*/
+void free_WalkerView(CSRGraph* v){
+    
+    free(v->ept);
+    free(v->cur);
+    free(v->diff);
+    free(v->absorbing);
+    free(v->absPtr);
+    free(v->absEdge);
+    free(v);
+}
+
+/*Allocate a lattice keeping every step-th layer*/
+Lattice* lattice_alloc(int m,int wlen,int step,int single){
+    
+    int t,nbKept;
+    Lattice* L = malloc(sizeof(Lattice));
+    
+    L->m      = m;
+    L->wlen   = wlen;
+    L->step   = step;
+    L->single = single;
+    L->dkept  = NULL;
+    L->fkept  = NULL;
+    
+    /*Layers 0,step,2*step,... and wlen*/
+    nbKept = wlen/step+2;
+    if(single){
+        L->fkept = malloc(nbKept*sizeof(float*));
+        for(t=0;t<nbKept;t++){
+            L->fkept[t] = calloc(m,sizeof(float));
+            if(L->fkept[t] == NULL){
+                fprintf(stderr,"could not allocate memory");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    else
+        L->dkept = mat_alloc(nbKept,m);
+    L->buf  = mat_alloc(step+1,m);
+    L->view = malloc((step+1)*sizeof(double*));
+    
+    return L;
+}
+
+/*Deallocate a lattice*/
+void free_Lattice(Lattice* L){
+    
+    int t,nbKept = L->wlen/L->step+2;
+    
+    if(L->single){
+        for(t=0;t<nbKept;t++)
+            free(L->fkept[t]);
+        free(L->fkept);
+    }
+    else
+        free_mat(L->dkept,nbKept);
+    free_mat(L->buf,L->step+1);
+    free(L->view);
+    free(L);
+}
+
+/*Is layer t of a lattice kept*/
+int latticeKept(Lattice* L,int t){
+    return (t%L->step == 0 || t == L->wlen);
+}
+
+/*Slot of the kept layer t*/
+static int latticeSlot(Lattice* L,int t){
+    return (t%L->step == 0) ? t/L->step : L->wlen/L->step+1;
+}
+
+/*Layer where t is computed*/
+double* latticeLayer(Lattice* L,int t,double* buf){
+    
+    if(!L->single && latticeKept(L,t))
+        return L->dkept[latticeSlot(L,t)];
+    return buf;
+}
+
+/*Keep the nodes from..to-1 of layer t*/
+void latticeStore(Lattice* L,int t,double* layer,int from,int to){
+    
+    int i;
+    double* dest;
+    float*  fdest;
+    
+    if(!latticeKept(L,t))
+        return;
+    if(L->single){
+        fdest = L->fkept[latticeSlot(L,t)];
+        for(i=from;i<to;i++)
+            fdest[i] = (float)layer[i];
+    }
+    else{
+        dest = L->dkept[latticeSlot(L,t)];
+        if(dest != layer){
+            for(i=from;i<to;i++)
+                dest[i] = layer[i];
+        }
+    }
+}
+
+/*Get the nodes from..to-1 of the kept layer t*/
+double* latticeLoad(Lattice* L,int t,double* buf,int from,int to){
+    
+    int i;
+    float* src;
+    
+    if(!L->single)
+        return L->dkept[latticeSlot(L,t)];
+    src = L->fkept[latticeSlot(L,t)];
+    for(i=from;i<to;i++)
+        buf[i] = src[i];
+    return buf;
+}
+    
 
 /****************************I/O OPERATIONS*******************************/
 
@@ -535,31 +833,28 @@ void writeMat(double** P,int m,char* fname){
 }
 
 /*Write the MEPT in a sparse file*/
-void writeMEPT_sparse(char* fname,SparseDim* rows,int m){
+void writeMEPT_sparse(char* fname,CSRGraph* g){
     
-    int i,add;
+    int i,e,add;
     FILE* outFile = fopen(fname,"w");
-    SparseElem* elem;
     
     /*Write the number of lines (i.e. nodes)*/
-    fprintf(outFile,"%i\n",m);
+    fprintf(outFile,"%i\n",g->m);
     
     /*Write the sparse matrix entries*/
-    for(i=0;i<m;i++){
+    for(i=0;i<g->m;i++){
         /*Check if the row contains at least one non-zero entry*/
-        for(add=0,elem=rows[i].first;!add&&elem;elem=elem->nextC){
-            if(elem->ept>0){
+        for(add=0,e=g->rowPtr[i];!add&&e<g->rowPtr[i+1];e++){
+            if(g->ept[e]>0){
                 add=1;
             }
         }
         if(add){           
             /*Write the line number*/
             fprintf(outFile,"%i",i+1);
-            elem = rows[i].first;
-            while(elem){
-                if(elem->ept > 0)
-                    fprintf(outFile," %i:%e",(elem->c)+1,elem->ept);
-                elem = elem->nextC;
+            for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++){
+                if(g->ept[e] > 0)
+                    fprintf(outFile," %i:%e",(g->colIdx[e])+1,g->ept[e]);
             }
             fprintf(outFile,"\n");
         }
@@ -568,31 +863,28 @@ void writeMEPT_sparse(char* fname,SparseDim* rows,int m){
 }    
   
 /*Write the absolute MEPT difference in a sparse file*/
-void writeDiff_sparse(char* fname,SparseDim* rows,int m){
+void writeDiff_sparse(char* fname,CSRGraph* g){
     
-    int i,add;
+    int i,e,add;
     FILE* outFile = fopen(fname,"w");
-    SparseElem* elem;
     
     /*Write the number of lines (i.e. nodes)*/
-    fprintf(outFile,"%i\n",m);
+    fprintf(outFile,"%i\n",g->m);
     
     /*Write the sparse matrix entries*/
-    for(i=0;i<m;i++){
+    for(i=0;i<g->m;i++){
         /*Check if the row contains at least one non-zero entry*/
-        for(add=0,elem=rows[i].first;!add&&elem;elem=elem->nextC){
-            if(elem->diff>0){
+        for(add=0,e=g->rowPtr[i];!add&&e<g->rowPtr[i+1];e++){
+            if(g->diff[e]>0){
                 add=1;
             }
         }
         if(add){           
             /*Write the line number*/
             fprintf(outFile,"%i",i+1);
-            elem = rows[i].first;
-            while(elem){
-                if(elem->diff > 0)
-                    fprintf(outFile," %i:%e",(elem->c)+1,elem->diff);
-                elem = elem->nextC;
+            for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++){
+                if(g->diff[e] > 0)
+                    fprintf(outFile," %i:%e",(g->colIdx[e])+1,g->diff[e]);
             }
             fprintf(outFile,"\n");
         }
@@ -601,10 +893,9 @@ void writeDiff_sparse(char* fname,SparseDim* rows,int m){
 }  
 
 /*Export a matrix of MEPN to the graphviz dot format*/
-void writeDot(char* fname,SparseDim* rows,int m,int undirected){
+void writeDot(char* fname,CSRGraph* g,int undirected){
     
-    int i;
-    SparseElem* elem;
+    int i,e;
     FILE* outFile = fopen(fname,"w");
     
     if(undirected){
@@ -615,13 +906,11 @@ void writeDot(char* fname,SparseDim* rows,int m,int undirected){
         fprintf(outFile,"orientation=land;\n");
         fprintf(outFile,"node [shape = circle,fontcolor=black];\n");
         /*Define edges*/
-        for(i=0;i<m;i++){
-            elem = rows[i].first;
-            while(elem && elem->c <= i){
-                if(elem->diff > 0){
-                    fprintf(outFile,"%i -- %i [label = \"%e\"];\n",i+1,(elem->c)+1,elem->diff);
+        for(i=0;i<g->m;i++){
+            for(e=g->rowPtr[i];e<g->rowPtr[i+1] && g->colIdx[e] <= i;e++){
+                if(g->diff[e] > 0){
+                    fprintf(outFile,"%i -- %i [label = \"%e\"];\n",i+1,(g->colIdx[e])+1,g->diff[e]);
                 }
-                elem = elem->nextC;
             }
         }
         /*Write trailer*/
@@ -635,12 +924,10 @@ void writeDot(char* fname,SparseDim* rows,int m,int undirected){
         fprintf(outFile,"orientation=land;\n");
         fprintf(outFile,"node [shape = circle,fontcolor=black];\n");
         /*Define edges*/
-        for(i=0;i<m;i++){
-            elem = rows[i].first;
-            while(elem){
-                if(elem->ept > 0)
-                    fprintf(outFile,"%i -> %i [label = \"%e\"];\n",i+1,(elem->c)+1,elem->ept);
-                elem = elem->nextC;
+        for(i=0;i<g->m;i++){
+            for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++){
+                if(g->ept[e] > 0)
+                    fprintf(outFile,"%i -> %i [label = \"%e\"];\n",i+1,(g->colIdx[e])+1,g->ept[e]);
             }
         }
         /*Write trailer*/
@@ -665,6 +952,10 @@ void printHelpKwalk(){
     printf("                          groups are separated by # and nodes are separated by :\n");
 	printf("            -i nbInflat   the number of inflation iterations (default 0)\n");
     printf("            -d            generate a dot file (outFile.dot)\n");    
+    printf("            -t nbThreads  the number of threads (default 1)\n");
+    printf("            -c            keep only every sqrt(walkLen)-th lattice layer\n");
+    printf("                          and recompute the others (less memory)\n");
+    printf("            -f            keep the lattice layers in single precision\n");
     printf("            -v verbose    verbosity level (default 1)\n");
     printf("            -h            display this help\n\n");
     printf("Version   : %1.2f\n",VERSION);
@@ -925,19 +1216,13 @@ void matNormalize(double** P,int m,double a){
 }    
 
 /*Divide all elements of a sparse matrix by a number a*/
-void matNormalize_sparse(SparseDim* rows,int m,double a){
+void matNormalize_sparse(CSRGraph* g,double a){
     
-    int i;
-    SparseElem* elem;
+    int e;
       
     /*Normalize the entries*/
-    for(i=0;i<m;i++){
-        elem = rows[i].first;
-        while(elem){
-            elem->ept /= a;
-            elem = elem->nextC;
-        }
-    }        
+    for(e=0;e<g->nnz;e++)
+        g->ept[e] /= a;
 }  
 
 /*Compute the position of the maximum element in a vector of doubles*/
@@ -970,17 +1255,16 @@ void stochMat(double** P,int m){
 }
 
 /*Enforce the stochasticity of a sparse matrix of positive double*/
-void stochMat_sparse(SparseDim* rows,int m){
-    int i;
-    SparseElem* elem;
+void stochMat_sparse(CSRGraph* g){
+    int i,e,p;
     
-    for(i=0;i<m;i++){
-        elem = rows[i].first;
-        while(elem){
-            elem->val /= rows[i].sum;
-            elem = elem->nextC;
-        }    
+    for(i=0;i<g->m;i++){
+        for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++)
+            g->val[e] /= g->rowSum[i];
     }    
+    /*Keep the column copy of the values up to date*/
+    for(p=0;p<g->nnz;p++)
+        g->colVal[p] = g->val[g->colEdge[p]];
 }    
 
 
@@ -1022,17 +1306,16 @@ void buildLatticeForward(double** lat,int wlen,int* kgroup,double* kgproba,doubl
 }
 
 /* Build a forward lattice up to wlen*/
-void buildLatticeForward_sparse(double** lat,int wlen,int* kgroup,double* kgproba,SparseDim* cols,int m,int verbose){
+void buildLatticeForward_sparse(double** lat,int wlen,int* kgroup,double* kgproba,CSRGraph* g,int verbose){
     
     int j,k;
-    SparseElem* elem;
     
     /* Clean the lattice */
-    init_mat(lat,m,wlen+1);
+    init_mat(lat,wlen+1,g->m);
     
     /* Initialization for time 0 */
     for(j=1;j<=kgroup[0];j++){
-        lat[kgroup[j]][0] = kgproba[j];
+        lat[0][kgroup[j]] = kgproba[j];
     }
     
     /* Propagate probabilities in the lattice */
@@ -1043,19 +1326,28 @@ void buildLatticeForward_sparse(double** lat,int wlen,int* kgroup,double* kgprob
             printf("...%i",k);
             fflush(stdout);
         }
-        for (j=0;j<m;j++){
-            elem = cols[j].first;
-            while(elem){
-                if(!cols[elem->l].absorbing)
-                    lat[j][k] += lat[elem->l][k-1]*(elem->val);
-                elem = elem->nextL;
-            }    
-        }
+        latticeStepForward_sparse(lat[k-1],lat[k],g,0,g->m);
     }
     if(verbose >= 2)
         printf("\n");
 }
 
+/*One forward step of the lattice for the nodes from..to-1*/
+void latticeStepForward_sparse(double* prev,double* next,CSRGraph* g,int from,int to){
+    
+    int j,p;
+    double acc;
+    
+    for (j=from;j<to;j++){
+        acc = 0;
+        for(p=g->colPtr[j];p<g->colPtr[j+1];p++){
+            if(!g->absorbing[g->rowIdx[p]])
+                acc += prev[g->rowIdx[p]]*(g->colVal[p]);
+        }    
+        next[j] = acc;
+    }
+}
+
 /* Build a backward lattice up to wlen*/
 void buildLatticeBackward(double** lat,int wlen,double** P,int m){
     
@@ -1083,18 +1375,17 @@ void buildLatticeBackward(double** lat,int wlen,double** P,int m){
 }
 
 /* Build a backward lattice up to wlen*/
-void buildLatticeBackward_sparse(double** lat,int wlen,SparseDim* rows,int m,int verbose){
+void buildLatticeBackward_sparse(double** lat,int wlen,CSRGraph* g,int verbose){
     
     int i,k;
-    SparseElem* elem;
     
     /* Clean the lattice */
-    init_mat(lat,m,wlen+1);
+    init_mat(lat,wlen+1,g->m);
     
     /* Initialization for time wlen */
-    for(i=0;i<m;i++){
-        if(rows[i].absorbing)
-            lat[i][wlen] = 1;
+    for(i=0;i<g->m;i++){
+        if(g->absorbing[i])
+            lat[wlen][i] = 1;
     }    
        
     /* Propagate probabilities in the lattice */
@@ -1105,20 +1396,29 @@ void buildLatticeBackward_sparse(double** lat,int wlen,SparseDim* rows,int m,int
             printf("%i...",k);
             fflush(stdout);
         }               
-        for(i=0;i<m;i++){
-            if(!rows[i].absorbing){
-                elem = rows[i].first;
-                while(elem){
-                    lat[i][k-1] += lat[elem->c][k]*(elem->val);
-                    elem = elem->nextC;
-                }    
-            }
-        }
+        latticeStepBackward_sparse(lat[k],lat[k-1],g,0,g->m);
     }
     if(verbose >= 2)
         printf("0\n");
 }
 
+/*One backward step of the lattice for the nodes from..to-1 (the absorbing
+  nodes are only reached at time wlen)*/
+void latticeStepBackward_sparse(double* next,double* prev,CSRGraph* g,int from,int to){
+    
+    int i,e;
+    double acc;
+    
+    for(i=from;i<to;i++){
+        acc = 0;
+        if(!g->absorbing[i]){
+            for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++)
+                acc += next[g->colIdx[e]]*(g->val[e]);
+        }
+        prev[i] = acc;
+    }
+}
+
 /*Compute the cumulated absorption probability*/
 double cumulatedAbsorptionProba(double** latB,int wlen,int* kgroup,double* kgproba){
 	
@@ -1127,7 +1427,7 @@ double cumulatedAbsorptionProba(double** latB,int wlen,int* kgroup,double* kgpro
 	
 	for (k=wlen-1;k>=0;--k){
 		for(j=1;j<=kgroup[0];j++){
-			mass += kgproba[j]*latB[kgroup[j]][k];
+			mass += kgproba[j]*latB[k][kgroup[j]];
 	    }
 	}
 	
@@ -1161,51 +1461,47 @@ void setAbsStates(double** P,double** PStart,int m,int** kgroups,int nbGroups,in
 }
 
 /*Set all the groups being absorbing except the starting group*/
-void setAbsStates_sparse(SparseDim* rows,SparseDim* cols,int m,int** kgroups,double** kgprobas,int nbGroups,int start){
-    
-    int i,j;
-    SparseElem* selem;
-    
-    /*Reset the absorbing and starting states*/
-    for(i=0;i<m;i++){
-        rows[i].absorbing  = 0;
-        cols[i].absorbing  = 0;
-        rows[i].starting   = 0;
-        cols[i].starting   = 0;
-        rows[i].firstAbs   = NULL; /*Controlled memory leak*/
-        rows[i].lastAbs    = NULL; /*Controlled memory leak*/       
-    }
-    
-    /*Set all the groups being absorbing except the starting group*/
-    /*Set the starting group*/
-    for(i=0;i<nbGroups;i++){
-        for(j=1;j<=kgroups[i][0];j++){
-            if(i != start){
-                rows[kgroups[i][j]].absorbing = 1;
-                cols[kgroups[i][j]].absorbing = 1;
-                selem = cols[kgroups[i][j]].first;
-                while(selem){
-                    if(selem->l != selem->c){
-                        if(!rows[selem->l].firstAbs){
-                            rows[selem->l].firstAbs = malloc(sizeof(Elem));
-                            rows[selem->l].lastAbs  = rows[selem->l].firstAbs;
-                        }
-                        else{
-                            rows[selem->l].lastAbs->next = malloc(sizeof(Elem));
-                            rows[selem->l].lastAbs = rows[selem->l].lastAbs->next;
-                        }
-                        rows[selem->l].lastAbs->selem = selem;
-                        rows[selem->l].lastAbs->next = NULL;
+void setAbsStates_sparse(CSRGraph* g,int** kgroups,int nbGroups,int start){
+    
+    int i,j,p,pass,node,src;
+    
+    /*Reset the absorbing states*/
+    for(i=0;i<g->m;i++)
+        g->absorbing[i] = 0;
+    init_int_vec(g->absPtr,g->m+1);
+    
+    /*Set all the groups being absorbing except the starting group and
+      list, for each node, its edges leading to an absorbing node. The first
+      pass counts these edges, the second one stores them in absEdge*/
+    for(pass=0;pass<2;pass++){
+        for(i=0;i<nbGroups;i++){
+            if(i == start)
+                continue;
+            for(j=1;j<=kgroups[i][0];j++){
+                node = kgroups[i][j];
+                g->absorbing[node] = 1;
+                for(p=g->colPtr[node];p<g->colPtr[node+1];p++){
+                    src = g->rowIdx[p];
+                    if(src != node){
+                        if(pass)
+                            g->absEdge[g->absPtr[src]++] = g->colEdge[p];
+                        else
+                            g->absPtr[src+1]++;
                     }
-                    selem = selem->nextL;
-                }                    
+                }
             }
-            else{
-                rows[kgroups[i][j]].starting = kgprobas[i][j];
-                cols[kgroups[i][j]].starting = kgprobas[i][j];                
-            }    
+        }
+        if(!pass){
+            for(i=0;i<g->m;i++)
+                g->absPtr[i+1] += g->absPtr[i];
+            free(g->absEdge);
+            g->absEdge = int_vec_alloc(g->absPtr[g->m]+1);
         }
     }
+    /*The second pass shifted each row pointer to the start of the next row*/
+    for(i=g->m;i>0;i--)
+        g->absPtr[i] = g->absPtr[i-1];
+    g->absPtr[0] = 0;
 }
 
 /*Compute the absolute EPT difference : |E_ij - E_ji|*/
@@ -1223,27 +1519,22 @@ void diffEPT(double** E,int m){
 }    
 
 /*Compute the absolute EPT difference : |E_ij - E_ji|*/
-void diffEPT_sparse(SparseDim* rows,SparseDim* cols,int m){
+void diffEPT_sparse(CSRGraph* g){
     
-    int i;
+    int i,e,q,e2;
     double diff;
-    SparseElem* elemL;
-    SparseElem* elemC;
-    
-    for(i=0;i<m;i++){        
-        elemL = rows[i].first;
-        elemC = cols[i].first;        
-        /*Scan the two list in parallel*/
-        while(elemL && elemC){
-            if(elemL->c >= i){            
-                diff = ABS((elemL->cur) - (elemC->cur));
-                elemL->diff += diff;
-                elemC->diff += diff;
-                elemL->cur   = 0;
-                elemC->cur   = 0;
+    
+    for(i=0;i<g->m;i++){        
+        /*Scan row i and column i in parallel*/
+        for(e=g->rowPtr[i],q=g->colPtr[i];e<g->rowPtr[i+1] && q<g->colPtr[i+1];e++,q++){
+            if(g->colIdx[e] >= i){
+                e2 = g->colEdge[q];
+                diff = ABS((g->cur[e]) - (g->cur[e2]));
+                g->diff[e]  += diff;
+                g->diff[e2] += diff;
+                g->cur[e]    = 0;
+                g->cur[e2]   = 0;
             }
-            elemL = elemL->nextC;
-            elemC = elemC->nextL;            
         }
     }
 }
@@ -1263,28 +1554,17 @@ int isSymmetric(double** P,int m){
 }
 
 /*Test if a sparse matrix is symmetric*/
-int isSymmetric_sparse(SparseDim* rows,SparseDim* cols,int m){
-    int i,sym=1;
-    SparseElem* elemL;
-    SparseElem* elemC;
-    
-    for(i=0;sym && i<m;i++){
-        if(rows[i].nbElems == cols[i].nbElems){
-            elemL = rows[i].first;
-            elemC = cols[i].first;           
-            
-            /*Scan the two list in parallel*/
-            while(sym && elemL && elemC){                
-                if(elemL->c != elemC->l){
+int isSymmetric_sparse(CSRGraph* g){
+    int i,e,q,sym=1;
+    
+    for(i=0;sym && i<g->m;i++){
+        if(g->rowPtr[i+1]-g->rowPtr[i] == g->colPtr[i+1]-g->colPtr[i]){
+            /*Scan row i and column i in parallel*/
+            for(e=g->rowPtr[i],q=g->colPtr[i];sym && e<g->rowPtr[i+1];e++,q++){
+                if(g->colIdx[e] != g->rowIdx[q])
                     sym = 0;
-                    }
-                else if(elemL->val != elemC->val){
+                else if(g->val[e] != g->colVal[q])
                     sym = 0;
-                    }
-                else{
-                    elemL = elemL->nextC;
-                    elemC = elemC->nextL;
-                }
             }
         }
         else
@@ -1309,28 +1589,25 @@ int matrixNNZ(double** P,int m){
 }    
 
 /*Get the number of non-nul elements in a matrix*/
-void matrixNNZ_sparse(SparseDim* rows,int m,int* nnz,int* nnr){
-    int i;
-    int *touched = malloc(m*sizeof(int));
-    SparseElem* elem;
+void matrixNNZ_sparse(CSRGraph* g,int* nnz,int* nnr){
+    int i,e;
+    int *touched = malloc(g->m*sizeof(int));
     *nnz=0,*nnr=0;
     
-    init_int_vec(touched,m);    
-    for(i=0;i<m;i++){
-        elem = rows[i].first;
-        while(elem){
-            if(elem->ept > 0){
+    init_int_vec(touched,g->m);    
+    for(i=0;i<g->m;i++){
+        for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++){
+            if(g->ept[e] > 0){
                 if (!touched[i]){
                     touched[i]=1;
                     (*nnr)++;                    
                 }    
-                if (!touched[elem->c]){
-                    touched[elem->c]=1;
+                if (!touched[g->colIdx[e]]){
+                    touched[g->colIdx[e]]=1;
                     (*nnr)++;
                 }    
                 (*nnz)++;
             }    
-            elem = elem->nextC;
         }    
     }
     free(touched);
@@ -1338,27 +1615,26 @@ void matrixNNZ_sparse(SparseDim* rows,int m,int* nnz,int* nnr){
  
 
 /*Copy edge passage times to edge value for inflation*/
-void copyForInflation(SparseDim* rows,int undirected,int m){
+void copyForInflation(CSRGraph* g,int undirected){
     
-    int i;
-    SparseElem* elem;
+    int i,e;
 
-	for(i=0;i<m;i++){
-		elem = rows[i].first;
-		rows[i].sum = 0.0; /*The col sum should also be updated*/
-		while(elem){
+	for(i=0;i<g->m;i++){
+		g->rowSum[i] = 0.0;
+		for(e=g->rowPtr[i];e<g->rowPtr[i+1];e++){
 			/*Copy edge passage times to edge value*/
 			if(undirected)
-				elem->val = elem->diff;
+				g->val[e] = g->diff[e];
 			else
-				elem->val = elem->ept;
-			rows[i].sum += elem->val;
-			elem->ept  = 0.0;
-			elem->cur  = 0.0;
-			elem->diff = 0.0;
-	 		elem = elem->nextC;
+				g->val[e] = g->ept[e];
+			g->rowSum[i] += g->val[e];
+			g->ept[e]  = 0.0;
+			g->cur[e]  = 0.0;
+			g->diff[e] = 0.0;
 		}	
 	}
+	for(e=0;e<g->nnz;e++)
+		g->colVal[e] = g->val[g->colEdge[e]];
 }
 
 /*Copy a vetcor into another (must be allocated)*/
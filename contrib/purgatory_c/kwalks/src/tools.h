@@ -23,6 +23,8 @@
 #include <time.h>
 #include <getopt.h>
 
+#include "csrgraph.h"
+
 /*CONSTANTS FOR TOOLS.C*/
 #define BUF_LINE_LEN   150000    /* Size of the buffer for file reading */
 #define FNAME_LEN      1000      /* Maximum size of file names*/ 
@@ -64,6 +66,43 @@ typedef struct Elem{
     struct Elem *next;
 }Elem;
 
+/* Compressed sparse row (CSR) and column (CSC) layout of the transition
+   matrix. Edges are numbered in row order; the column entries refer to them
+   through colEdge, so that the edge values are stored only once. */
+typedef struct CSRGraph{
+    int     m;          /* Number of nodes */
+    int     nnz;        /* Number of edges */
+    int*    rowPtr;     /* Edges leaving node i : rowPtr[i]..rowPtr[i+1]-1 */
+    int*    colIdx;     /* Destination node of each edge */
+    int*    colPtr;     /* Entries of column j : colPtr[j]..colPtr[j+1]-1 */
+    int*    rowIdx;     /* Source node of each column entry */
+    int*    colEdge;    /* Edge of each column entry */
+    double* colVal;     /* Transition probability of each column entry */
+    double* val;        /* Transition probability of each edge */
+    double* ept;        /* Expected passage time of each edge */
+    double* cur;        /* Passage time of each edge for the current group */
+    double* diff;       /* Cumulated |E_ij - E_ji| of each edge */
+    double* rowSum;     /* Sum of the values of each row */
+    int*    absorbing;  /* Is node i absorbing for the current group */
+    int*    absPtr;     /* Edges from node i to other absorbing nodes : */
+    int*    absEdge;    /* absEdge[absPtr[i]]..absEdge[absPtr[i+1]-1]   */
+}CSRGraph;
+
+/* Lattice of wlen+1 layers of m probabilities. Only the layers t with
+   t%step == 0 and the last one are kept, in double or single precision;
+   the others have to be recomputed from the closest kept layer. The
+   segment buffers hold step+1 layers, view points to the current ones. */
+typedef struct Lattice{
+    int      m;         /* Number of nodes */
+    int      wlen;      /* Index of the last layer */
+    int      step;      /* Distance between two kept layers */
+    int      single;    /* Are the layers kept as floats */
+    double** dkept;     /* Kept layers (double precision) */
+    float**  fkept;     /* Kept layers (single precision) */
+    double** buf;       /* Segment buffers */
+    double** view;      /* Layers of the current segment */
+}Lattice;
+
 typedef struct DegStat{
     int    minDeg;
     int    maxDeg;
@@ -123,6 +162,44 @@ void init_int_mat3(int ***matrix, int dim1, int dim2,int dim3);
 /*Initialize an array of SparseDim*/
 void init_SparseDims(SparseDim* sdim,int dim1);
 
+/*Deallocate the elements of an array of SparseDim (rows and columns)*/
+void free_SparseDims(SparseDim* rows,int dim1);
+
+/*Convert the linked rows and columns into a CSR/CSC graph*/
+CSRGraph* sparseToCSR(SparseDim* rows,SparseDim* cols,int m);
+
+/*Read a graph in the binary CSR format of csrgraph.h*/
+CSRGraph* readMat_binary(char* fname,DegStat* degStat);
+
+/*Deallocate a CSR/CSC graph*/
+void free_CSRGraph(CSRGraph* g);
+
+/*Walker view of a CSR/CSC graph : shares the topology and the transition
+  probabilities of g but owns its absorbing states and passage times*/
+CSRGraph* newWalkerView(CSRGraph* g);
+
+/*Deallocate a walker view (the shared arrays are kept)*/
+void free_WalkerView(CSRGraph* v);
+
+/*Allocate a lattice keeping every step-th layer*/
+Lattice* lattice_alloc(int m,int wlen,int step,int single);
+
+/*Deallocate a lattice*/
+void free_Lattice(Lattice* L);
+
+/*Is layer t of a lattice kept*/
+int latticeKept(Lattice* L,int t);
+
+/*Layer where t is computed : the kept layer itself when it is stored in
+  double precision, buf otherwise*/
+double* latticeLayer(Lattice* L,int t,double* buf);
+
+/*Keep the nodes from..to-1 of layer t (nothing if t is not kept)*/
+void latticeStore(Lattice* L,int t,double* layer,int from,int to);
+
+/*Get the nodes from..to-1 of the kept layer t, converted into buf if needed*/
+double* latticeLoad(Lattice* L,int t,double* buf,int from,int to);
+
 /****************************I/O OPERATIONS*******************************/
 
 /*Tell if a file contains sparse data*/
@@ -150,13 +227,13 @@ void writeVec_sparse(double* I,int m,char* fname);
 void writeMat(double** P,int m,char* fname);
 
 /*Write the MEPT in a sparse file*/
-void writeMEPT_sparse(char* fname,SparseDim* rows,int m);
+void writeMEPT_sparse(char* fname,CSRGraph* g);
 
 /*Write the absolute MEPT difference in a sparse file*/
-void writeDiff_sparse(char* fname,SparseDim* rows,int m);
+void writeDiff_sparse(char* fname,CSRGraph* g);
 
 /*Export a matrix of MEPN to the graphviz dot format*/
-void writeDot(char* fname,SparseDim* rows,int m,int undirected);
+void writeDot(char* fname,CSRGraph* g,int undirected);
 
 /****************************Miscellaneous*******************************/
 
@@ -223,7 +300,7 @@ void vecNormalize(double* vec,int m,double a);
 void matNormalize(double** P,int m,double a);
 
 /*Divide all elements of a sparse matrix by a number a*/
-void matNormalize_sparse(SparseDim* rows,int m,double a);
+void matNormalize_sparse(CSRGraph* g,double a);
 
 /*Compute the position of the maximum element in a vector of doubles*/
 int max_vec_pos(double* vec,int m);
@@ -232,7 +309,7 @@ int max_vec_pos(double* vec,int m);
 void stochMat(double** P,int m);
 
 /*Enforce the stochasticity of a sparse matrix of positive double*/
-void stochMat_sparse(SparseDim* rows,int m);
+void stochMat_sparse(CSRGraph* g);
 
 /*Enforce the stochasticity of a vector of positive double */
 double stochVector(double* vec,int m);
@@ -240,44 +317,50 @@ double stochVector(double* vec,int m);
 /* Build a forward lattice up to wlen*/
 void buildLatticeForward(double** lat,int wlen,int* kgroup,double* kgproba,double** P,int m);
 
-/* Build a forward lattice up to wlen*/
-void buildLatticeForward_sparse(double** lat,int wlen,int* kgroup,double* kgproba,SparseDim* cols,int m,int verbose);
+/* Build a forward lattice up to wlen (lat[t][i] : layer t, node i)*/
+void buildLatticeForward_sparse(double** lat,int wlen,int* kgroup,double* kgproba,CSRGraph* g,int verbose);
+
+/*One forward step of the lattice for the nodes from..to-1*/
+void latticeStepForward_sparse(double* prev,double* next,CSRGraph* g,int from,int to);
     
 /* Build a backward lattice up to wlen*/
 void buildLatticeBackward(double** lat,int wlen,double** P,int m);
 
-/* Build a backward lattice up to wlen*/
-void buildLatticeBackward_sparse(double** lat,int wlen,SparseDim* rows,int m,int verbose);
+/* Build a backward lattice up to wlen (lat[t][i] : layer t, node i)*/
+void buildLatticeBackward_sparse(double** lat,int wlen,CSRGraph* g,int verbose);
+
+/*One backward step of the lattice for the nodes from..to-1*/
+void latticeStepBackward_sparse(double* next,double* prev,CSRGraph* g,int from,int to);
 
-/*Compute the cumulated absorption probability*/
+/*Compute the cumulated absorption probability (latB[t][i])*/
 double cumulatedAbsorptionProba(double** latB,int wlen,int* kgroup,double* kgproba);
 
 /*Set all the groups being absorbing except the starting group*/
 void setAbsStates(double** P,double** PStart,int m,int** kgroups,int nbGroups,int start);
 
 /*Set all the groups being absorbing except the starting group*/
-void setAbsStates_sparse(SparseDim* rows,SparseDim* cols,int m,int** kgroups,double** kgprobas,int nbGroups,int start);
+void setAbsStates_sparse(CSRGraph* g,int** kgroups,int nbGroups,int start);
 
 /*Compute the absolute EPT difference : |E_ij - E_ji|*/
 void diffEPT(double** E,int m);
 
 /*Compute the absolute EPT difference : |E_ij - E_ji|*/
-void diffEPT_sparse(SparseDim* rows,SparseDim* cols,int m);
+void diffEPT_sparse(CSRGraph* g);
 
 /*Test if a matrix is symmetric*/
 int isSymmetric(double** P,int m);
 
 /*Test if a sparse matrix is symmetric*/
-int isSymmetric_sparse(SparseDim* rows,SparseDim* cols,int m);
+int isSymmetric_sparse(CSRGraph* g);
 
 /*Get the number of non-nul elements in a matrix*/
 int matrixNNZ(double** P,int m);
 
 /*Get the number of non-nul elements in a matrix*/
-void matrixNNZ_sparse(SparseDim* rows,int m,int* nnz,int* nnr);
+void matrixNNZ_sparse(CSRGraph* g,int* nnz,int* nnr);
 
 /*Copy edge passage times to edge value for inflation*/
-void copyForInflation(SparseDim* rows,int undirected,int m);
+void copyForInflation(CSRGraph* g,int undirected);
 
 /*Copy a vetcor into another (must be allocated)*/
 void copy_mat(double** src,double** dest,int l,int c);
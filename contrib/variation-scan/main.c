@@ -11,6 +11,8 @@
 #include <sys/types.h>
 #include <sys/times.h>
 
+#include "matrixio.h"
+
 #define BASE_STR_LEN 10
 #define MAX_HOSTNAME 256
 #define ALPHABET_SIZE 93
@@ -409,6 +411,8 @@ void help(){
   "\n"
   "    -m_format matrix_format\n"
   "        Matrix file format\n"
+  "        The tab, transfac, tf, jaspar, meme, cb and cluster-buster formats are read\n"
+  "        directly, the other ones are converted with convert-matrix.\n"
   "\n"
   "        Supported formats: alignace, assembly, cb, clustal, cluster-buster,\n"
   "                            consensus, sequences, feature, footprintdb, gibbs,\n"
@@ -720,6 +724,7 @@ int main(int argc, char *argv[]){
 
   //Declare variables
   FILE *fh_matrix_list            =   NULL;
+  FILE *fh_matrix_tab             =   NULL;
   FILE *fh_distrib_list           =   NULL;
   char   **token                  =   NULL;
   char   *index                   =   NULL;
@@ -734,8 +739,7 @@ int main(int argc, char *argv[]){
   string *matrix_distrib_cmd      =   NULL;
   string *sort_matrix_cmd         =   NULL;
   string *convert_matrix_cmd      =   NULL;
-  string *convert_bg_cmd          =   NULL;
-  string *bg_inclusive            =   NULL;
+  string *matrix_tab_file         =   NULL;
   stringlist *matrixID            =   NULL;
   stringlist *matrixfileprefix    =   NULL;
 
@@ -748,13 +752,12 @@ int main(int argc, char *argv[]){
   bgprefix                = strnewToList(&RsatMemTracker);
   ls_cmd                  = strnewToList(&RsatMemTracker);
   convert_matrix_cmd      = strnewToList(&RsatMemTracker);
+  matrix_tab_file         = strnewToList(&RsatMemTracker);
   sort_matrix_cmd         = strnewToList(&RsatMemTracker);
-  convert_bg_cmd          = strnewToList(&RsatMemTracker);
   out_distrib_list        = strnewToList(&RsatMemTracker);
   out_distrib_list_sort   = strnewToList(&RsatMemTracker);
   input_matrix_list       = strnewToList(&RsatMemTracker);
   matrix_distrib_cmd      = strnewToList(&RsatMemTracker);
-  bg_inclusive            = strnewToList(&RsatMemTracker);
   line                    = strnewToList(&RsatMemTracker);
   token                   = getokens(4);
 
@@ -793,6 +796,37 @@ int main(int argc, char *argv[]){
     }
     //printf("This is matrixprefix[1] %s\n", matrixprefix[1]->buffer);
 
+    //Formats read natively: write each matrix to its own tab-formatted file
+    //without running convert-matrix
+    if ( parse_matrix_format(matrix_format->buffer) >= 0 ) {
+      matrix_db_t *db = read_matrix_db(curr_matrix->element->buffer, parse_matrix_format(matrix_format->buffer));
+      if ( db == NULL || db->n == 0 ){
+        RsatFatalError("Matrix file", curr_matrix->element->buffer, "could not be read. Please check the input matrix format is consistent with the -m_format option.", NULL);
+      }
+      if(verbose >= 6) RsatInfo("\nRead matrices from", curr_matrix->element->buffer, "in", matrix_format->buffer, "format", NULL);
+
+      for (int k = 0; k < db->n; k++) {
+        //Check if nb of top matrixes has been reached
+        if(top_matrices && !(nb_matrix < top_matrices)) break;
+        nb_matrix++;
+
+        strfmt(matrix_tab_file, "%s/%s_%s.tab", out_dir->buffer, matrixprefix[1]->buffer, db->matrices[k].id);
+        fh_matrix_tab = OpenOutputFile(fh_matrix_tab, matrix_tab_file->buffer);
+        write_matrix_tab(fh_matrix_tab, db, k);
+        fclose(fh_matrix_tab);
+
+        //Print content to distribution list
+        fprintf(fh_distrib_list, "%s\t%s\t%s\t%s_%s_%s.distrib\t.\t%s\n",
+                matrixprefix[1]->buffer,
+                db->matrices[k].id,
+                matrix_tab_file->buffer,
+                bgprefix->buffer, matrixprefix[1]->buffer, db->matrices[k].id,
+                bgprefix->buffer );
+      }
+      free_matrix_db(db);
+      continue;
+    }
+
     //Convert-matrixes; Split matrix files into individual tab-formatted files
     strfmt(convert_matrix_cmd,"%s/perl-scripts/convert-matrix -v 1 -from %s -to tab -split -i %s -o %s/%s",
     RSAT->buffer, matrix_format->buffer, curr_matrix->element->buffer, out_dir->buffer, matrixprefix[1]->buffer);
@@ -886,16 +920,6 @@ int main(int argc, char *argv[]){
   if(verbose >= 12) RsatInfo("Sorted distribution list :", out_distrib_list_sort->buffer, NULL);
 
 
-  /////////////////////////////////////////////////////////////////////////
-  // Convert background model to inclusive format
-  /////////////////////////////////////////////////////////////////////////
-
-  strfmt(bg_inclusive, "%s/vscan_bg_inclusive_file.inclusive", out_dir->buffer);
-  strfmt(convert_bg_cmd, "%s/convert-background-model -i %s -from oligos -to inclusive "
-                         "-o %s -bg_pseudo 0.01", SCRIPTS->buffer, bg, bg_inclusive->buffer);
-  if(verbose >= 6) RsatInfo("\nConverting bg model to inclusive", convert_bg_cmd->buffer, NULL);
-  doit(convert_bg_cmd->buffer,0,1,0,0,NULL,NULL,NULL,NULL);
-
   /////////////////////////////////////////////////////////////////////////
   // Detect number of fields for haplotype or single variant analysis
   /////////////////////////////////////////////////////////////////////////
@@ -1145,15 +1169,16 @@ int main(int argc, char *argv[]){
       //////////////////////////////////////////////////////////////////////////
 
       ////////////////////////////////////////////
-      //Prepare cmd for matrix-scan-quick
+      //Prepare cmd for matrix-scan-quick (reads the oligos background model directly)
       strfmt(mscanquick_file,"%s/%s_%s_%s.mscan",
                               out_dir->buffer, bg_prefix, matrix_prefix, matrix_id);
-      strfmt(mscanquick_cmd, "%s -i %s -m %s -pseudo 1 -decimals 1 -2str -origin start -bgfile %s "
+      strfmt(mscanquick_cmd, "%s -i %s -m %s -pseudo 1 -decimals 1 -2str -origin start "
+            "-bgfile %s -bg_format oligos -bg_pseudo 0.01 "
             "-name %s -t 1 -distrib %s/%s -o %s",
             program_full_path->buffer,
             prev_fasta->buffer,
             matrix_file,
-            bg_inclusive->buffer,
+            bg,
             matrix_id,
             distrib_dir->buffer, distrib_file,
             mscanquick_file->buffer);
@@ -0,0 +1,90 @@
+/***************************************************************************
+ *                                                                         *
+ *  matrixio.h
+ *  position count matrices in tab, TRANSFAC, JASPAR, MEME and
+ *  cluster-buster formats
+ *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef __MATRIXIO__
+#define __MATRIXIO__
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  A matrix file, one matrix or a whole database, is read at once and
+  parsed line by line in a single pass. The counts of all the matrices
+  are stored one after the other in one array, column by column (A C G T),
+  so that loading thousands of matrices costs a few allocations.
+
+  Formats (as written by convert-matrix):
+
+  - tab             rows "a |  1  2  3" in any order ([ ] and : are ignored),
+                    matrices separated by //
+  - transfac        AC (id), ID (name), P0 (order of the residues) and one
+                    row per position, // at the end of each matrix
+  - jaspar          ">id name" followed by rows "A [ 1 2 3 ]", or by 4 rows of
+                    counts without residue (A C G T)
+  - meme            "MOTIF id name" followed by a letter-probability matrix,
+                    converted to counts with its nsites (20 if missing)
+  - cluster-buster  ">name" followed by one row per position (A C G T)
+
+  The matrices without id are named after the file (file_1, file_2...).
+*/
+
+#define MATRIX_TAB              0
+#define MATRIX_TRANSFAC         1
+#define MATRIX_JASPAR           2
+#define MATRIX_MEME             3
+#define MATRIX_CLUSTER_BUSTER   4
+
+#define MATRIX_ID_SIZE 256
+
+typedef struct
+{
+    char id[MATRIX_ID_SIZE];
+    char name[MATRIX_ID_SIZE];      // the id if the file gives no name
+    int width;
+    long offset;                    // first count of the matrix in the store
+} matrix_entry_t;
+
+typedef struct
+{
+    matrix_entry_t *matrices;
+    int n;
+    int msize;
+    double *counts;                 // 4 counts (A C G T) per column
+    long size;
+    long counts_msize;
+} matrix_db_t;
+
+// format from its name (tab, transfac, jaspar, meme, cb or cluster-buster), -1 if it is not supported
+int parse_matrix_format(const char *name);
+
+// all the matrices of filename, NULL if the file can not be read or is not valid in this format
+matrix_db_t *read_matrix_db(const char *filename, int format);
+
+void free_matrix_db(matrix_db_t *db);
+
+// index of the first matrix with this id or name, -1 if there is none
+int matrix_db_find(const matrix_db_t *db, const char *id);
+
+// counts of column c of matrix k
+static inline
+double *matrix_db_column(const matrix_db_t *db, int k, int c)
+{
+    return db->counts + db->matrices[k].offset + 4 * c;
+}
+
+// write matrix k in tab format as convert-matrix (rows A C G T, then //)
+void write_matrix_tab(FILE *fp, const matrix_db_t *db, int k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -244,6 +244,10 @@ compile_matrix_scan_quick:
 compile_compare_matrices_quick:
 	@${MAKE} compile_one_program PROGRAM=compare-matrices-quick
 
+## Compile and install dust (low-complexity masking, used by peak-motifs)
+compile_dust:
+	@${MAKE} compile_one_program PROGRAM=dust
+
 ## Install external tools useful for RSAT
 install_rsat_extra:
 	${MAKE} -f ${RSAT}/makefiles/install_software.mk install_seqlogo
@@ -256,15 +260,20 @@ install_neat_extra:
 	${MAKE} -f ${RSAT}/makefiles/install_software.mk install_mcl
 	${MAKE} -f ${RSAT}/makefiles/install_software.mk install_rnsc
 
-compile_pathway_tools: compile_floydwarshall compile_kwalks compile_rea
+compile_pathway_tools: compile_floydwarshall compile_kwalks compile_rea compile_graph2csr
+
+################################################################
+## Compile graph2csr, the converter to the binary graph format read
+## by floydwarshall, kwalks and REA (contrib/purgatory_c/csrgraph)
+compile_graph2csr:
+	@${MAKE} compile_one_program PROGRAM=graph2csr SRC_DIR=${RSAT}/contrib/purgatory_c/csrgraph
 
 ################################################################
 ## Compile the program floydwarshall, located in the folder
-## contrib/floydwarshall
+## contrib/purgatory_c/floydwarshall
 compile_floydwarshall:
 	@echo "Compiling tool floydwarshall required for pathway analysis tools"
-	@gcc ${RSAT}/contrib/floydwarshall/floydwarshall.c -o ${BIN}/floydwarshall
-	@echo "	${BIN}/floydwarshall"
+	@${MAKE} compile_one_program PROGRAM=floydwarshall SRC_DIR=${RSAT}/contrib/purgatory_c/floydwarshall
 
 ################################################################
 ## Compile kwalks (subgraph extraction algorithm developed by Jerome
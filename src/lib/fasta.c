@@ -1,4 +1,5 @@
 #include "fasta.h"
+#include "dna.h"
 
 #define FASTA_READER_BUFFER_SIZE 4096
 
@@ -23,47 +24,24 @@ void free_seq(seq_t *seq)
 seq_t *new_seq_rc(seq_t *seq)
 {
     seq_t *rc = new_seq(seq->size);
-    int i;
-    for (i = 0; i < seq->size; i++)
-        rc->data[seq->size - i - 1] = 3 - seq->data[i];
+    dna_revcomp(seq->data, seq->size, rc->data);
+    rc->size = seq->size;
     return rc;
 }
 
+// append the code of c (see dna.h), nothing if c is not a residue
 static inline
 void seq_append_c(seq_t *seq, char c)
 {
+    char code = dna_code(c);
+    if (code == DNA_SKIP)
+        return;
     if (seq->size >= seq->msize)
     {
-        seq->msize += 8;
+        seq->msize = 2 * seq->msize + 8;
         seq->data = (char *) realloc(seq->data, sizeof(char) * seq->msize);
     }
-    switch (c)
-    {
-        case 'a':
-        case 'A':
-            seq->data[seq->size++] = 0;
-            break;
-
-        case 'c':
-        case 'C':
-            seq->data[seq->size++] = 1;
-            break;
-
-        case 'g':
-        case 'G':
-            seq->data[seq->size++] = 2;
-            break;
-
-        case 't':
-        case 'T':
-            seq->data[seq->size++] = 3;
-            break;
-
-        case 'n':
-        case 'N':
-            seq->data[seq->size++] = -1;
-            break;
-    }
+    seq->data[seq->size++] = code;
 }
 
 //------------------------------------------ fasta
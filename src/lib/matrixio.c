@@ -0,0 +1,587 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrixio.h"
+
+#define MATRIX_MEME_NSITES 20
+
+static const double POW10[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+typedef struct
+{
+    matrix_db_t *db;
+    int format;
+    const char *prefix;     // file name, for the matrices without id
+    int count;              // number of matrices started, for their default ids
+    int current;            // matrix being read, -1 between matrices
+    int rows;               // tab, jaspar: bit of each residue row read
+    int next_row;           // jaspar: residue of the next row without residue
+    int order[16];          // transfac: residue of each value of a position row (-1: ignored)
+    int norder;
+    int in_counts;          // meme: in a letter-probability matrix
+    double nsites;          // meme
+    int valid;
+} matrix_parser_t;
+
+/*
+  tokens
+*/
+static inline
+int is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// brackets, bars and colons are ignored in the rows of tab and jaspar matrices
+static inline
+int is_separator(char c, int brackets)
+{
+    return is_space(c) || (brackets && (c == '[' || c == ']' || c == '|' || c == ':'));
+}
+
+static inline
+int is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// next token of [*p, end), NULL at the end of the line
+static
+const char *next_token(const char **p, const char *end, int brackets, const char **token_end)
+{
+    const char *s = *p;
+    while (s < end && is_separator(*s, brackets))
+        s++;
+    if (s == end)
+    {
+        *p = end;
+        *token_end = end;
+        return NULL;
+    }
+    const char *e = s;
+    while (e < end && !is_separator(*e, brackets))
+        e++;
+    *p = e;
+    *token_end = e;
+    return s;
+}
+
+// the token [s, e) as a number, 0 if it is not one
+static
+int parse_number(const char *s, const char *e, double *value)
+{
+    const char *p = s;
+    int negative = 0;
+    if (p < e && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    // exact when the digits fit in the mantissa: same value as strtod
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int decimals = 0;
+    for (; p < e && is_digit(*p); p++, digits++)
+        mantissa = 10 * mantissa + (*p - '0');
+    if (p < e && *p == '.')
+    {
+        for (p++; p < e && is_digit(*p); p++, digits++, decimals++)
+            mantissa = 10 * mantissa + (*p - '0');
+    }
+    if (digits == 0)
+        return 0;
+    if (p == e && digits <= 15)
+    {
+        *value = (double) mantissa / POW10[decimals];
+        if (negative)
+            *value = -*value;
+        return 1;
+    }
+
+    // exponent, long numbers
+    char buffer[64];
+    char *end;
+    if (e - s >= (long) sizeof(buffer))
+        return 0;
+    memcpy(buffer, s, e - s);
+    buffer[e - s] = '\0';
+    *value = strtod(buffer, &end);
+    return *end == '\0';
+}
+
+// 0 1 2 3 for a c g t (any case), -1 otherwise
+static inline
+int residue_index(char c)
+{
+    switch (c)
+    {
+        case 'a': case 'A': return 0;
+        case 'c': case 'C': return 1;
+        case 'g': case 'G': return 2;
+        case 't': case 'T': return 3;
+        default:            return -1;
+    }
+}
+
+/*
+  store
+*/
+static
+void set_id(char *dest, const char *s, const char *e)
+{
+    // as convert-matrix: no spaces, slashes, bars or parentheses in the ids
+    long n = e - s < MATRIX_ID_SIZE ? e - s : MATRIX_ID_SIZE - 1;
+    long i;
+    for (i = 0; i < n; i++)
+    {
+        char c = s[i];
+        dest[i] = (is_space(c) || c == '/' || c == '\\' || c == '|' || c == '(' || c == ')') ? '_' : c;
+    }
+    dest[n] = '\0';
+}
+
+static
+void end_matrix(matrix_parser_t *parser)
+{
+    if (parser->current < 0)
+        return;
+    matrix_db_t *db = parser->db;
+    matrix_entry_t *m = &db->matrices[parser->current];
+    if (m->width == 0)
+    {
+        // no counts (empty matrix after the last separator...)
+        db->n--;
+        db->size = m->offset;
+    }
+    else if ((parser->format == MATRIX_TAB || parser->format == MATRIX_JASPAR) && parser->rows != 0xF)
+    {
+        parser->valid = 0;
+    }
+    parser->current = -1;
+    parser->in_counts = 0;
+}
+
+// new matrix, named after the file if id is NULL
+static
+void begin_matrix(matrix_parser_t *parser, const char *id, const char *id_end)
+{
+    end_matrix(parser);
+    matrix_db_t *db = parser->db;
+    if (db->n == db->msize)
+    {
+        db->msize *= 2;
+        db->matrices = (matrix_entry_t *) realloc(db->matrices, sizeof(matrix_entry_t) * db->msize);
+    }
+    matrix_entry_t *m = &db->matrices[db->n];
+    parser->count++;
+    if (id != NULL && id < id_end)
+    {
+        set_id(m->id, id, id_end);
+    }
+    else
+    {
+        char buffer[MATRIX_ID_SIZE + 32];
+        snprintf(buffer, sizeof(buffer), "%s_%d", parser->prefix, parser->count);
+        set_id(m->id, buffer, buffer + strlen(buffer));
+    }
+    strcpy(m->name, m->id);
+    m->width = 0;
+    m->offset = db->size;
+    parser->current = db->n++;
+    parser->rows = 0;
+    parser->next_row = 0;
+    parser->norder = 4;
+    int r;
+    for (r = 0; r < 4; r++)
+        parser->order[r] = r;
+    parser->nsites = MATRIX_MEME_NSITES;
+}
+
+static
+double *grow_counts(matrix_db_t *db, long n)
+{
+    if (db->size + n > db->counts_msize)
+    {
+        while (db->size + n > db->counts_msize)
+            db->counts_msize *= 2;
+        db->counts = (double *) realloc(db->counts, sizeof(double) * db->counts_msize);
+    }
+    double *counts = db->counts + db->size;
+    memset(counts, 0, sizeof(double) * n);
+    db->size += n;
+    return counts;
+}
+
+// counts of a position (A C G T) from the rest of the line
+static
+void add_column(matrix_parser_t *parser, const char *p, const char *end, double scale)
+{
+    if (parser->current < 0)
+        begin_matrix(parser, NULL, NULL);
+    double *column = grow_counts(parser->db, 4);
+    const char *s, *e;
+    int i = 0;
+    while ((s = next_token(&p, end, 0, &e)) != NULL)
+    {
+        double value;
+        if (!parse_number(s, e, &value))
+        {
+            // transfac consensus letter at the end of the row
+            if (parser->format == MATRIX_TRANSFAC && i == parser->norder)
+                break;
+            parser->valid = 0;
+            return;
+        }
+        if (i >= parser->norder)
+        {
+            parser->valid = 0;
+            return;
+        }
+        int r = parser->order[i++];
+        if (r >= 0)
+            column[r] = scale > 0 ? (double) (long) (value * scale + 0.5) : value;
+    }
+    if (i != parser->norder)
+        parser->valid = 0;
+    parser->db->matrices[parser->current].width++;
+}
+
+// counts of residue r in each position from the rest of the line
+static
+void add_row(matrix_parser_t *parser, int r, const char *p, const char *end)
+{
+    if (parser->current < 0)
+        begin_matrix(parser, NULL, NULL);
+    matrix_db_t *db = parser->db;
+    matrix_entry_t *m = &db->matrices[parser->current];
+    if (r < 0 || r > 3 || (parser->rows & (1 << r)))
+    {
+        parser->valid = 0;
+        return;
+    }
+
+    // the first row gives the width
+    const char *s, *e;
+    const char *q = p;
+    int n = 0;
+    while (next_token(&q, end, 1, &e) != NULL)
+        n++;
+    if (parser->rows == 0)
+    {
+        grow_counts(db, 4 * (long) n);
+        m->width = n;
+    }
+    else if (n != m->width)
+    {
+        parser->valid = 0;
+        return;
+    }
+
+    double *counts = db->counts + m->offset;
+    int c = 0;
+    while ((s = next_token(&p, end, 1, &e)) != NULL)
+    {
+        if (!parse_number(s, e, &counts[4 * c++ + r]))
+        {
+            parser->valid = 0;
+            return;
+        }
+    }
+    parser->rows |= 1 << r;
+}
+
+/*
+  formats
+*/
+static
+void parse_tab_line(matrix_parser_t *parser, const char *p, const char *end)
+{
+    if (p[0] == '/' && p + 1 < end && p[1] == '/')
+    {
+        end_matrix(parser);
+        return;
+    }
+    int r = residue_index(p[0]);
+    // other residues (n...) are not part of DNA matrices
+    if (r < 0 && ((p[0] >= 'a' && p[0] <= 'z') || (p[0] >= 'A' && p[0] <= 'Z')))
+        return;
+    add_row(parser, r, p + 1, end);
+}
+
+static
+void parse_transfac_line(matrix_parser_t *parser, const char *p, const char *end)
+{
+    const char *s, *e;
+    const char *field = next_token(&p, end, 0, &e);
+    long length = e - field;
+
+    if (length >= 2 && field[0] == '/' && field[1] == '/')
+    {
+        end_matrix(parser);
+    }
+    else if (length == 2 && field[0] == 'A' && field[1] == 'C')
+    {
+        s = next_token(&p, end, 0, &e);
+        begin_matrix(parser, s, e);
+    }
+    else if (length == 2 && field[0] == 'I' && field[1] == 'D')
+    {
+        s = next_token(&p, end, 0, &e);
+        if (parser->current >= 0 && s != NULL)
+            set_id(parser->db->matrices[parser->current].name, s, e);
+    }
+    else if ((length == 2 && (strncmp(field, "P0", 2) == 0 || strncmp(field, "PO", 2) == 0))
+             || (length == 3 && strncmp(field, "Pos", 3) == 0))
+    {
+        if (parser->current < 0)
+            begin_matrix(parser, NULL, NULL);
+        parser->norder = 0;
+        while ((s = next_token(&p, end, 0, &e)) != NULL && parser->norder < 16)
+            parser->order[parser->norder++] = e - s == 1 ? residue_index(s[0]) : -1;
+    }
+    else if (is_digit(field[0]))
+    {
+        add_column(parser, p, end, 0);
+    }
+}
+
+static
+void parse_jaspar_line(matrix_parser_t *parser, const char *p, const char *end)
+{
+    if (p[0] == '>')
+    {
+        const char *s, *e;
+        p++;
+        s = next_token(&p, end, 0, &e);
+        begin_matrix(parser, s, e);
+
+        // the rest of the line is the name
+        while (p < end && is_space(*p))
+            p++;
+        while (end > p && is_space(end[-1]))
+            end--;
+        if (p < end)
+            set_id(parser->db->matrices[parser->current].name, p, end);
+        return;
+    }
+    int r = residue_index(p[0]);
+    if (r >= 0 && (p + 1 == end || is_separator(p[1], 1)))
+        add_row(parser, r, p + 1, end);
+    else
+        add_row(parser, parser->next_row++, p, end);
+}
+
+static
+void parse_meme_line(matrix_parser_t *parser, const char *p, const char *end)
+{
+    const char *s, *e;
+    const char *q = p;
+    const char *field = next_token(&q, end, 0, &e);
+    double value;
+
+    if (parser->in_counts)
+    {
+        if (parse_number(field, e, &value))
+        {
+            add_column(parser, p, end, parser->nsites);
+            return;
+        }
+        parser->in_counts = 0;
+    }
+
+    if (e - field == 5 && strncmp(field, "MOTIF", 5) == 0)
+    {
+        s = next_token(&q, end, 0, &e);
+        begin_matrix(parser, s, e);
+        s = next_token(&q, end, 0, &e);
+        if (s != NULL)
+            set_id(parser->db->matrices[parser->current].name, s, e);
+    }
+    else if (e - field == 18 && strncmp(field, "letter-probability", 18) == 0)
+    {
+        if (parser->current < 0)
+            begin_matrix(parser, NULL, NULL);
+        // nsites= # (with or without space)
+        const char *nsites = NULL;
+        const char *k;
+        for (k = q; k + 7 <= end && nsites == NULL; k++)
+        {
+            if (strncmp(k, "nsites=", 7) == 0)
+                nsites = k + 7;
+        }
+        if (nsites != NULL && (s = next_token(&nsites, end, 0, &e)) != NULL && parse_number(s, e, &value) && value > 0)
+            parser->nsites = value;
+        parser->in_counts = 1;
+    }
+}
+
+static
+void parse_cluster_buster_line(matrix_parser_t *parser, const char *p, const char *end)
+{
+    const char *s, *e;
+    if (p[0] == '>')
+    {
+        // >name or >... /name=name
+        const char *q = p + 1;
+        s = NULL;
+        e = NULL;
+        if (q < end && !is_space(*q))
+            s = next_token(&q, end, 0, &e);
+        const char *k;
+        for (k = p; k + 6 <= end; k++)
+        {
+            if (strncmp(k, "/name=", 6) == 0)
+            {
+                q = k + 6;
+                s = next_token(&q, end, 0, &e);
+                break;
+            }
+        }
+        begin_matrix(parser, s, e);
+        return;
+    }
+    add_column(parser, p, end, 0);
+}
+
+/*
+  database
+*/
+int parse_matrix_format(const char *name)
+{
+    if (strcmp(name, "tab") == 0)
+        return MATRIX_TAB;
+    if (strcmp(name, "transfac") == 0 || strcmp(name, "tf") == 0)
+        return MATRIX_TRANSFAC;
+    if (strcmp(name, "jaspar") == 0)
+        return MATRIX_JASPAR;
+    if (strcmp(name, "meme") == 0)
+        return MATRIX_MEME;
+    if (strcmp(name, "cb") == 0 || strcmp(name, "cluster-buster") == 0)
+        return MATRIX_CLUSTER_BUSTER;
+    return -1;
+}
+
+static
+char *read_file(const char *filename, long *size)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+        return NULL;
+    long msize = 1 << 16;
+    long n = 0;
+    char *buffer = (char *) malloc(msize);
+    size_t r;
+    while ((r = fread(buffer + n, 1, msize - n, fp)) > 0)
+    {
+        n += r;
+        if (n == msize)
+        {
+            msize *= 2;
+            buffer = (char *) realloc(buffer, msize);
+        }
+    }
+    fclose(fp);
+    *size = n;
+    return buffer;
+}
+
+matrix_db_t *read_matrix_db(const char *filename, int format)
+{
+    long size;
+    char *buffer = read_file(filename, &size);
+    if (buffer == NULL)
+        return NULL;
+
+    matrix_db_t *db = (matrix_db_t *) malloc(sizeof(matrix_db_t));
+    db->n = 0;
+    db->msize = 16;
+    db->matrices = (matrix_entry_t *) malloc(sizeof(matrix_entry_t) * db->msize);
+    db->size = 0;
+    db->counts_msize = 1024;
+    db->counts = (double *) malloc(sizeof(double) * db->counts_msize);
+
+    matrix_parser_t parser;
+    const char *slash = strrchr(filename, '/');
+    parser.db = db;
+    parser.format = format;
+    parser.prefix = slash != NULL ? slash + 1 : filename;
+    parser.count = 0;
+    parser.current = -1;
+    parser.in_counts = 0;
+    parser.valid = 1;
+
+    const char *p = buffer;
+    const char *end = buffer + size;
+    while (p < end && parser.valid)
+    {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+        const char *line = p;
+        const char *line_end = eol;
+        p = eol + 1;
+
+        // blank lines and comments
+        while (line < line_end && is_space(*line))
+            line++;
+        while (line_end > line && is_space(line_end[-1]))
+            line_end--;
+        if (line == line_end || line[0] == ';' || line[0] == '#')
+            continue;
+
+        switch (format)
+        {
+            case MATRIX_TAB:            parse_tab_line(&parser, line, line_end); break;
+            case MATRIX_TRANSFAC:       parse_transfac_line(&parser, line, line_end); break;
+            case MATRIX_JASPAR:         parse_jaspar_line(&parser, line, line_end); break;
+            case MATRIX_MEME:           parse_meme_line(&parser, line, line_end); break;
+            case MATRIX_CLUSTER_BUSTER: parse_cluster_buster_line(&parser, line, line_end); break;
+            default:                    parser.valid = 0;
+        }
+    }
+    if (parser.valid)
+        end_matrix(&parser);
+    free(buffer);
+
+    if (!parser.valid)
+    {
+        free_matrix_db(db);
+        return NULL;
+    }
+    return db;
+}
+
+void free_matrix_db(matrix_db_t *db)
+{
+    free(db->matrices);
+    free(db->counts);
+    free(db);
+}
+
+int matrix_db_find(const matrix_db_t *db, const char *id)
+{
+    int k;
+    for (k = 0; k < db->n; k++)
+    {
+        if (strcmp(db->matrices[k].id, id) == 0 || strcmp(db->matrices[k].name, id) == 0)
+            return k;
+    }
+    return -1;
+}
+
+void write_matrix_tab(FILE *fp, const matrix_db_t *db, int k)
+{
+    const char *residues = "ACGT";
+    int r;
+    for (r = 0; r < 4; r++)
+    {
+        fprintf(fp, "%c", residues[r]);
+        int c;
+        for (c = 0; c < db->matrices[k].width; c++)
+            fprintf(fp, "\t%.15g", matrix_db_column(db, k, c)[r]);
+        fprintf(fp, "\n");
+    }
+    fprintf(fp, "//\n");
+}
@@ -10,6 +10,7 @@
 #include "count.h"
 #include "markov.h"
 #include "binomial.h"
+#include "zio.h"
 #include <math.h>
 
 int VERSION = 20110518;
@@ -327,7 +328,10 @@ int main(int argc, char *argv[])
     //markov_t *m = load_markov("../2nt_upstream-noorf_Escherichia_coli_K12-noov-2str.freq");
     markov_t *bg = NULL;
     if (bg_filename)
-        bg = load_markov(bg_filename);
+    {
+        bg = read_markov(bg_filename, MARKOV_OLIGOS, 0.0);
+        ENSURE(bg != NULL, "can not read bg file");
+    }
     else
         bg = new_markov_uniform();
 
@@ -339,13 +343,10 @@ int main(int argc, char *argv[])
        ENSURE(output_fp != NULL, "can not write to file");
     }
 
-    FILE *input_fp = stdin;
-    if (input_filename) 
-    {
-        input_fp = fopen(input_filename, "r");
-        //ENSURE(input_fp != NULL, "can not read from file '%s'", input_filename);
-        ENSURE(input_fp != NULL, "can not read from file");
-    }
+    // stdin if no filename, plain, gzip or BGZF
+    FILE *input_fp = zopen(input_filename);
+    //ENSURE(input_fp != NULL, "can not read from file '%s'", input_filename);
+    ENSURE(input_fp != NULL, "can not read from file");
 
     if (spacing != -1)
     {
@@ -361,8 +362,7 @@ int main(int argc, char *argv[])
     }
 
     // fflush(output_fp);
-    if (input_filename)
-        fclose(input_fp);
+    zclose(input_fp);
     if (output_filename)
         fclose(output_fp);
     return 0;